@@ -0,0 +1,28 @@
+#!/bin/bash
+
+#Two-pass genotyping: build the site catalogue once, genotype batches of samples
+#against it independently (here in parallel) and combine the batches with gvcfgenotyper combine.
+
+ref=/path/to/your/ref/genome.fa
+gvcfs=gvcf.list
+bin=path/to/gvcfgenotyper
+batch_size=1000
+jobs=16
+
+#pass 1: union of normalised alleles across the cohort
+$bin --sites-only -f $ref -l $gvcfs -Ob -o sites.bcf
+bcftools index sites.bcf
+
+#pass 2: every batch has exactly the same rows as sites.bcf
+split -d -a 4 -l $batch_size $gvcfs batch.
+batches=$(ls batch.[0-9][0-9][0-9][0-9])
+for i in $batches;
+do
+    echo --sites sites.bcf -f $ref -l $i -Ob -o $i.bcf;
+done | xargs -l -P $jobs $bin
+
+#rows are identical across batches, so combine pastes the samples and recomputes the cohort INFO
+#(AC/AN, HOM, GC, ADF/ADR/FS, MQ, the medians, DP_HIST_ALT, --tags, sample groups) and QUAL from all of them.
+#The output is the same as a single run over the whole list. Pass the --sample-groups file again if the
+#batches were run with one.
+$bin combine -Ob -o output.bcf $(for i in $batches; do echo $i.bcf; done)
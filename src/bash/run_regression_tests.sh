@@ -16,6 +16,52 @@ do
 done
 
 rm test.txt
+
+#two-pass output must be the same as one pass: genotype batches against the --sites-only catalogue and combine them
+echo Testing two-pass genotyping against one pass
+for i in test/regression/*.vcf.gz;
+do
+    echo $i > ${tmpdir}/batch.txt
+    bin/gvcfgenotyper -f ${i%vcf.gz}fa -l ${tmpdir}/batch.txt --sites-only -L ${tmpdir}/twopass.log > ${tmpdir}/sites.vcf
+    bin/gvcfgenotyper -f ${i%vcf.gz}fa -l ${tmpdir}/batch.txt --sites ${tmpdir}/sites.vcf -L ${tmpdir}/twopass.log -Ob -o ${tmpdir}/batch.bcf
+    bin/gvcfgenotyper combine ${tmpdir}/batch.bcf 2> /dev/null | grep -A1000 CHROM > ${tmpdir}/$(basename $i).twopass
+    diff ${tmpdir}/$(basename $i).twopass ${i}.expected
+done
+ls test/test2/*.vcf.gz > ${tmpdir}/cohort.txt
+sed 's:.*/::; s:.vcf.gz::' ${tmpdir}/cohort.txt | awk '{print $1, "ALL," (NR % 2 ? "ODD" : "EVEN")}' > ${tmpdir}/groups.txt
+options="-f test/test2/test2.ref.fa --tags HWE,MAF,ExcHet,F_MISSING --sample-groups ${tmpdir}/groups.txt -L ${tmpdir}/twopass.log"
+bin/gvcfgenotyper $options -l ${tmpdir}/cohort.txt > ${tmpdir}/onepass.vcf
+bin/gvcfgenotyper -f test/test2/test2.ref.fa -l ${tmpdir}/cohort.txt --sites-only -L ${tmpdir}/twopass.log > ${tmpdir}/sites.vcf
+split -d -l 5 ${tmpdir}/cohort.txt ${tmpdir}/batch.
+for batch in ${tmpdir}/batch.[0-9][0-9];
+do
+    bin/gvcfgenotyper $options -l $batch --sites ${tmpdir}/sites.vcf -Ob -o $batch.bcf
+done
+bin/gvcfgenotyper combine --sample-groups ${tmpdir}/groups.txt ${tmpdir}/batch.[0-9][0-9].bcf 2> /dev/null > ${tmpdir}/twopass.vcf
+cmp <(grep -A1000000 CHROM ${tmpdir}/onepass.vcf) <(grep -A1000000 CHROM ${tmpdir}/twopass.vcf)
+
+#-@ output must be the same as with one thread. Chunks are split down to 1kb so that idle threads steal work.
+echo Testing -@ against one thread
+ls test/test2/*.vcf.gz > ${tmpdir}/gvcfs.txt
+bin/gvcfgenotyper -f test/test2/test2.ref.fa -l ${tmpdir}/gvcfs.txt -r chr1:1-100000 -L ${tmpdir}/one.log > ${tmpdir}/one.vcf
+bin/gvcfgenotyper manifest -l ${tmpdir}/gvcfs.txt -o ${tmpdir}/test2.manifest 2> /dev/null
+for input in "-l ${tmpdir}/gvcfs.txt" "--manifest ${tmpdir}/test2.manifest";
+do
+    bin/gvcfgenotyper -f test/test2/test2.ref.fa $input -r chr1:1-100000 -@ 4 --min-chunk-split 1000 -L ${tmpdir}/threads.log > ${tmpdir}/threads.vcf
+    grep -q "of them split off slower chunks" ${tmpdir}/threads.log
+    if grep -q " 0 of them split off slower chunks" ${tmpdir}/threads.log; then
+        echo "no chunk was split with $input"
+        exit 1
+    fi
+    cmp ${tmpdir}/one.vcf ${tmpdir}/threads.vcf
+done
+
+echo Testing --hail with --zarr is rejected
+if bin/gvcfgenotyper -f test/test2/test2.ref.fa -l ${tmpdir}/gvcfs.txt --hail --zarr ${tmpdir}/test2.zarr 2> /dev/null; then
+    echo "--hail and --zarr were accepted together"
+    exit 1
+fi
+
 rm -rf $tmpdir
 
 echo "Regression tests passed"
@@ -0,0 +1,130 @@
+#!/bin/bash
+#
+# End-to-end scaling benchmark: merges synthetic cohorts (bin/simulate_gvcfs) over a matrix of
+# sample counts, region sizes and thread counts and writes one tab separated row per run.
+# With -b the report is compared against a stored baseline and the script exits with status 1
+# if any run got slower or used more memory than the allowed tolerance.
+#
+# usage: src/bash/run_scaling_benchmark.sh [-n "10 100 1000"] [-r "10000 100000"] [-t "0"] [-o report.tsv] [-b baseline.tsv]
+
+set -e
+
+DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"/../..
+
+ref=${DIR}/test/chr20.100kb.fa
+sample_counts="10 100 1000 10000"
+region_sizes="10000 100000"
+thread_counts="0"
+report=scaling_benchmark.tsv
+baseline=""
+tolerance=10
+seed=1
+workdir=""
+
+usage() {
+    echo "usage: $0 [options]"
+    echo "    -f <file>     reference, the first contig is used [test/chr20.100kb.fa]"
+    echo "    -n <list>     sample counts [\"${sample_counts}\"]"
+    echo "    -r <list>     region sizes in bp from the first non-N base of the first contig [\"${region_sizes}\"]"
+    echo "    -t <list>     thread counts passed to -@, 0 runs without -@ [\"${thread_counts}\"]"
+    echo "    -o <file>     report [${report}]"
+    echo "    -b <file>     baseline report to compare against"
+    echo "    -x <percent>  allowed slow down / memory growth against the baseline [${tolerance}]"
+    echo "    -s <int>      simulation seed [${seed}]"
+    echo "    -w <dir>      keep the simulated cohort and outputs in this directory [temporary]"
+    exit 1
+}
+
+while getopts "f:n:r:t:o:b:x:s:w:h" opt; do
+    case $opt in
+        f) ref=$OPTARG ;;
+        n) sample_counts=$OPTARG ;;
+        r) region_sizes=$OPTARG ;;
+        t) thread_counts=$OPTARG ;;
+        o) report=$OPTARG ;;
+        b) baseline=$OPTARG ;;
+        x) tolerance=$OPTARG ;;
+        s) seed=$OPTARG ;;
+        w) workdir=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+
+if [ -z "$workdir" ]; then
+    workdir=`mktemp -d`
+    trap "rm -rf $workdir" EXIT
+fi
+mkdir -p $workdir/cohort
+
+contig=$(head -1 ${ref}.fai | cut -f1)
+contig_length=$(head -1 ${ref}.fai | cut -f2)
+max_samples=$(echo $sample_counts | tr ' ' '\n' | sort -n | tail -1)
+#regions start at the first called base, test/chr20.100kb.fa begins with 60kb of N
+first_base=$(awk 'NR > 1 && /^>/ {exit} NR > 1 {i = match($0, /[ACGTacgt]/); if (i) {print n + i; exit} n += length($0)}' $ref)
+if [ -z "$first_base" ]; then
+    echo "$contig in $ref has no called bases"
+    exit 1
+fi
+
+#sample i is the same for any cohort size, so one cohort of the largest size serves every run
+echo simulating $max_samples samples in $workdir/cohort
+${DIR}/bin/simulate_gvcfs -f $ref -n $max_samples -o $workdir/cohort -s $seed -r ${contig}
+
+printf "samples\tregion_bp\tthreads\tsites\twall_seconds\tcpu_seconds\tsites_per_second\tsample_sites_per_second\tpeak_rss_kb\toutput_bytes\tstatus\n" > $report
+for num_samples in $sample_counts; do
+    head -n $num_samples $workdir/cohort/gvcfs.txt > $workdir/gvcfs.${num_samples}.txt
+    for region_size in $region_sizes; do
+        max_region_size=$(( contig_length - first_base + 1 ))
+        region_size=$(( region_size < max_region_size ? region_size : max_region_size ))
+        for threads in $thread_counts; do
+            name=${num_samples}.${region_size}.${threads}
+            thread_option=""
+            if [ $threads -gt 0 ]; then thread_option="-@ $threads"; fi
+            echo running $num_samples samples, ${region_size}bp, $threads threads
+            status=ok
+            ${DIR}/bin/gvcfgenotyper -f $ref -l $workdir/gvcfs.${num_samples}.txt -r ${contig}:${first_base}-$(( first_base + region_size - 1 )) $thread_option \
+                -Ob -o $workdir/${name}.bcf -L $workdir/${name}.log 2> $workdir/${name}.err || status=failed
+            if [ $status != ok ]; then
+                echo "  failed, see $workdir/${name}.err"
+                printf "%d\t%d\t%d\t.\t.\t.\t.\t.\t.\t.\t%s\n" $num_samples $region_size $threads $status >> $report
+                continue
+            fi
+            #with -@ every chunk logs the variants it wrote
+            sites=$(grep -o "Wrote [0-9]* variants" $workdir/${name}.log | awk '{s+=$2} END{print s+0}')
+            output_bytes=$(wc -c < $workdir/${name}.bcf)
+            grep -o "Resource usage:.*" $workdir/${name}.log | tr ' ' '\n' | grep = | tr '=' ' ' | \
+                awk -v n="$num_samples" -v r="$region_size" -v t="$threads" -v sites="$sites" -v bytes="$output_bytes" -v status="$status" '
+                    {v[$1]=$2}
+                    END {
+                        wall = v["wall_seconds"] > 0 ? v["wall_seconds"] : 1e-3;
+                        printf "%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.1f\t%.1f\t%d\t%d\t%s\n", n, r, t, sites, wall,
+                            v["user_seconds"] + v["system_seconds"], sites / wall, sites * n / wall, v["peak_rss_kb"], bytes, status
+                    }' >> $report
+            tail -1 $report | awk -F'\t' '{printf "  %d sites in %ss, %s sample-sites/s, peak RSS %d kB\n",$4,$5,$8,$9}'
+        done
+    done
+done
+echo wrote $report
+
+if [ -n "$baseline" ]; then
+    #rows are matched on samples/region/threads, wall time and peak RSS may grow by at most tolerance percent
+    awk -F'\t' -v tolerance="$tolerance" '
+        FNR == 1 { next }
+        NR == FNR { wall[$1 FS $2 FS $3] = $5; rss[$1 FS $2 FS $3] = $9; next }
+        {
+            key = $1 FS $2 FS $3
+            if (!(key in wall) || $11 != "ok") next
+            if ($5 > wall[key] * (1 + tolerance / 100) && $5 - wall[key] > 0.05) {
+                printf "REGRESSION %s samples %sbp %s threads: wall time %.3fs vs %.3fs in baseline\n", $1, $2, $3, $5, wall[key]
+                regressions++
+            }
+            if ($9 > rss[key] * (1 + tolerance / 100)) {
+                printf "REGRESSION %s samples %sbp %s threads: peak RSS %d kB vs %d kB in baseline\n", $1, $2, $3, $9, rss[key]
+                regressions++
+            }
+        }
+        END {
+            if (regressions) { printf "%d regressions against the baseline\n", regressions; exit 1 }
+            print "no regressions against the baseline"
+        }' $baseline $report
+fi
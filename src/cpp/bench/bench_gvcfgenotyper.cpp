@@ -0,0 +1,488 @@
+//
+// Micro-benchmarks for the per-record hot paths of gvcfgenotyper.
+//
+// Usage: bench_gvcfgenotyper [-f filter] [-r runs] [-t seconds] [-g gvcf -R ref.fa]
+//
+// Every benchmark is repeated for a number of runs and prints one tab separated line:
+// name, median ns/op, minimum ns/op, operations per run. Inputs are the bundled test
+// gVCF (test/test2) plus synthetic records and arrays generated with a fixed seed, so
+// numbers are comparable between builds on the same machine.
+//
+
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <set>
+#include <sstream>
+
+extern "C" {
+#include <htslib/faidx.h>
+}
+
+#include "ggutils.hh"
+#include "Normaliser.hh"
+#include "Genotype.hh"
+#include "multiAllele.hh"
+#include "VariantBuffer.hh"
+#include "DepthBuffer.hh"
+
+#include "spdlog.h"
+#include "sinks/null_sink.h"
+
+using std::string;
+using std::vector;
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(const string &filter, int num_runs, double min_seconds)
+            : _filter(filter), _num_runs(num_runs), _min_seconds(min_seconds)
+    {
+        std::cout << "#benchmark\tns_per_op\tmin_ns_per_op\tops_per_run" << std::endl;
+    }
+
+    //fn performs num_ops operations, it is called repeatedly until a run takes min_seconds/num_runs
+    void Run(const string &name, size_t num_ops, const std::function<void()> &fn)
+    {
+        if (num_ops == 0 || (!_filter.empty() && name.find(_filter) == string::npos))
+            return;
+        double first_call = Time(fn, 1);
+        double target = _min_seconds / _num_runs;
+        size_t num_calls = first_call >= target ? 1 : (size_t) (target / std::max(first_call, 1e-9)) + 1;
+
+        vector<double> ns_per_op;
+        for (int run = 0; run < _num_runs; run++)
+            ns_per_op.push_back(1e9 * Time(fn, num_calls) / (num_calls * num_ops));
+        std::sort(ns_per_op.begin(), ns_per_op.end());
+        std::cout << name << "\t" << ns_per_op[ns_per_op.size() / 2] << "\t" << ns_per_op[0] << "\t"
+                  << num_calls * num_ops << std::endl;
+    }
+
+private:
+    static double Time(const std::function<void()> &fn, size_t num_calls)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < num_calls; i++)
+            fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    string _filter;
+    int _num_runs;
+    double _min_seconds;
+};
+
+//sets FORMAT/FT the same way GVCFReader::ReadLines does
+static void add_sample_filter(bcf_hdr_t *hdr, bcf1_t *record)
+{
+    kstring_t filter = {0, 0, NULL};
+    if (bcf_has_filter(hdr, record, (char *) "."))
+        kputs("PASS", &filter);
+    else
+        ggutils::filter2string(hdr, record, filter);
+    assert(bcf_update_format_string(hdr, record, "FT", (const char **) &filter.s, 1) == 0);
+    free(filter.s);
+}
+
+static bcf1_t *parse_record(bcf_hdr_t *hdr, const string &line)
+{
+    kstring_t str = {0, 0, NULL};
+    kputs(line.c_str(), &str);
+    bcf1_t *record = bcf_init1();
+    if (vcf_parse(&str, hdr, record) < 0)
+        ggutils::die("could not parse " + line);
+    bcf_unpack(record, BCF_UN_ALL);
+    free(str.s);
+    return (record);
+}
+
+//records with a REF/SNP/deletion/insertion allele triple against the reference, these go through MultiSplit
+static vector<bcf1_t *> synthetic_multiallelics(bcf_hdr_t *hdr, const string &ref_file, size_t num_records, std::mt19937 &rng)
+{
+    vector<bcf1_t *> ret;
+    int num_contigs = 0;
+    const char **contigs = bcf_hdr_seqnames(hdr, &num_contigs);
+    faidx_t *fai = fai_load(ref_file.c_str());
+    if (fai == nullptr || num_contigs == 0)
+        ggutils::die("could not load " + ref_file);
+    //use the first header contig that is in the reference (test2.ref.fa only has chr1)
+    int contig = 0;
+    while (contig < num_contigs && !faidx_has_seq(fai, contigs[contig]))
+        contig++;
+    int len = 0;
+    char *seq = contig < num_contigs ? faidx_fetch_seq(fai, contigs[contig], 0, INT_MAX, &len) : nullptr;
+    if (seq == nullptr || len < 100)
+        ggutils::die("no usable contig in " + ref_file);
+
+    std::uniform_int_distribution<int> position(10, len - 10), depth(10, 60);
+    const string bases = "ACGT";
+    std::set<int> used;
+    while (ret.size() < num_records)
+    {
+        int pos = position(rng);
+        if (!used.insert(pos).second)
+            continue;
+        string ref(seq + pos, 4);
+        if (ref.find_first_not_of(bases) != string::npos)
+            continue;
+        string snp = ref, ins = ref + "T";
+        snp[0] = bases[(bases.find(ref[0]) + 1) % 4];
+        string del = ref.substr(0, 1);
+        int ad[4] = {depth(rng), depth(rng), depth(rng), depth(rng) / 4};
+        std::stringstream line;
+        line << contigs[contig] << "\t" << pos + 1 << "\t.\t" << ref << "\t" << snp << "," << del << "," << ins
+             << "\t300\tPASS\tMQ=60\tGT:GQ:GQX:DP:DPF:AD:ADF:ADR:SB:FT:PL\t1/2:90:40:" << ad[0] + ad[1] + ad[2] + ad[3]
+             << ":0:" << ad[0] << "," << ad[1] << "," << ad[2] << "," << ad[3] << ":"
+             << ad[0] / 2 << "," << ad[1] / 2 << "," << ad[2] / 2 << "," << ad[3] / 2 << ":"
+             << ad[0] - ad[0] / 2 << "," << ad[1] - ad[1] / 2 << "," << ad[2] - ad[2] / 2 << "," << ad[3] - ad[3] / 2
+             << ":-20.5:PASS:900,300,600,250,0,700,500,400,450,800";
+        ret.push_back(parse_record(hdr, line.str()));
+    }
+    free(seq);
+    free(contigs);
+    fai_destroy(fai);
+    return (ret);
+}
+
+static void destroy_records(vector<bcf1_t *> &records)
+{
+    for (auto it = records.begin(); it != records.end(); it++)
+        bcf_destroy(*it);
+    records.clear();
+}
+
+static void usage()
+{
+    std::cerr << "\nAbout:   micro-benchmarks for gvcfgenotyper's hot paths" << std::endl;
+    std::cerr << "Usage:   bench_gvcfgenotyper [options]" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -f, --filter        <string>        only run benchmarks whose name contains this string" << std::endl;
+    std::cerr << "    -r, --runs          INT             number of timed runs per benchmark, the median is reported [5]" << std::endl;
+    std::cerr << "    -t, --min-time      FLOAT           approximate seconds spent on each benchmark [0.5]" << std::endl;
+    std::cerr << "    -g, --gvcf          <file>          gvcf to take records from [test/test2/NA12877_S1.vcf.gz]" << std::endl;
+    std::cerr << "    -R, --fasta-ref     <file>          reference for the gvcf [test/test2/test2.ref.fa]" << std::endl;
+    std::cerr << "    -n, --num-synthetic INT             number of synthetic multi-allelic records [1000]" << std::endl;
+    std::cerr << std::endl;
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    //test data is found relative to bin/ like in test_gvcfgenotyper
+    char actual_path[PATH_MAX + 1];
+    realpath(dirname(strdup(argv[0])), actual_path);
+    string test_base = string(actual_path) + "/../test/test2/";
+
+    string filter = "";
+    int num_runs = 5;
+    double min_seconds = 0.5;
+    string gvcf_file = test_base + "NA12877_S1.vcf.gz";
+    string ref_file = test_base + "test2.ref.fa";
+    size_t num_synthetic = 1000;
+
+    static struct option loptions[] = {
+            {"filter",        1, 0, 'f'},
+            {"runs",          1, 0, 'r'},
+            {"min-time",      1, 0, 't'},
+            {"gvcf",          1, 0, 'g'},
+            {"fasta-ref",     1, 0, 'R'},
+            {"num-synthetic", 1, 0, 'n'},
+            {"help",          0, 0, 'h'},
+            {0,               0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:r:t:g:R:n:h", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'f':
+                filter = optarg;
+                break;
+            case 'r':
+                num_runs = std::max(1, stoi(optarg));
+                break;
+            case 't':
+                min_seconds = stod(optarg);
+                break;
+            case 'g':
+                gvcf_file = optarg;
+                break;
+            case 'R':
+                ref_file = optarg;
+                break;
+            case 'n':
+                num_synthetic = stoi(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    //library code logs through gg_logger, nothing is kept
+    spdlog::create<spdlog::sinks::null_sink_mt>("gg_logger");
+
+    htsFile *fp = hts_open(gvcf_file.c_str(), "r");
+    if (fp == nullptr)
+        ggutils::die("could not open " + gvcf_file);
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf_hdr_append(hdr, "##FORMAT=<ID=FT,Number=1,Type=String,Description=\"Sample filter, 'PASS' indicates that all single sample filters passed for this sample\">");
+    bcf_hdr_sync(hdr);
+
+    //variant records as GVCFReader would hand them to the Normaliser
+    vector<bcf1_t *> variants, indels, multiallelics;
+    bcf1_t *record = bcf_init1();
+    while (bcf_read(fp, hdr, record) == 0)
+    {
+        bcf_unpack(record, BCF_UN_ALL);
+        if (record->n_allele < 2 || !ggutils::is_valid_strelka_record(hdr, record))
+            continue;
+        add_sample_filter(hdr, record);
+        variants.push_back(bcf_dup(record));
+        bcf_unpack(variants.back(), BCF_UN_ALL);
+        if (record->n_allele > 2)
+            multiallelics.push_back(variants.back());
+        else if (!ggutils::is_snp(record))
+            indels.push_back(variants.back());
+    }
+    bcf_destroy(record);
+    hts_close(fp);
+    std::mt19937 rng(42);
+    vector<bcf1_t *> synthetic = synthetic_multiallelics(hdr, ref_file, num_synthetic, rng);
+    std::cerr << "Loaded " << variants.size() << " variants from " << gvcf_file << ", generated "
+              << synthetic.size() << " synthetic multi-allelic records" << std::endl;
+
+    Normaliser normaliser(ref_file);
+    BenchmarkRunner runner(filter, num_runs, min_seconds);
+
+    runner.Run("Normaliser::Unarise/gvcf", variants.size(), [&]() {
+        vector<bcf1_t *> output;
+        for (auto it = variants.begin(); it != variants.end(); it++)
+        {
+            normaliser.Unarise(*it, output, hdr);
+            destroy_records(output);
+        }
+    });
+    runner.Run("Normaliser::Unarise/synthetic", synthetic.size(), [&]() {
+        vector<bcf1_t *> output;
+        for (auto it = synthetic.begin(); it != synthetic.end(); it++)
+        {
+            normaliser.Unarise(*it, output, hdr);
+            destroy_records(output);
+        }
+    });
+    runner.Run("Normaliser::MultiSplit/gvcf", multiallelics.size(), [&]() {
+        vector<bcf1_t *> output;
+        for (auto it = multiallelics.begin(); it != multiallelics.end(); it++)
+        {
+            normaliser.MultiSplit(*it, output, hdr);
+            destroy_records(output);
+        }
+    });
+    runner.Run("Normaliser::MultiSplit/synthetic", synthetic.size(), [&]() {
+        vector<bcf1_t *> output;
+        for (auto it = synthetic.begin(); it != synthetic.end(); it++)
+        {
+            normaliser.MultiSplit(*it, output, hdr);
+            destroy_records(output);
+        }
+    });
+    //Realign works in place, the copy is part of the measurement
+    runner.Run("Normaliser::Realign+bcf_dup/gvcf", indels.size(), [&]() {
+        for (auto it = indels.begin(); it != indels.end(); it++)
+        {
+            bcf1_t *copy = bcf_dup(*it);
+            normaliser.Realign(copy, hdr);
+            bcf_destroy(copy);
+        }
+    });
+
+    //unarised records grouped by position, these are what CollapseRecords and multiAllele see per sample
+    vector<bcf1_t *> atomised;
+    for (auto it = variants.begin(); it != variants.end(); it++)
+        normaliser.Unarise(*it, atomised, hdr);
+    for (auto it = synthetic.begin(); it != synthetic.end(); it++)
+        normaliser.Unarise(*it, atomised, hdr);
+    std::stable_sort(atomised.begin(), atomised.end(), ggutils::bcf1_less_than);
+    vector<std::deque<bcf1_t *>> groups;
+    for (auto it = atomised.begin(); it != atomised.end(); it++)
+    {
+        if (groups.empty() || groups.back().front()->rid != (*it)->rid || groups.back().front()->pos != (*it)->pos)
+            groups.emplace_back();
+        //the reader's VariantBuffer drops repeated alleles (eg. a synthetic record on top of a real one)
+        bool seen = false;
+        for (auto rec = groups.back().begin(); rec != groups.back().end(); rec++)
+            seen |= ggutils::bcf1_equal(*rec, *it);
+        if (!seen)
+            groups.back().push_back(*it);
+    }
+
+    runner.Run("CollapseRecords", groups.size(), [&]() {
+        for (auto it = groups.begin(); it != groups.end(); it++)
+        {
+            pair<std::deque<bcf1_t *>::iterator, std::deque<bcf1_t *>::iterator> range(it->begin(), it->end());
+            bcf_destroy(CollapseRecords(hdr, range));
+        }
+    });
+
+    multiAllele alleles;
+    alleles.Init(hdr);
+    bcf1_t *collapsed_alleles = bcf_init1();
+    runner.Run("multiAllele::Allele+Collapse", groups.size(), [&]() {
+        for (auto it = groups.begin(); it != groups.end(); it++)
+        {
+            alleles.SetPosition(it->front()->rid, it->front()->pos);
+            for (auto rec = it->begin(); rec != it->end(); rec++)
+                alleles.Allele(*rec);
+            bcf_clear(collapsed_alleles);
+            alleles.Collapse(collapsed_alleles);
+        }
+    });
+    bcf_destroy(collapsed_alleles);
+
+    runner.Run("Genotype(header,record)", atomised.size(), [&]() {
+        for (auto it = atomised.begin(); it != atomised.end(); it++)
+            Genotype g(hdr, *it);
+    });
+    runner.Run("Genotype(ploidy,num_allele)", 1000, [&]() {
+        for (int i = 0; i < 1000; i++)
+            Genotype g(2, 2 + i % 4);
+    });
+
+    //collapsed sample records and the matching allele sets, as in GVCFMerger::GenotypeAltVariant
+    vector<bcf1_t *> collapsed;
+    vector<multiAllele *> allele_sets;
+    size_t max_alleles = 2;
+    for (auto it = groups.begin(); it != groups.end(); it++)
+    {
+        pair<std::deque<bcf1_t *>::iterator, std::deque<bcf1_t *>::iterator> range(it->begin(), it->end());
+        collapsed.push_back(CollapseRecords(hdr, range));
+        allele_sets.push_back(new multiAllele());
+        allele_sets.back()->Init(hdr);
+        allele_sets.back()->SetPosition(it->front()->rid, it->front()->pos);
+        for (auto rec = it->begin(); rec != it->end(); rec++)
+            allele_sets.back()->Allele(*rec);
+        max_alleles = std::max(max_alleles, (size_t) allele_sets.back()->GetNumAlleles() + 1);
+    }
+    runner.Run("Genotype(header,record,multiAllele)", collapsed.size(), [&]() {
+        for (size_t i = 0; i < collapsed.size(); i++)
+            Genotype g(hdr, collapsed[i], *allele_sets[i]);
+    });
+
+    vector<Genotype *> genotypes;
+    for (size_t i = 0; i < collapsed.size(); i++)
+        genotypes.push_back(new Genotype(hdr, collapsed[i], *allele_sets[i]));
+    ggutils::vcf_data_t format(2, max_alleles, 1);
+    runner.Run("Genotype::PropagateFormatFields", genotypes.size(), [&]() {
+        for (auto it = genotypes.begin(); it != genotypes.end(); it++)
+        {
+            format.resize((*it)->num_allele());
+            (*it)->PropagateFormatFields(0, 2, &format);
+        }
+    });
+
+    //PushBack takes ownership, records are copied and flushed in windows of 64 like the reader's buffer
+    runner.Run("VariantBuffer::PushBack+bcf_dup", atomised.size(), [&]() {
+        VariantBuffer buffer;
+        for (size_t i = 0; i < atomised.size(); i++)
+        {
+            buffer.PushBack(hdr, bcf_dup(atomised[atomised.size() - 1 - i]));
+            if (buffer.Size() == 64)
+                buffer.FlushBuffer();
+        }
+        buffer.FlushBuffer();
+    });
+
+    for (int num_blocks : {16, 256})
+    {
+        DepthBuffer depth;
+        vector<int> starts;
+        std::uniform_int_distribution<int> block_length(1, 200), value(0, 99);
+        int start = 0;
+        for (int i = 0; i < num_blocks; i++)
+        {
+            int end = start + block_length(rng);
+            depth.push_back(DepthBlock(0, start, end, value(rng), value(rng) / 10, value(rng), 2));
+            starts.push_back(start);
+            start = end + 1;
+        }
+        std::uniform_int_distribution<int> query(0, start - 50);
+        vector<int> queries;
+        for (int i = 0; i < 1000; i++)
+            queries.push_back(query(rng));
+        DepthBlock db;
+        runner.Run("DepthBuffer::Interpolate/" + std::to_string(num_blocks) + "_blocks", queries.size(), [&]() {
+            for (auto it = queries.begin(); it != queries.end(); it++)
+                depth.Interpolate(0, *it, *it + 10, db);
+        });
+    }
+
+    for (int num_allele : {3, 6})
+    {
+        //one PL set per alternate allele, each only has the REF and its own allele, as after Unarise
+        int num_gl = ggutils::get_number_of_gt_combinations(2, num_allele);
+        std::uniform_int_distribution<int> pl(0, 500);
+        vector<vector<vector<int>>> pl_sets(100);
+        for (auto it = pl_sets.begin(); it != pl_sets.end(); it++)
+            for (int i = 1; i < num_allele; i++)
+            {
+                vector<int> tmp(num_gl, bcf_int32_missing);
+                tmp[ggutils::get_gl_index(0, 0)] = pl(rng);
+                tmp[ggutils::get_gl_index(0, i)] = pl(rng);
+                tmp[ggutils::get_gl_index(i, i)] = pl(rng);
+                it->push_back(tmp);
+            }
+        vector<int> output;
+        runner.Run("ggutils::collapse_gls/" + std::to_string(num_allele) + "_alleles", pl_sets.size(), [&]() {
+            for (auto it = pl_sets.begin(); it != pl_sets.end(); it++)
+                ggutils::collapse_gls(2, num_allele, *it, output);
+        });
+    }
+
+    for (int num_values : {100, 10000})
+    {
+        std::uniform_int_distribution<int> dp(0, 100);
+        vector<int> values(num_values), work;
+        for (auto it = values.begin(); it != values.end(); it++)
+            *it = dp(rng);
+        runner.Run("ggutils::inplace_median/" + std::to_string(num_values) + "_values", 1, [&]() {
+            work = values;
+            ggutils::inplace_median(work);
+        });
+    }
+
+    for (int num_allele : {2, 4})
+    {
+        std::uniform_int_distribution<int> ad(0, 40);
+        vector<vector<int>> adf(1000, vector<int>(num_allele)), adr(1000, vector<int>(num_allele));
+        for (size_t i = 0; i < adf.size(); i++)
+            for (int j = 0; j < num_allele; j++)
+            {
+                adf[i][j] = ad(rng);
+                adr[i][j] = ad(rng);
+            }
+        vector<float> output;
+        runner.Run("ggutils::fisher_sb_test/" + std::to_string(num_allele) + "_alleles", adf.size(), [&]() {
+            for (size_t i = 0; i < adf.size(); i++)
+                ggutils::fisher_sb_test(adf[i].data(), adr[i].data(), num_allele, output);
+        });
+    }
+
+    for (size_t i = 0; i < collapsed.size(); i++)
+    {
+        delete genotypes[i];
+        delete allele_sets[i];
+        bcf_destroy(collapsed[i]);
+    }
+    destroy_records(atomised);
+    destroy_records(synthetic);
+    destroy_records(variants);
+    bcf_hdr_destroy(hdr);
+    spdlog::drop_all();
+    return (EXIT_SUCCESS);
+}
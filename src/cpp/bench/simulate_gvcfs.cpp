@@ -0,0 +1,726 @@
+//
+// Simulates a cohort of single-sample GVCFs over a reference for scale testing gvcfgenotyper.
+//
+// Usage: simulate_gvcfs -f ref.fa -n 1000 -o cohort/ [-s seed]
+//
+// Writes cohort/SIM000001.genome.vcf.gz ... (bgzipped and tabix indexed) and cohort/gvcfs.txt.
+// A population of sites is drawn once along the reference (SNPs, insertions, deletions, MNPs and
+// multi-allelic SNP or deletion sites) with log-uniform allele frequencies, every sample then
+// draws its genotypes from these frequencies, so alleles are shared across samples the way they
+// are in a real cohort. Samples are strelka-style GVCFs with homref blocks tiling the genome, a
+// fraction of them are DRAGEN-style (<NON_REF> alleles) and male samples are haploid in the
+// haploid regions. Output only depends on the seed and the options, and sample i is identical
+// whatever the number of samples.
+//
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+
+extern "C" {
+#include <htslib/bgzf.h>
+#include <htslib/faidx.h>
+#include <htslib/kstring.h>
+#include <htslib/tbx.h>
+}
+
+#include "ggutils.hh"
+
+using std::string;
+using std::vector;
+
+//lowest allele frequency drawn for a site, a constant so the sites do not depend on the cohort size
+static const double MIN_FREQUENCY = 5e-5;
+static const double ERROR_RATE = 0.01;
+
+struct Interval
+{
+    string contig;
+    int start, end;//0-based, inclusive
+    bool Contains(const string &c, int pos) const { return (c == contig && pos >= start && pos <= end); }
+};
+
+//alternate allele anchored at the site position, ref is a prefix of the reference sequence from there
+struct Allele
+{
+    string ref, alt;
+};
+
+struct Site
+{
+    int pos;//0-based
+    vector<Allele> alleles;
+    vector<double> frequency;
+};
+
+struct Options
+{
+    double site_rate = 0.01, dragen_fraction = 0.1, male_fraction = 0.5;
+    int coverage = 30, mean_block_length = 150;
+};
+
+static bool is_acgt(const string &s)
+{
+    return (s.find_first_not_of("ACGT") == string::npos);
+}
+
+static string random_bases(std::mt19937_64 &rng, int length)
+{
+    static const char bases[] = "ACGT";
+    string ret;
+    for (int i = 0; i < length; i++)
+        ret += bases[rng() % 4];
+    return (ret);
+}
+
+static char other_base(std::mt19937_64 &rng, char base)
+{
+    static const string bases = "ACGT";
+    return (bases[(bases.find(base) + 1 + rng() % 3) % 4]);
+}
+
+//draws the population sites on one contig interval
+static vector<Site> simulate_sites(const string &seq, const Interval &interval, const Options &options, std::mt19937_64 &rng)
+{
+    vector<Site> sites;
+    std::geometric_distribution<int> gap(options.site_rate);
+    std::uniform_real_distribution<double> unif(0., 1.);
+    std::uniform_int_distribution<int> indel_length(1, 10);
+    //leave room for the longest REF (a 13bp deletion) and one homref base after the last site
+    int pos = interval.start + 1 + gap(rng);
+    while (pos + 15 <= interval.end)
+    {
+        Site site;
+        site.pos = pos;
+        char ref = seq[pos];
+        double type = unif(rng);
+        int num_alleles = 1;
+        if (type < 0.80)//SNP
+        {
+            site.alleles.push_back({string(1, ref), string(1, other_base(rng, ref))});
+        }
+        else if (type < 0.87)//insertion
+        {
+            site.alleles.push_back({string(1, ref), ref + random_bases(rng, indel_length(rng))});
+        }
+        else if (type < 0.94)//deletion
+        {
+            int length = indel_length(rng);
+            site.alleles.push_back({seq.substr(pos, length + 1), string(1, ref)});
+        }
+        else if (type < 0.97)//MNP, first and last base differ
+        {
+            int length = 2 + rng() % 2;
+            string mnp = seq.substr(pos, length);
+            mnp[0] = other_base(rng, mnp[0]);
+            mnp[length - 1] = other_base(rng, mnp[length - 1]);
+            site.alleles.push_back({seq.substr(pos, length), mnp});
+        }
+        else if (type < 0.985)//multi-allelic SNP
+        {
+            char alt1 = other_base(rng, ref), alt2 = alt1;
+            while (alt2 == alt1)
+                alt2 = other_base(rng, ref);
+            site.alleles.push_back({string(1, ref), string(1, alt1)});
+            site.alleles.push_back({string(1, ref), string(1, alt2)});
+            num_alleles = 2;
+        }
+        else//multi-allelic deletion of two lengths
+        {
+            int length1 = indel_length(rng), length2 = length1 + 1 + rng() % 3;
+            site.alleles.push_back({seq.substr(pos, length1 + 1), string(1, ref)});
+            site.alleles.push_back({seq.substr(pos, length2 + 1), string(1, ref)});
+            num_alleles = 2;
+        }
+
+        int ref_length = 0;
+        bool valid = true;
+        for (auto it = site.alleles.begin(); it != site.alleles.end(); it++)
+        {
+            ref_length = std::max(ref_length, (int) it->ref.size());
+            valid &= is_acgt(it->ref) && is_acgt(it->alt);
+        }
+        if (valid)
+        {
+            //log-uniform frequencies between MIN_FREQUENCY and 0.5, most sites are rare like in real cohorts
+            for (int i = 0; i < num_alleles; i++)
+                site.frequency.push_back(
+                        exp(log(MIN_FREQUENCY) + unif(rng) * (log(0.5) - log(MIN_FREQUENCY))) / num_alleles);
+            sites.push_back(site);
+        }
+        pos += ref_length + 1 + gap(rng);
+    }
+    return (sites);
+}
+
+//FORMAT/PL for every genotype of ploidy over num_allele alleles given allelic depths, in VCF order
+static vector<int> genotype_likelihoods(const vector<int> &ad, int ploidy)
+{
+    int num_allele = ad.size();
+    vector<double> loglik;
+    vector<int> copies(num_allele);
+    for (int b = 0; b < num_allele; b++)
+        for (int a = 0; a <= (ploidy == 1 ? 0 : b); a++)
+        {
+            std::fill(copies.begin(), copies.end(), 0);
+            copies[b]++;
+            if (ploidy == 2) copies[a]++;
+            double ll = 0.;
+            for (int i = 0; i < num_allele; i++)
+            {
+                double p = (1 - ERROR_RATE) * copies[i] / ploidy +
+                           ERROR_RATE * (1. - (double) copies[i] / ploidy) / std::max(1, num_allele - 1);
+                ll += ad[i] * log10(std::max(p, 1e-10));
+            }
+            loglik.push_back(ll);
+        }
+    double max_ll = *std::max_element(loglik.begin(), loglik.end());
+    vector<int> pl;
+    for (auto it = loglik.begin(); it != loglik.end(); it++)
+        pl.push_back(std::min(9999, (int) round(-10. * (*it - max_ll))));
+    return (pl);
+}
+
+static void kput_ints(const vector<int> &values, kstring_t *str)
+{
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (i) kputc(',', str);
+        kputw(values[i], str);
+    }
+}
+
+class SampleSimulator
+{
+public:
+    SampleSimulator(const string &name, uint64_t seed, const Options &options, const vector<Interval> &haploid)
+            : _name(name), _rng(seed), _options(options), _haploid(haploid)
+    {
+        std::uniform_real_distribution<double> unif(0., 1.);
+        _dragen = unif(_rng) < options.dragen_fraction;
+        _male = unif(_rng) < options.male_fraction;
+        _fp = nullptr;
+        _line = {0, 0, nullptr};
+    }
+
+    ~SampleSimulator()
+    {
+        free(_line.s);
+    }
+
+    bool IsDragen() { return (_dragen); }
+
+    void Open(const string &fname, const vector<std::pair<string, int>> &contigs)
+    {
+        _fname = fname;
+        _fp = bgzf_open(fname.c_str(), "w");
+        if (_fp == nullptr)
+            ggutils::die("could not open " + fname);
+        WriteHeader(contigs);
+    }
+
+    //writes homref blocks and this sample's variants over one interval
+    void Simulate(const string &contig, const string &seq, const Interval &interval, const vector<Site> &sites)
+    {
+        _contig = contig;
+        _seq = &seq;
+        int cursor = interval.start;
+        for (auto site = sites.begin(); site != sites.end(); site++)
+        {
+            int ploidy = Ploidy(site->pos);
+            vector<int> gt = DrawGenotype(*site, ploidy);
+            if (std::count(gt.begin(), gt.end(), 0) == ploidy)
+                continue;
+            //strelka indel records carry no FORMAT/DP, their positions stay in the homref blocks
+            bool has_depth = _dragen || IsSnvLike(*site, gt);
+            WriteBlocks(cursor, has_depth ? site->pos - 1 : site->pos, site->pos);
+            WriteVariant(*site, gt, ploidy, has_depth);
+            cursor = has_depth ? site->pos + RefLength(*site, gt) : site->pos + 1;
+        }
+        WriteBlocks(cursor, interval.end, interval.end + 1);
+    }
+
+    void Close()
+    {
+        if (bgzf_close(_fp) < 0)
+            ggutils::die("problem writing " + _fname);
+        if (tbx_index_build(_fname.c_str(), 0, &tbx_conf_vcf) < 0)
+            ggutils::die("problem indexing " + _fname);
+    }
+
+private:
+    int Ploidy(int pos)
+    {
+        if (!_male) return (2);
+        for (auto it = _haploid.begin(); it != _haploid.end(); it++)
+            if (it->Contains(_contig, pos))
+                return (1);
+        return (2);
+    }
+
+    vector<int> DrawGenotype(const Site &site, int ploidy)
+    {
+        std::uniform_real_distribution<double> unif(0., 1.);
+        vector<int> gt;
+        for (int i = 0; i < ploidy; i++)
+        {
+            double u = unif(_rng);
+            int allele = 0;
+            for (size_t j = 0; j < site.frequency.size() && allele == 0; j++)
+            {
+                if (u < site.frequency[j]) allele = j + 1;
+                u -= site.frequency[j];
+            }
+            gt.push_back(allele);
+        }
+        std::sort(gt.begin(), gt.end());
+        return (gt);
+    }
+
+    //alternate alleles this sample carries, in site order
+    static vector<int> CalledAlleles(const vector<int> &gt)
+    {
+        vector<int> ret;
+        for (auto it = gt.begin(); it != gt.end(); it++)
+            if (*it > 0 && std::find(ret.begin(), ret.end(), *it) == ret.end())
+                ret.push_back(*it);
+        return (ret);
+    }
+
+    static int RefLength(const Site &site, const vector<int> &gt)
+    {
+        size_t ret = 1;
+        vector<int> called = CalledAlleles(gt);
+        for (auto it = called.begin(); it != called.end(); it++)
+            ret = std::max(ret, site.alleles[*it - 1].ref.size());
+        return (ret);
+    }
+
+    static bool IsSnvLike(const Site &site, const vector<int> &gt)
+    {
+        vector<int> called = CalledAlleles(gt);
+        for (auto it = called.begin(); it != called.end(); it++)
+            if (site.alleles[*it - 1].ref.size() != site.alleles[*it - 1].alt.size())
+                return (false);
+        return (true);
+    }
+
+    //homref blocks covering start..end (inclusive)
+    void WriteBlocks(int start, int end, int next_variant)
+    {
+        std::geometric_distribution<int> block_length(1. / _options.mean_block_length);
+        std::uniform_real_distribution<double> unif(0., 1.);
+        while (start <= end)
+        {
+            //blocks are short close to variants, as with strelka's block compression
+            int length = 1 + (next_variant - start < 20 && unif(_rng) < 0.5 ? 0 : block_length(_rng));
+            int block_end = std::min(end, start + length - 1);
+            //a block never spans a change of ploidy
+            for (int pos = start + 1; pos <= block_end; pos++)
+                if (Ploidy(pos) != Ploidy(start))
+                {
+                    block_end = pos - 1;
+                    break;
+                }
+            WriteBlock(start, block_end, unif(_rng) < 0.01);
+            start = block_end + 1;
+        }
+    }
+
+    void WriteBlock(int start, int end, bool no_coverage)
+    {
+        std::poisson_distribution<int> depth(_options.coverage), filtered(0.5);
+        int ploidy = Ploidy(start);
+        int dp = no_coverage ? 0 : depth(_rng);
+        int min_dp = std::max(0, dp - (int) (_rng() % 4));
+        int dpf = no_coverage ? 0 : filtered(_rng);
+        int gq = std::min(99, 3 * min_dp);
+        _line.l = 0;
+        ksprintf(&_line, "%s\t%d\t.\t%c\t", _contig.c_str(), start + 1, (*_seq)[start]);
+        if (_dragen)
+        {
+            ksprintf(&_line, "<NON_REF>\t.\t%s\tEND=%d\tGT:AD:DP:GQ:MIN_DP:PL\t", gq < 15 ? "LowGQ" : "PASS", end + 1);
+            kputs(no_coverage ? (ploidy == 1 ? "." : "./.") : (ploidy == 1 ? "0" : "0/0"), &_line);
+            ksprintf(&_line, ":%d,0:%d:%d:%d:", dp, dp, gq, min_dp);
+            if (ploidy == 1)
+                ksprintf(&_line, "0,%d", gq);
+            else
+                ksprintf(&_line, "0,%d,%d", gq, std::min(9999, 10 * gq));
+        }
+        else
+        {
+            kputs(".\t.\t", &_line);
+            kputs(gq < 15 ? "LowGQX" : "PASS", &_line);
+            if (end > start)
+                ksprintf(&_line, "\tEND=%d;BLOCKAVG_min30p3a\tGT:GQX:DP:DPF:MIN_DP\t", end + 1);
+            else
+                kputs("\t.\tGT:GQX:DP:DPF:MIN_DP\t", &_line);
+            kputs(no_coverage ? "." : (ploidy == 1 ? "0" : "0/0"), &_line);
+            if (no_coverage)
+                ksprintf(&_line, ":.:0:0:0");
+            else
+                ksprintf(&_line, ":%d:%d:%d:%d", gq, dp, dpf, min_dp);
+        }
+        Write();
+    }
+
+    void WriteVariant(const Site &site, const vector<int> &gt, int ploidy, bool has_depth)
+    {
+        //the record only has the alleles this sample carries, padded to the longest REF
+        vector<int> called = CalledAlleles(gt);
+        string ref = (*_seq).substr(site.pos, RefLength(site, gt));
+        vector<string> alts;
+        for (auto it = called.begin(); it != called.end(); it++)
+        {
+            const Allele &allele = site.alleles[*it - 1];
+            alts.push_back(allele.alt + ref.substr(allele.ref.size()));
+        }
+        vector<int> record_gt;
+        for (auto it = gt.begin(); it != gt.end(); it++)
+            record_gt.push_back(*it == 0 ? 0 : 1 + (std::find(called.begin(), called.end(), *it) - called.begin()));
+
+        //reads are drawn from the genotype's allele copies with sequencing errors
+        std::poisson_distribution<int> depth(_options.coverage);
+        std::uniform_real_distribution<double> unif(0., 1.);
+        int num_allele = alts.size() + 1;
+        int dp = std::max(4, depth(_rng));
+        vector<int> ad(num_allele, 0), adf(num_allele, 0), adr(num_allele, 0);
+        for (int i = 0; i < dp; i++)
+        {
+            int allele = record_gt[_rng() % ploidy];
+            if (unif(_rng) < ERROR_RATE)
+                allele = (allele + 1 + _rng() % (num_allele - 1)) % num_allele;
+            ad[allele]++;
+            (unif(_rng) < 0.5 ? adf : adr)[allele]++;
+        }
+        vector<int> ad_with_non_ref = ad;
+        if (_dragen)
+            ad_with_non_ref.push_back(0);
+        vector<int> pl = genotype_likelihoods(ad_with_non_ref, ploidy);
+        vector<int> sorted_pl = pl;
+        std::sort(sorted_pl.begin(), sorted_pl.end());
+        int gq = sorted_pl[1];
+        int qual = std::max(1, std::min(pl[0], 3000));
+        int gqx = std::min(gq, qual);
+        bool pass = gqx >= 15;
+
+        _line.l = 0;
+        ksprintf(&_line, "%s\t%d\t.\t%s\t", _contig.c_str(), site.pos + 1, ref.c_str());
+        for (size_t i = 0; i < alts.size(); i++)
+        {
+            if (i) kputc(',', &_line);
+            kputs(alts[i].c_str(), &_line);
+        }
+        if (_dragen)
+            kputs(",<NON_REF>", &_line);
+        ksprintf(&_line, "\t%d\t", qual);
+        if (_dragen)
+        {
+            ksprintf(&_line, "%s\t.\tGT:AD:DP:GQ:PL\t", pass ? "PASS" : "LowGQ");
+            WriteGt(record_gt);
+            kputc(':', &_line);
+            kput_ints(ad_with_non_ref, &_line);
+            ksprintf(&_line, ":%d:%d:", dp, gq);
+            kput_ints(pl, &_line);
+        }
+        else
+        {
+            kputs(pass ? "PASS" : "LowGQX", &_line);
+            if (has_depth)
+                ksprintf(&_line, "\tSNVHPOL=%d;MQ=60\tGT:GQ:GQX:DP:DPF:AD:ADF:ADR:SB:FT:PL\t", 2 + (int) (_rng() % 4));
+            else
+                kputs("\tMQ=60\tGT:GQ:GQX:DPI:AD:ADF:ADR:FT:PL\t", &_line);
+            WriteGt(record_gt);
+            ksprintf(&_line, ":%d:%d:%d", gq, gqx, dp);
+            if (has_depth)
+                ksprintf(&_line, ":%d", (int) (_rng() % 3));
+            kputc(':', &_line);
+            kput_ints(ad, &_line);
+            kputc(':', &_line);
+            kput_ints(adf, &_line);
+            kputc(':', &_line);
+            kput_ints(adr, &_line);
+            if (has_depth)
+                ksprintf(&_line, ":%.1f", -30. * unif(_rng));
+            ksprintf(&_line, ":%s:", pass ? "PASS" : "LowGQX");
+            kput_ints(pl, &_line);
+        }
+        Write();
+    }
+
+    void WriteGt(const vector<int> &gt)
+    {
+        for (size_t i = 0; i < gt.size(); i++)
+        {
+            if (i) kputc('/', &_line);
+            kputw(gt[i], &_line);
+        }
+    }
+
+    void Write()
+    {
+        kputc('\n', &_line);
+        if (bgzf_write(_fp, _line.s, _line.l) < 0)
+            ggutils::die("problem writing " + _fname);
+    }
+
+    void WriteHeader(const vector<std::pair<string, int>> &contigs)
+    {
+        kstring_t hdr = {0, 0, nullptr};
+        if (_dragen)
+        {
+            kputs("##fileformat=VCFv4.2\n"
+                  "##FILTER=<ID=PASS,Description=\"All filters passed\">\n"
+                  "##FILTER=<ID=LowGQ,Description=\"Genotype Quality less than 15\">\n"
+                  "##source=DRAGEN_GVCF\n"
+                  "##simulated_by=simulate_gvcfs\n"
+                  "##ALT=<ID=NON_REF,Description=\"Represents any possible alternative allele at this location\">\n", &hdr);
+        }
+        else
+        {
+            kputs("##fileformat=VCFv4.1\n"
+                  "##FILTER=<ID=PASS,Description=\"All filters passed\">\n"
+                  "##source=strelka\n"
+                  "##simulated_by=simulate_gvcfs\n", &hdr);
+        }
+        for (auto it = contigs.begin(); it != contigs.end(); it++)
+            ksprintf(&hdr, "##contig=<ID=%s,length=%d>\n", it->first.c_str(), it->second);
+        kputs("##INFO=<ID=END,Number=1,Type=Integer,Description=\"End position of the region described in this record\">\n"
+              "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n"
+              "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"Filtered basecall depth used for site genotyping. In a non-variant multi-site block this value represents the average of all sites in the block.\">\n"
+              "##FORMAT=<ID=MIN_DP,Number=1,Type=Integer,Description=\"Minimum filtered basecall depth used for site genotyping within a non-variant multi-site block\">\n"
+              "##FORMAT=<ID=AD,Number=.,Type=Integer,Description=\"Allelic depths for the ref and alt alleles in the order listed\">\n"
+              "##FORMAT=<ID=PL,Number=G,Type=Integer,Description=\"Normalized, Phred-scaled likelihoods for genotypes as defined in the VCF specification\">\n", &hdr);
+        if (_dragen)
+        {
+            kputs("##FORMAT=<ID=GQ,Number=1,Type=Integer,Description=\"Genotype Quality\">\n", &hdr);
+        }
+        else
+        {
+            kputs("##INFO=<ID=BLOCKAVG_min30p3a,Number=0,Type=Flag,Description=\"Non-variant multi-site block. Non-variant blocks are defined independently for each sample. All sites in such a block are constrained to be non-variant, have the same filter value, and have sample values {GQX,DP,DPF} in range [x,y], y <= max(x+3,(x*1.3)).\">\n"
+                  "##INFO=<ID=SNVHPOL,Number=1,Type=Integer,Description=\"SNV contextual homopolymer length\">\n"
+                  "##INFO=<ID=MQ,Number=1,Type=Integer,Description=\"RMS of mapping quality\">\n"
+                  "##FORMAT=<ID=GQ,Number=1,Type=Float,Description=\"Genotype Quality\">\n"
+                  "##FORMAT=<ID=GQX,Number=1,Type=Integer,Description=\"Empirically calibrated genotype quality score for variant sites, otherwise minimum of {Genotype quality assuming variant position,Genotype quality assuming non-variant position}\">\n"
+                  "##FORMAT=<ID=DPF,Number=1,Type=Integer,Description=\"Basecalls filtered from input prior to site genotyping. In a non-variant multi-site block this value represents the average of all sites in the block.\">\n"
+                  "##FORMAT=<ID=ADF,Number=.,Type=Integer,Description=\"Allelic depths on the forward strand\">\n"
+                  "##FORMAT=<ID=ADR,Number=.,Type=Integer,Description=\"Allelic depths on the reverse strand\">\n"
+                  "##FORMAT=<ID=FT,Number=1,Type=String,Description=\"Sample filter, 'PASS' indicates that all filters have passed for this sample\">\n"
+                  "##FORMAT=<ID=DPI,Number=1,Type=Integer,Description=\"Read depth associated with indel, taken from the site preceding the indel\">\n"
+                  "##FORMAT=<ID=SB,Number=1,Type=Float,Description=\"Sample site strand bias\">\n"
+                  "##FILTER=<ID=LowGQX,Description=\"Locus GQX is below threshold or not present\">\n", &hdr);
+        }
+        ksprintf(&hdr, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t%s\n", _name.c_str());
+        if (bgzf_write(_fp, hdr.s, hdr.l) < 0)
+            ggutils::die("problem writing " + _fname);
+        free(hdr.s);
+    }
+
+    string _name, _fname, _contig;
+    std::mt19937_64 _rng;
+    Options _options;
+    vector<Interval> _haploid;
+    bool _dragen, _male;
+    BGZF *_fp;
+    kstring_t _line;
+    const string *_seq;
+};
+
+//contig or contig:start-end (1-based, inclusive)
+static Interval parse_interval(const string &region, const std::map<string, int> &lengths)
+{
+    Interval ret;
+    size_t colon = region.rfind(':');
+    ret.contig = region.substr(0, colon);
+    if (lengths.find(ret.contig) == lengths.end())
+        ggutils::die("contig " + ret.contig + " is not in the reference");
+    ret.start = 0;
+    ret.end = lengths.at(ret.contig) - 1;
+    if (colon != string::npos)
+    {
+        size_t dash = region.find('-', colon);
+        if (dash == string::npos)
+            ggutils::die("bad region " + region);
+        ret.start = std::max(0, stoi(region.substr(colon + 1, dash - colon - 1)) - 1);
+        ret.end = std::min(ret.end, stoi(region.substr(dash + 1)) - 1);
+    }
+    return (ret);
+}
+
+static void usage()
+{
+    std::cerr << "\nAbout:   simulates a cohort of strelka/DRAGEN-style single-sample GVCFs for scale testing" << std::endl;
+    std::cerr << "Usage:   simulate_gvcfs -f ref.fa -n 100 -o cohort/" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -f, --fasta-ref     <file>          reference sequence (indexed)" << std::endl;
+    std::cerr << "    -n, --num-samples   INT             number of samples [10]" << std::endl;
+    std::cerr << "    -o, --output-dir    <dir>           output directory, writes <dir>/SIM*.genome.vcf.gz and <dir>/gvcfs.txt [.]" << std::endl;
+    std::cerr << "    -s, --seed          INT             random seed [1]" << std::endl;
+    std::cerr << "    -r, --region        <region>        only simulate this region eg. chr20 or chr20:1-50000 (can be repeated) [all contigs]" << std::endl;
+    std::cerr << "        --haploid       <region>        region where male samples are haploid (can be repeated)" << std::endl;
+    std::cerr << "                                        [chrX/chrY, or the last 10% of the last contig if there are neither]" << std::endl;
+    std::cerr << "        --site-rate     FLOAT           segregating sites per bp in the population [0.01]" << std::endl;
+    std::cerr << "        --coverage      INT             mean read depth [30]" << std::endl;
+    std::cerr << "        --block-length  INT             mean homref block length [150]" << std::endl;
+    std::cerr << "        --dragen        FLOAT           fraction of samples written as DRAGEN GVCFs with <NON_REF> [0.1]" << std::endl;
+    std::cerr << "        --male          FLOAT           fraction of male samples [0.5]" << std::endl;
+    std::cerr << std::endl;
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    string reference_genome = "";
+    string output_dir = ".";
+    int num_samples = 10;
+    uint64_t seed = 1;
+    vector<string> regions, haploid_regions;
+    Options options;
+
+    static struct option loptions[] = {
+            {"fasta-ref",    1, 0, 'f'},
+            {"num-samples",  1, 0, 'n'},
+            {"output-dir",   1, 0, 'o'},
+            {"seed",         1, 0, 's'},
+            {"region",       1, 0, 'r'},
+            {"haploid",      1, 0, 1},
+            {"site-rate",    1, 0, 2},
+            {"coverage",     1, 0, 3},
+            {"block-length", 1, 0, 4},
+            {"dragen",       1, 0, 5},
+            {"male",         1, 0, 6},
+            {"help",         0, 0, 'h'},
+            {0,              0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "f:n:o:s:r:h", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'f':
+                reference_genome = optarg;
+                break;
+            case 'n':
+                num_samples = stoi(optarg);
+                break;
+            case 'o':
+                output_dir = optarg;
+                break;
+            case 's':
+                seed = stoull(optarg);
+                break;
+            case 'r':
+                regions.push_back(optarg);
+                break;
+            case 1:
+                haploid_regions.push_back(optarg);
+                break;
+            case 2:
+                options.site_rate = stod(optarg);
+                break;
+            case 3:
+                options.coverage = stoi(optarg);
+                break;
+            case 4:
+                options.mean_block_length = std::max(1, stoi(optarg));
+                break;
+            case 5:
+                options.dragen_fraction = stod(optarg);
+                break;
+            case 6:
+                options.male_fraction = stod(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+    if (reference_genome.empty())
+        usage();
+    if (options.site_rate <= 0 || options.site_rate >= 1)
+        ggutils::die("--site-rate must be between 0 and 1");
+
+    faidx_t *fai = fai_load(reference_genome.c_str());
+    if (fai == nullptr)
+        ggutils::die("could not load " + reference_genome);
+    vector<std::pair<string, int>> contigs;
+    std::map<string, int> lengths;
+    for (int i = 0; i < faidx_nseq(fai); i++)
+    {
+        string name = faidx_iseq(fai, i);
+        contigs.emplace_back(name, faidx_seq_len(fai, name.c_str()));
+        lengths[name] = contigs.back().second;
+    }
+
+    vector<Interval> intervals, haploid;
+    for (auto it = regions.begin(); it != regions.end(); it++)
+        intervals.push_back(parse_interval(*it, lengths));
+    if (regions.empty())
+        for (auto it = contigs.begin(); it != contigs.end(); it++)
+            intervals.push_back(parse_interval(it->first, lengths));
+    for (auto it = haploid_regions.begin(); it != haploid_regions.end(); it++)
+        haploid.push_back(parse_interval(*it, lengths));
+    if (haploid_regions.empty())
+    {
+        for (auto name : {"chrX", "chrY", "X", "Y"})
+            if (lengths.count(name))
+                haploid.push_back(parse_interval(name, lengths));
+        if (haploid.empty())
+        {
+            Interval last = parse_interval(contigs.back().first, lengths);
+            last.start = last.end - (last.end + 1) / 10;
+            haploid.push_back(last);
+        }
+    }
+    for (auto it = haploid.begin(); it != haploid.end(); it++)
+        std::cerr << "Haploid region for male samples: " << it->contig << ":" << it->start + 1 << "-" << it->end + 1 << std::endl;
+
+    vector<string> sequences;
+    vector<vector<Site>> sites;
+    std::mt19937_64 site_rng(seed);
+    size_t num_sites = 0;
+    for (auto it = intervals.begin(); it != intervals.end(); it++)
+    {
+        int len = 0;
+        char *seq = faidx_fetch_seq(fai, it->contig.c_str(), 0, lengths[it->contig] - 1, &len);
+        if (seq == nullptr)
+            ggutils::die("could not read " + it->contig + " from " + reference_genome);
+        sequences.push_back(seq);
+        free(seq);
+        std::transform(sequences.back().begin(), sequences.back().end(), sequences.back().begin(), ::toupper);
+        sites.push_back(simulate_sites(sequences.back(), *it, options, site_rng));
+        num_sites += sites.back().size();
+    }
+    fai_destroy(fai);
+    std::cerr << "Simulated " << num_sites << " population sites" << std::endl;
+
+    string list_file = output_dir + "/gvcfs.txt";
+    FILE *list = fopen(list_file.c_str(), "w");
+    if (list == nullptr)
+        ggutils::die("could not open " + list_file + ", does " + output_dir + " exist?");
+    int num_dragen = 0;
+    for (int i = 0; i < num_samples; i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "SIM%06d", i + 1);
+        string fname = output_dir + "/" + name + ".genome.vcf.gz";
+        //every sample has its own stream so sample i does not depend on the cohort size
+        std::seed_seq sample_seed{seed, (uint64_t) i};
+        std::mt19937_64 seeder(sample_seed);
+        SampleSimulator sample(name, seeder(), options, haploid);
+        num_dragen += sample.IsDragen();
+        sample.Open(fname, contigs);
+        for (size_t j = 0; j < intervals.size(); j++)
+            sample.Simulate(intervals[j].contig, sequences[j], intervals[j], sites[j]);
+        sample.Close();
+        fprintf(list, "%s\n", fname.c_str());
+        if ((i + 1) % 100 == 0)
+            std::cerr << "Wrote " << i + 1 << "/" << num_samples << " samples" << std::endl;
+    }
+    fclose(list);
+    std::cerr << "Wrote " << num_samples << " GVCFs (" << num_dragen << " DRAGEN-style) listed in " << list_file << std::endl;
+    return (EXIT_SUCCESS);
+}
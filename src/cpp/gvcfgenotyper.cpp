@@ -1,9 +1,25 @@
 #include "GVCFMerger.hh"
+#include "RefBlockExpander.hh"
+#include "BatchCombiner.hh"
+#include "StageTimer.hh"
+#include "LogThrottle.hh"
+#include "Manifest.hh"
+#include "ShardPlanner.hh"
+#include "ChunkScheduler.hh"
+#include "BcfConverter.hh"
 #include <getopt.h>
+#include <thread>
+#include <functional>
+#include <memory>
 
 #include <sys/time.h>
 #include <sys/resource.h>
 
+extern "C" {
+#include <htslib/bgzf.h>
+#include <htslib/hfile.h>
+}
+
 #include "spdlog.h"
 #include "string.h"
 
@@ -24,20 +40,553 @@ static void usage()
     std::cerr << "    -r, --region        <region>        region to genotype eg. chr1 or chr20:5000000-6000000"
               << std::endl;
     std::cerr << "    -M, --max-alleles   INT             maximum number of alleles [50]" << std::endl;
-//    std::cerr << "    -@, --thread      INT             number of threads [0]" << std::endl; //TODO: implement multi-threading!
+    std::cerr << "        --sparse-ref-blocks             only write homref FORMAT values when a sample's reference block changes" << std::endl;
+    std::cerr << "        --sites-only                    only write the merged alleles with INFO/AC and INFO/NC (no samples)" << std::endl;
+    std::cerr << "        --sites         <file>          only genotype the sites in this VCF/BCF eg. --sites-only output" << std::endl;
+    std::cerr << "        --zarr          <dir>           write GT/GQ/DP/AD/PL as chunked arrays to a Zarr directory store instead of VCF," << std::endl;
+    std::cerr << "                                        buffering at most 256MB of variants (see docs/zarr_output.md)" << std::endl;
+    std::cerr << "        --tags          <list>          extra INFO tags to compute, any of HWE,MAF,ExcHet,F_MISSING" << std::endl;
+    std::cerr << "        --sample-groups <file>          add INFO/AC_<group> and INFO/AN_<group>, lines of \"sample group1[,group2]\"" << std::endl;
+    std::cerr << "        --write-index                   write a .csi (-Ob) or .tbi (-Oz) index along with the output" << std::endl;
+    std::cerr << "        --progress-interval INT         log position, throughput and ETA every INT seconds, 0 turns it off [60]" << std::endl;
+    std::cerr << "    -b, --buffer-size   INT             bp of variants read ahead of each input [5000]" << std::endl;
+    std::cerr << "        --buffer-memory INT             read-ahead budget in MB shared by all inputs, 0 for no limit [1024]. Dense regions" << std::endl;
+    std::cerr << "                                        then read less than -b, down to 1000bp or 4x the largest normalisation shift seen," << std::endl;
+    std::cerr << "                                        so a later record shifted further could be written out of order. 0 keeps -b" << std::endl;
+    std::cerr << "        --io-threads    INT             threads prefetching the input GVCFs from storage [0]" << std::endl;
+    std::cerr << "        --open-threads  INT             threads opening the inputs and filling their buffers at start-up [8]" << std::endl;
+    std::cerr << "        --manifest      <file>          headers and index offsets of the inputs from 'gvcfgenotyper manifest', the default list" << std::endl;
+    std::cerr << "        --max-open-files INT            inputs kept open at once, others are reopened when needed [ulimit -n - 64]" << std::endl;
+    std::cerr << "        --max-warnings  INT             log each kind of warning at most INT times [20]" << std::endl;
+    std::cerr << "        --stats-json    <file>          write per-stage timings of the merge as JSON" << std::endl;
+    std::cerr << "        --hail                          write bgzipped VCF ready for hail's import_vcf (see docs/hail/README.md)" << std::endl;
+    std::cerr << "        --zarr-max-alleles INT          number of alleles stored for AD/PL in the Zarr store [4]" << std::endl;
+    std::cerr << "    -@, --thread        INT             merge chunks of the genome on INT threads, idle ones splitting slow chunks [1]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Commands:" << std::endl;
+    std::cerr << "    expand              restore dense FORMAT values from --sparse-ref-blocks output" << std::endl;
+    std::cerr << "    combine             combine batches genotyped with --sites into one file with the cohort INFO" << std::endl;
+    std::cerr << "    manifest            store the headers and index offsets of a cohort for --manifest" << std::endl;
+    std::cerr << "    plan                split the genome into -r regions of about equal work from the inputs' indices" << std::endl;
+    std::cerr << "    convert             rewrite the inputs as indexed BCF, which is read faster than VCF" << std::endl;
+    std::cerr << std::endl;
+}
+
+static void expand_usage()
+{
+    std::cerr << "\nAbout:   Restores dense FORMAT values from gvcfgenotyper --sparse-ref-blocks output" << std::endl;
+    std::cerr << "Usage:   gvcfgenotyper expand [options] sparse.bcf" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -o, --output-file   <file>          output file name [stdout]" << std::endl;
+    std::cerr
+              << "    -O, --output-type   <b|u|z|v>       b: compressed BCF, u: uncompressed BCF, z: compressed VCF, v: uncompressed VCF [v]"
+            << std::endl;
     std::cerr << std::endl;
 }
 
+static int expand_main(int argc, char **argv)
+{
+    int c;
+    string output_file = "";
+    string output_type = "v";
+    static struct option loptions[] = {
+            {"output-file", 1, 0, 'o'},
+            {"output-type", 1, 0, 'O'},
+            {0,             0, 0, 0}
+    };
+    while ((c = getopt_long(argc, argv, "o:O:", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'O':
+                output_type = optarg;
+                break;
+            default:
+                expand_usage();
+                ggutils::die("unrecognised argument");
+        }
+    }
+    if (optind != argc - 1)
+    {
+        expand_usage();
+        ggutils::die("expand requires exactly one input file");
+    }
+    if (output_type != "b" && output_type != "z" && output_type != "v" && output_type != "u")
+    {
+        ggutils::die("invalid output type: " + output_type);
+    }
+    RefBlockExpander expander(argv[optind], output_file, output_type);
+    int num_written = expander.Expand();
+    std::cerr << "Expanded " << num_written << " records" << std::endl;
+    return (EXIT_SUCCESS);
+}
+
+static void combine_usage()
+{
+    std::cerr << "\nAbout:   Combines batches of samples genotyped against the same --sites catalogue, recomputing the cohort INFO" << std::endl;
+    std::cerr << "Usage:   gvcfgenotyper combine [options] batch1.bcf batch2.bcf [...]" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -o, --output-file   <file>          output file name [stdout]" << std::endl;
+    std::cerr
+              << "    -O, --output-type   <b|u|z|v>       b: compressed BCF, u: uncompressed BCF, z: compressed VCF, v: uncompressed VCF [v]"
+            << std::endl;
+    std::cerr << "        --sample-groups <file>          the --sample-groups file of the batches" << std::endl;
+    std::cerr << std::endl;
+}
+
+static int combine_main(int argc, char **argv)
+{
+    int c;
+    string output_file = "";
+    string output_type = "v";
+    string sample_groups_file = "";
+    static struct option loptions[] = {
+            {"output-file",   1, 0, 'o'},
+            {"output-type",   1, 0, 'O'},
+            {"sample-groups", 1, 0, 1},
+            {0,               0, 0, 0}
+    };
+    while ((c = getopt_long(argc, argv, "o:O:", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'o':
+                output_file = optarg;
+                break;
+            case 'O':
+                output_type = optarg;
+                break;
+            case 1:
+                sample_groups_file = optarg;
+                break;
+            default:
+                combine_usage();
+                ggutils::die("unrecognised argument");
+        }
+    }
+    if (optind >= argc)
+    {
+        combine_usage();
+        ggutils::die("combine requires at least one input file");
+    }
+    if (output_type != "b" && output_type != "z" && output_type != "v" && output_type != "u")
+    {
+        ggutils::die("invalid output type: " + output_type);
+    }
+    //sample group warnings go to stderr like the rest of the output of the subcommands
+    spdlog::stderr_logger_mt("gg_logger");
+    int num_written;
+    {
+        BatchCombiner combiner(std::vector<std::string>(argv + optind, argv + argc), output_file, output_type, sample_groups_file);
+        num_written = combiner.Combine();
+    }
+    spdlog::drop_all();
+    std::cerr << "Combined " << argc - optind << " batches into " << num_written << " records" << std::endl;
+    return (EXIT_SUCCESS);
+}
+
+static void manifest_usage()
+{
+    std::cerr << "\nAbout:   Stores the header layouts, sample names and index offsets of bgzipped GVCFs in one file, read by --manifest" << std::endl;
+    std::cerr << "Usage:   gvcfgenotyper manifest -l gvcf_list.txt -o cohort.manifest" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -l, --list          <file>          plain text list of gvcfs, paths are stored as given" << std::endl;
+    std::cerr << "    -o, --output-file   <file>          manifest file name" << std::endl;
+    std::cerr << "        --bin-size      INT             bp between stored offsets, a region is read from the start of its bin [1000000]" << std::endl;
+    std::cerr << "        --threads       INT             inputs read at once [8]" << std::endl;
+    std::cerr << std::endl;
+}
+
+static int manifest_main(int argc, char **argv)
+{
+    int c;
+    string gvcf_list = "";
+    string output_file = "";
+    int bin_size = 1000000;
+    int num_threads = 8;
+    static struct option loptions[] = {
+            {"list",        1, 0, 'l'},
+            {"output-file", 1, 0, 'o'},
+            {"bin-size",    1, 0, 1},
+            {"threads",     1, 0, 2},
+            {0,             0, 0, 0}
+    };
+    while ((c = getopt_long(argc, argv, "l:o:", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'l':
+                gvcf_list = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 1:
+                bin_size = stoi(optarg);
+                break;
+            case 2:
+                num_threads = stoi(optarg);
+                break;
+            default:
+                manifest_usage();
+                ggutils::die("unrecognised argument");
+        }
+    }
+    if (gvcf_list.empty() || output_file.empty())
+    {
+        manifest_usage();
+        ggutils::die("manifest requires --list and --output-file");
+    }
+    std::vector<std::string> input_files;
+    ggutils::read_text_file(gvcf_list, input_files);
+    if (input_files.empty())
+        ggutils::die("Empty list of input files: " + gvcf_list);
+    Manifest manifest;
+    manifest.Build(input_files, bin_size, num_threads);
+    manifest.Write(output_file);
+    std::cerr << "Wrote " << manifest.GetNumInputs() << " inputs with " << manifest.GetNumHeaders()
+              << " distinct header layouts to " << output_file << std::endl;
+    return (EXIT_SUCCESS);
+}
+
+static void plan_usage()
+{
+    std::cerr << "\nAbout:   Splits the genome into regions with about the same number of compressed bytes over the inputs, as read from their indices" << std::endl;
+    std::cerr << "Usage:   gvcfgenotyper plan -l gvcf_list.txt -n 100 > shards.txt" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -l, --list          <file>          plain text list of gvcfs" << std::endl;
+    std::cerr << "    -n, --num-shards    INT             number of shards, fewer are written if the inputs are too small" << std::endl;
+    std::cerr << "    -o, --output-file   <file>          one -r argument per line [stdout]" << std::endl;
+    std::cerr << "        --bed                           write BED lines of chrom, start, end and shard number instead" << std::endl;
+    std::cerr << "        --num-inputs    INT             plan with this many inputs spread over the list, 0 for all [20]" << std::endl;
+    std::cerr << "        --bin-size      INT             resolution of the plan in bp [100000]" << std::endl;
+    std::cerr << "        --gap-window    INT             move each cut up to INT bp to the middle of the longest stretch without variants [5000]" << std::endl;
+    std::cerr << "        --threads       INT             inputs read at once [8]" << std::endl;
+    std::cerr << std::endl;
+}
+
+static int plan_main(int argc, char **argv)
+{
+    int c;
+    string gvcf_list = "";
+    string output_file = "";
+    int num_shards = 0;
+    bool bed = false;
+    int num_inputs = 20;
+    int bin_size = 100000;
+    int gap_window = 5000;
+    int num_threads = 8;
+    static struct option loptions[] = {
+            {"list",        1, 0, 'l'},
+            {"num-shards",  1, 0, 'n'},
+            {"output-file", 1, 0, 'o'},
+            {"bed",         0, 0, 1},
+            {"num-inputs",  1, 0, 2},
+            {"bin-size",    1, 0, 3},
+            {"gap-window",  1, 0, 4},
+            {"threads",     1, 0, 5},
+            {0,             0, 0, 0}
+    };
+    while ((c = getopt_long(argc, argv, "l:n:o:", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'l':
+                gvcf_list = optarg;
+                break;
+            case 'n':
+                num_shards = stoi(optarg);
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 1:
+                bed = true;
+                break;
+            case 2:
+                num_inputs = stoi(optarg);
+                break;
+            case 3:
+                bin_size = stoi(optarg);
+                break;
+            case 4:
+                gap_window = stoi(optarg);
+                break;
+            case 5:
+                num_threads = stoi(optarg);
+                break;
+            default:
+                plan_usage();
+                ggutils::die("unrecognised argument");
+        }
+    }
+    if (gvcf_list.empty() || num_shards < 1)
+    {
+        plan_usage();
+        ggutils::die("plan requires --list and a positive --num-shards");
+    }
+    std::vector<std::string> input_files;
+    ggutils::read_text_file(gvcf_list, input_files);
+    if (input_files.empty())
+        ggutils::die("Empty list of input files: " + gvcf_list);
+    //evenly spaced over the list, which is often sorted by batch
+    std::vector<std::string> planned_files;
+    size_t num_planned = num_inputs > 0 ? std::min((size_t) num_inputs, input_files.size()) : input_files.size();
+    for (size_t i = 0; i < num_planned; i++)
+        planned_files.push_back(input_files[i * input_files.size() / num_planned]);
+
+    Manifest manifest;
+    manifest.Build(planned_files, bin_size, num_threads);
+    ShardPlanner planner(manifest);
+    planner.Plan(num_shards, gap_window);
+
+    std::ofstream file;
+    if (!output_file.empty())
+    {
+        file.open(output_file);
+        if (!file)
+            ggutils::die("problem opening " + output_file);
+    }
+    std::ostream &out = output_file.empty() ? std::cout : file;
+    auto &shards = planner.GetShards();
+    double min_bytes = planner.GetTotalBytes(), max_bytes = 0;
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        if (bed)
+            for (auto &r : shards[i].regions)
+                out << planner.GetContigName(r.rid) << '\t' << r.beg << '\t' << r.end << '\t' << i + 1 << '\n';
+        else
+            out << planner.GetRegionList(i) << '\n';
+        min_bytes = std::min(min_bytes, shards[i].bytes);
+        max_bytes = std::max(max_bytes, shards[i].bytes);
+    }
+    std::cerr << "Planned " << shards.size() << " shards from " << planned_files.size() << " inputs, "
+              << (uint64_t) planner.GetTotalBytes() << " compressed bytes in total, " << (uint64_t) min_bytes << " to " << (uint64_t) max_bytes
+              << " per shard" << std::endl;
+    return (EXIT_SUCCESS);
+}
+
+static void convert_usage()
+{
+    std::cerr << "\nAbout:   Rewrites GVCFs as BCF with a .csi index, the fastest input for gvcfgenotyper" << std::endl;
+    std::cerr << "Usage:   gvcfgenotyper convert -l gvcf_list.txt -d bcf_dir -o bcf_list.txt" << std::endl;
+    std::cerr << "" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "    -l, --list          <file>          plain text list of gvcfs" << std::endl;
+    std::cerr << "    -d, --output-dir    <dir>           existing directory the BCFs are written to, named after the inputs [.]" << std::endl;
+    std::cerr << "    -o, --output-file   <file>          list of the BCFs in input order, for --list [stdout]" << std::endl;
+    std::cerr << "        --compression-level INT         BGZF compression level of the BCFs, 0-9 [6]" << std::endl;
+    std::cerr << "        --threads       INT             inputs converted at once [8]" << std::endl;
+    std::cerr << std::endl;
+}
+
+static int convert_main(int argc, char **argv)
+{
+    int c;
+    string gvcf_list = "";
+    string output_dir = ".";
+    string output_file = "";
+    int compression_level = -1;
+    int num_threads = 8;
+    static struct option loptions[] = {
+            {"list",              1, 0, 'l'},
+            {"output-dir",        1, 0, 'd'},
+            {"output-file",       1, 0, 'o'},
+            {"compression-level", 1, 0, 1},
+            {"threads",           1, 0, 2},
+            {0,                   0, 0, 0}
+    };
+    while ((c = getopt_long(argc, argv, "l:d:o:", loptions, NULL)) >= 0)
+    {
+        switch (c)
+        {
+            case 'l':
+                gvcf_list = optarg;
+                break;
+            case 'd':
+                output_dir = optarg;
+                break;
+            case 'o':
+                output_file = optarg;
+                break;
+            case 1:
+                compression_level = stoi(optarg);
+                break;
+            case 2:
+                num_threads = stoi(optarg);
+                break;
+            default:
+                convert_usage();
+                ggutils::die("unrecognised argument");
+        }
+    }
+    if (gvcf_list.empty())
+    {
+        convert_usage();
+        ggutils::die("convert requires --list");
+    }
+    if (compression_level > 9)
+        ggutils::die("the compression level must be 0-9");
+    std::vector<std::string> input_files;
+    ggutils::read_text_file(gvcf_list, input_files);
+    if (input_files.empty())
+        ggutils::die("Empty list of input files: " + gvcf_list);
+    BcfConverter converter(output_dir, compression_level);
+    converter.Convert(input_files, num_threads);
+
+    std::ofstream file;
+    if (!output_file.empty())
+    {
+        file.open(output_file);
+        if (!file)
+            ggutils::die("problem opening " + output_file);
+    }
+    std::ostream &out = output_file.empty() ? std::cout : file;
+    for (auto &output : converter.GetOutputs())
+        out << output << '\n';
+    std::cerr << "Converted " << input_files.size() << " inputs with " << converter.GetNumRecords() << " records to BCF in "
+              << output_dir << std::endl;
+    return (EXIT_SUCCESS);
+}
+
 unsigned CountFileHandles() {
     struct rlimit rl;
     getrlimit(RLIMIT_NOFILE, &rl);
     return rl.rlim_cur;
 }
 
+static double elapsed_seconds(const struct timeval &start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start.tv_sec + 1e-6 * (now.tv_usec - start.tv_usec));
+}
+
+//one line summary read by src/bash/run_scaling_benchmark.sh
+static void log_resource_usage(std::shared_ptr<spdlog::logger> lg, const struct timeval &start)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double user = usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec;
+    double sys = usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+    lg->info("Resource usage: wall_seconds={:.3f} user_seconds={:.3f} system_seconds={:.3f} peak_rss_kb={}",
+             elapsed_seconds(start), user, sys, usage.ru_maxrss);
+}
+
+//-@: threads merge chunks of the genome into files of their own (uncompressed, only chunk 0 with the header),
+//which are appended to the output in genomic order as they finish
+static void write_chunks(int n_threads, int64_t min_chunk_split, const string &first_input, const string &region, int is_file,
+                         const string &output_file, const string &output_type, bool write_index,
+                         const std::function<GVCFMerger *(const string &region, const string &output_file, const string &output_mode)> &new_merger)
+{
+    std::shared_ptr<spdlog::logger> lg = spdlog::get("gg_logger");
+    //contig order of the output, which is that of the first input
+    htsFile *fp = hts_open(first_input.c_str(), "r");
+    bcf_hdr_t *header = fp != nullptr ? bcf_hdr_read(fp) : nullptr;
+    if (header == nullptr)
+        ggutils::die("problem reading the header of " + first_input);
+    hts_close(fp);
+    ChunkScheduler scheduler(header, region, is_file, n_threads, min_chunk_split);
+    string prefix = (output_file.empty() || output_file == "-" ? "gvcfgenotyper." + to_string(getpid()) : output_file) + ".chunk";
+    string chunk_mode = output_type == "b" ? "b0" : "v";
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++)
+    {
+        threads.emplace_back([&]()
+        {
+            size_t chunk;
+            while (scheduler.Next(chunk))
+            {
+                string chunk_region = scheduler.GetRegion(chunk);
+                lg->info("Merging chunk {} of {}", chunk, chunk_region);
+                std::unique_ptr<GVCFMerger> g(new_merger(chunk_region, prefix + to_string(chunk), chunk_mode));
+                g->SetChunk(&scheduler, chunk);
+                g->write_vcf();
+                g.reset();//closes the chunk file
+                scheduler.Finish(chunk);
+            }
+        });
+    }
+
+    htsFile *out = hts_open(!output_file.empty() ? output_file.c_str() : "-", ("w" + output_type).c_str());
+    if (out == nullptr)
+        ggutils::die("problem opening output file: " + output_file);
+    std::vector<char> buffer(1 << 20);
+    size_t chunk, num_appended = 0;
+    while (scheduler.NextFinished(chunk))
+    {
+        string chunk_file = prefix + to_string(chunk);
+        BGZF *in = bgzf_open(chunk_file.c_str(), "r");
+        if (in == nullptr)
+            ggutils::die("problem opening " + chunk_file);
+        ssize_t n;
+        while ((n = bgzf_read(in, buffer.data(), buffer.size())) > 0)
+        {
+            ssize_t written = out->is_bgzf ? bgzf_write(out->fp.bgzf, buffer.data(), n) : hwrite(out->fp.hfile, buffer.data(), n);
+            if (written != n)
+                ggutils::die("problem writing " + output_file);
+        }
+        if (n < 0)
+            ggutils::die("problem reading " + chunk_file);
+        bgzf_close(in);
+        unlink(chunk_file.c_str());
+        num_appended++;
+    }
+    for (auto &t : threads)
+        t.join();
+    if (hts_close(out) != 0)
+        ggutils::die("problem closing " + output_file);
+    lg->info("Appended {} chunks merged by {} threads, {} of them split off slower chunks", num_appended, n_threads,
+             scheduler.GetNumSteals());
+
+    //the chunks are written without an index, so the output is indexed once it is complete
+    if (write_index)
+    {
+        int64_t max_len = 0;
+        for (int rid = 0; rid < header->n[BCF_DT_CTG]; rid++)
+            max_len = std::max(max_len, ggutils::get_contig_length(header, rid));
+        int ret = output_type == "b" ? bcf_index_build(output_file.c_str(), 14)
+                                     : tbx_index_build(output_file.c_str(), max_len + 256 > ((int64_t) 1 << 29) ? 14 : 0, &tbx_conf_vcf);
+        if (ret != 0)
+            ggutils::die("problem indexing " + output_file);
+    }
+    bcf_hdr_destroy(header);
+}
+
 int main(int argc, char **argv)
 {
+    struct timeval start_time;
+    gettimeofday(&start_time, NULL);
     if (argc < 2)
     { usage(); }
+    if (argc > 1 && strcmp(argv[1], "expand") == 0)
+    {
+        return (expand_main(argc - 1, argv + 1));
+    }
+    if (argc > 1 && strcmp(argv[1], "combine") == 0)
+    {
+        return (combine_main(argc - 1, argv + 1));
+    }
+    if (argc > 1 && strcmp(argv[1], "manifest") == 0)
+    {
+        return (manifest_main(argc - 1, argv + 1));
+    }
+    if (argc > 1 && strcmp(argv[1], "plan") == 0)
+    {
+        return (plan_main(argc - 1, argv + 1));
+    }
+    if (argc > 1 && strcmp(argv[1], "convert") == 0)
+    {
+        return (convert_main(argc - 1, argv + 1));
+    }
     int c;
     string region = "";
     int n_threads = 0;
@@ -54,6 +603,26 @@ int main(int argc, char **argv)
     bool force_samples=false;
     // buffer size is the length of the genomic range of variants that is buffered by GVCFReader
     int buffer_size = 5000;
+    bool sparse_ref_blocks = false;
+    bool sites_only = false;
+    string sites_file = "";
+    string zarr_directory = "";
+    int zarr_max_alleles = 4;
+    bool hail = false;
+    string info_tags = "";
+    string sample_groups_file = "";
+    bool write_index = false;
+    string stats_json = "";
+    double progress_interval = 60;
+    int max_warnings = 20;
+    size_t buffer_memory = 1024;
+    int io_threads = 0;
+    size_t max_open_files = 0;
+    int open_threads = 8;
+    string manifest_file = "";
+    // hidden flag: -@ chunks are not split below this many bp, as each one opens every input.
+    // The regression tests lower it so that the small test inputs are split between threads.
+    int64_t min_chunk_split = 100000;
 
     static struct option loptions[] = {
             {"list",        1, 0, 'l'},
@@ -67,6 +636,24 @@ int main(int argc, char **argv)
             {"max-alleles", 1, 0, 'M'},
 	        {"ignore-non-matching-ref",0,0,1},
 	        {"force-samples",0,0,'s'},
+            {"sparse-ref-blocks", 0, 0, 2},
+            {"sites-only", 0, 0, 3},
+            {"sites", 1, 0, 4},
+            {"zarr", 1, 0, 5},
+            {"zarr-max-alleles", 1, 0, 6},
+            {"hail", 0, 0, 7},
+            {"tags", 1, 0, 8},
+            {"sample-groups", 1, 0, 9},
+            {"write-index", 0, 0, 10},
+            {"stats-json", 1, 0, 11},
+            {"progress-interval", 1, 0, 12},
+            {"max-warnings", 1, 0, 13},
+            {"buffer-memory", 1, 0, 14},
+            {"io-threads", 1, 0, 15},
+            {"max-open-files", 1, 0, 16},
+            {"open-threads", 1, 0, 17},
+            {"manifest", 1, 0, 18},
+            {"min-chunk-split", 1, 0, 19},
             {0,             0, 0, 0}
     };
 
@@ -106,6 +693,60 @@ int main(int argc, char **argv)
             case 's':
 	            force_samples=true;
                 break;
+            case 2:
+                sparse_ref_blocks = true;
+                break;
+            case 3:
+                sites_only = true;
+                break;
+            case 4:
+                sites_file = optarg;
+                break;
+            case 5:
+                zarr_directory = optarg;
+                break;
+            case 6:
+                zarr_max_alleles = stoi(optarg);
+                break;
+            case 7:
+                hail = true;
+                break;
+            case 8:
+                info_tags = optarg;
+                break;
+            case 9:
+                sample_groups_file = optarg;
+                break;
+            case 10:
+                write_index = true;
+                break;
+            case 11:
+                stats_json = optarg;
+                break;
+            case 12:
+                progress_interval = stod(optarg);
+                break;
+            case 13:
+                max_warnings = stoi(optarg);
+                break;
+            case 14:
+                buffer_memory = stoul(optarg);
+                break;
+            case 15:
+                io_threads = stoi(optarg);
+                break;
+            case 16:
+                max_open_files = stoul(optarg);
+                break;
+            case 17:
+                open_threads = stoi(optarg);
+                break;
+            case 18:
+                manifest_file = optarg;
+                break;
+            case 19:
+                min_chunk_split = stoll(optarg);
+                break;
 	        default:
 	            if (optarg != NULL)
 		            ggutils::die("Unknown argument:" + (string) optarg + "\n");
@@ -114,9 +755,9 @@ int main(int argc, char **argv)
         }
     }
 
-    if (gvcf_list.empty())
+    if (gvcf_list.empty() && manifest_file.empty())
     {
-        ggutils::die("--list is required");
+        ggutils::die("--list or --manifest is required");
     }
 
     if (reference_genome.empty())
@@ -127,14 +768,34 @@ int main(int argc, char **argv)
     {
         ggutils::die("invalid output type: " + output_type);
     }
-    if (n_threads != 0)
+    if (hail && !zarr_directory.empty())
+    {
+        ggutils::die("--hail cannot be combined with --zarr, which writes no VCF");
+    }
+    if (hail)
+    {
+        //hail's import_vcf wants block-compressed VCF
+        if (output_type != "z" && output_type != "v")
+            std::cerr << "--hail writes bgzipped VCF, ignoring -O " << output_type << std::endl;
+        output_type = "z";
+    }
+    if (n_threads > 1 && !zarr_directory.empty())
+    {
+        ggutils::die("-@ cannot be combined with --zarr");
+    }
+    if (n_threads > 1 && write_index && (output_file.empty() || output_file == "-" || (output_type != "b" && output_type != "z")))
     {
-        ggutils::die("-@ is not implemented");
+        ggutils::die("--write-index needs a bgzipped output file (-Ob or -Oz)");
     }
     std::cerr << "Logging output to " <<log_file<<std::endl;
 
     // register logger, name of outfile can be set by user on the cmd line
+    // messages are written by a background thread so warnings do not stall the merge on file I/O,
+    // a full queue blocks rather than dropping messages
+    spdlog::set_async_mode(8192, spdlog::async_overflow_policy::block_retry, nullptr, std::chrono::seconds(1));
     std::shared_ptr<spdlog::logger> lg = spdlog::basic_logger_mt("gg_logger", log_file);
+    lg->flush_on(spdlog::level::err);
+    LogThrottle::SetMaxRepeats(max_warnings);
     // format: "*** [YYYY-MM-DD HH:MM:SS]  [loglevel] message ***"
     spdlog::set_pattern(" [%c] [%l] %v");
     std::string commandline = argv[0];
@@ -142,28 +803,74 @@ int main(int argc, char **argv)
     lg->info("Command line: "+commandline);
     lg->info("Starting GVCF merging");
 
+    int is_file = 0;
+    Manifest manifest;
     std::vector<std::string> input_files;
-    ggutils::read_text_file(gvcf_list, input_files);
+    if (!manifest_file.empty())
+    {
+        //chunks of every contig need the bins of every contig
+        manifest.Read(manifest_file, region, is_file, n_threads > 1);
+        lg->info("Read manifest {} with {} inputs", manifest_file, manifest.GetNumInputs());
+    }
+    if (!gvcf_list.empty())
+        ggutils::read_text_file(gvcf_list, input_files);
+    else
+        for (size_t i = 0; i < manifest.GetNumInputs(); i++)
+            input_files.push_back(manifest.GetInput(i).filename);
     if (input_files.empty()) {
-        std::string msg("Empty list of input files: " + gvcf_list);
+        std::string msg("Empty list of input files: " + (gvcf_list.empty() ? manifest_file : gvcf_list));
         lg->error(msg);
         ggutils::die(msg);
     }
 
     unsigned fh_limit = CountFileHandles();
     lg->info("Max number of file handles " + std::to_string(fh_limit));
-    if (fh_limit<=input_files.size()) {
-        std::string msg("You are trying to merge more GVCF files than file handles your OS can open at once ("+std::to_string(fh_limit)+" vs "+std::to_string(input_files.size())+")");
-        lg->error(msg);
-        cerr << msg << std::endl;
-        ggutils::die("Check the output of ulimit -n");
+    //the rest is left for the output, reference, indices and logs. Inputs beyond the limit are reopened as needed.
+    const unsigned fh_reserve = std::min(64u, fh_limit / 2);
+    if (max_open_files == 0 || max_open_files > fh_limit - fh_reserve)
+        max_open_files = fh_limit - fh_reserve;
+
+    if (n_threads > 1 && io_threads > 0)
+    {
+        lg->warn("--io-threads is not used with -@, each merge thread reads its inputs itself");
+        io_threads = 0;
+    }
+    auto new_merger = [&](const string &merge_region, const string &merge_output, const string &output_mode)
+    {
+        //threads share the open file and memory budgets
+        GVCFMerger *g = new GVCFMerger(input_files, merge_output, output_mode, reference_genome, buffer_size, merge_region, is_file,
+                                       ignore_non_matching_ref, force_samples, std::max((size_t) 1, max_open_files / std::max(1, n_threads)),
+                                       open_threads, manifest_file.empty() ? nullptr : &manifest);
+        g->SetMaxAlleles(max_alleles);
+        g->SetSparseRefBlocks(sparse_ref_blocks);
+        g->SetSitesOnly(sites_only);
+        g->SetSites(sites_file);
+        g->SetZarrOutput(zarr_directory, zarr_max_alleles);
+        g->SetHail(hail);
+        g->SetInfoTags(info_tags);
+        g->SetSampleGroups(sample_groups_file);
+        g->SetBufferMemory((buffer_memory << 20) / std::max(1, n_threads));
+        g->SetIoThreads(io_threads);
+        //with -@ every chunk logs its own progress, done and eta are those of its chunk
+        g->SetProgressInterval(progress_interval);
+        return (g);
+    };
+    if (n_threads > 1)
+    {
+        write_chunks(n_threads, min_chunk_split, input_files[0], region, is_file, output_file, output_type, write_index, new_merger);
+    }
+    else
+    {
+        std::unique_ptr<GVCFMerger> g(new_merger(region, output_file, output_type));
+        g->SetWriteIndex(write_index);
+        g->write_vcf();
     }
-    
-    int is_file = 0;
-    GVCFMerger g(input_files, output_file, output_type, reference_genome, buffer_size, region, is_file, ignore_non_matching_ref, force_samples);
-    g.SetMaxAlleles(max_alleles);
-    g.write_vcf();
 
+    LogThrottle::LogSuppressed(lg);
+    StageTimer::LogTotals(lg, elapsed_seconds(start_time));
+    if (!stats_json.empty())
+        StageTimer::WriteJson(stats_json, elapsed_seconds(start_time));
+    log_resource_usage(lg, start_time);
     lg->info("Done");
     spdlog::drop_all();
     return (EXIT_SUCCESS);
@@ -0,0 +1,302 @@
+#include "BatchCombiner.hh"
+#include "RefBlockExpander.hh"
+
+BatchCombiner::BatchCombiner(const std::vector<std::string> &input_files, const std::string &output_file,
+                             const std::string &output_mode, const std::string &sample_groups_file)
+{
+    if (input_files.empty())
+    {
+        ggutils::die("no batches to combine");
+    }
+    _input_names = input_files;
+    for (auto &input_file : input_files)
+    {
+        htsFile *file = hts_open(input_file.c_str(), "r");
+        if (!file)
+        {
+            ggutils::die("problem opening input file: " + input_file);
+        }
+        bcf_hdr_t *header = bcf_hdr_read(file);
+        if (!header)
+        {
+            ggutils::die("problem reading header from: " + input_file);
+        }
+        _input_files.push_back(file);
+        _input_headers.push_back(header);
+        _input_records.push_back(bcf_init());
+        _strings.push_back(nullptr);
+        _num_strings.push_back(0);
+        if (bcf_hdr_nsamples(header) == 0 || !bcf_hdr_idinfo_exists(header, BCF_HL_INFO, bcf_hdr_id2int(header, BCF_DT_ID, "MQ_SUM")))
+        {
+            ggutils::die(input_file + " was not genotyped against a site catalogue with --sites");
+        }
+        if (RefBlockExpander::IsSparse(header))
+        {
+            ggutils::die(input_file + " was written with --sparse-ref-blocks, combine the batches first and then use --sparse-ref-blocks");
+        }
+        if (bcf_hdr_get_hrec(header, BCF_HL_GEN, "gvcfgenotyper_hail", nullptr, nullptr) != nullptr)
+        {
+            ggutils::die(input_file + " was written with --hail, which changes FORMAT after INFO is computed");
+        }
+    }
+    BuildHeader(sample_groups_file);
+
+    _output_file = hts_open(!output_file.empty() ? output_file.c_str() : "-", ("w" + output_mode).c_str());
+    if (!_output_file)
+    {
+        ggutils::die("problem opening output file: " + output_file);
+    }
+    _output_record = bcf_init();
+    _format = new ggutils::vcf_data_t(2, 2, bcf_hdr_nsamples(_output_header));
+    _values = nullptr;
+    _num_values = 0;
+}
+
+BatchCombiner::~BatchCombiner()
+{
+    for (size_t i = 0; i < _input_files.size(); i++)
+    {
+        hts_close(_input_files[i]);
+        bcf_hdr_destroy(_input_headers[i]);
+        bcf_destroy(_input_records[i]);
+        if (_strings[i] != nullptr)
+        {
+            free(_strings[i][0]);
+            free(_strings[i]);
+        }
+    }
+    hts_close(_output_file);
+    bcf_hdr_destroy(_output_header);
+    bcf_destroy(_output_record);
+    delete _format;
+    free(_values);
+}
+
+//the header of the first batch with the samples of the others, the same as the header of a single run
+void BatchCombiner::BuildHeader(const std::string &sample_groups_file)
+{
+    _output_header = bcf_hdr_dup(_input_headers[0]);
+    bcf_hdr_remove(_output_header, BCF_HL_INFO, "MQ_SUM");
+    _has_pl = true;
+    size_t num_sample = 0;
+    for (size_t i = 0; i < _input_headers.size(); i++)
+    {
+        bcf_hdr_t *header = _input_headers[i];
+        int pl_id = bcf_hdr_id2int(header, BCF_DT_ID, "PL");
+        _has_pl &= bcf_hdr_idinfo_exists(header, BCF_HL_FMT, pl_id);
+        _first_sample.push_back(num_sample);
+        num_sample += bcf_hdr_nsamples(header);
+        for (int j = 0; i > 0 && j < bcf_hdr_nsamples(header); j++)
+        {
+            if (bcf_hdr_id2int(_output_header, BCF_DT_SAMPLE, header->samples[j]) >= 0)
+            {
+                ggutils::die("sample " + string(header->samples[j]) + " from " + _input_names[i] + " is in more than one batch");
+            }
+            bcf_hdr_add_sample(_output_header, header->samples[j]);
+        }
+    }
+    if (!_has_pl)
+    {
+        bcf_hdr_remove(_output_header, BCF_HL_FMT, "PL");
+    }
+    bcf_hdr_sync(_output_header);
+
+    //the batches were run with the same --tags
+    string tags;
+    for (auto tag : {"HWE", "MAF", "ExcHet", "F_MISSING"})
+    {
+        if (bcf_hdr_idinfo_exists(_output_header, BCF_HL_INFO, bcf_hdr_id2int(_output_header, BCF_DT_ID, tag)))
+        {
+            tags += (tags.empty() ? "" : ",") + string(tag);
+        }
+    }
+    _cohort_info.SetTags(tags, _output_header);
+
+    //a batch only declares the groups of its own samples, so the groups are read again for all of them
+    bool has_groups = false;
+    for (int i = 0; i < _output_header->nhrec; i++)
+    {
+        bcf_hrec_t *hrec = _output_header->hrec[i];
+        int j = hrec->type == BCF_HL_INFO ? bcf_hrec_find_key(hrec, "ID") : -1;
+        has_groups |= j >= 0 && strncmp(hrec->vals[j], "AC_", 3) == 0;
+    }
+    if (has_groups && sample_groups_file.empty())
+    {
+        ggutils::die(_input_names[0] + " has sample groups, combine needs the same --sample-groups file");
+    }
+    if (!sample_groups_file.empty())
+    {
+        _cohort_info.SetSampleGroups(sample_groups_file, _output_header);
+    }
+    bcf_hdr_sync(_output_header);
+}
+
+//reads the next record of every batch, returns false once all of them are done
+bool BatchCombiner::ReadRecords()
+{
+    size_t num_read = 0;
+    for (size_t i = 0; i < _input_files.size(); i++)
+    {
+        int ret = bcf_read(_input_files[i], _input_headers[i], _input_records[i]);
+        if (ret < -1)
+        {
+            ggutils::die("problem reading " + _input_names[i]);
+        }
+        if (ret == 0)
+        {
+            bcf_unpack(_input_records[i], BCF_UN_ALL);
+            num_read++;
+        }
+    }
+    if (num_read == 0)
+    {
+        return (false);
+    }
+    if (num_read < _input_files.size())
+    {
+        ggutils::die("the batches have different numbers of records, they must be genotyped against the same --sites");
+    }
+
+    bcf1_t *first = _input_records[0];
+    for (size_t i = 1; i < _input_files.size(); i++)
+    {
+        bcf1_t *record = _input_records[i];
+        bool same = record->pos == first->pos && record->n_allele == first->n_allele &&
+                    strcmp(bcf_hdr_id2name(_input_headers[i], record->rid), bcf_hdr_id2name(_input_headers[0], first->rid)) == 0;
+        for (int j = 0; same && j < first->n_allele; j++)
+        {
+            same = strcmp(record->d.allele[j], first->d.allele[j]) == 0;
+        }
+        if (!same)
+        {
+            ggutils::die(ggutils::record2string(_input_headers[i], record) + " in " + _input_names[i] + " does not match " +
+                         ggutils::record2string(_input_headers[0], first) + " in " + _input_names[0] +
+                         ", the batches must be genotyped against the same --sites");
+        }
+    }
+    return (true);
+}
+
+//copies per_sample values of each sample of a batch to dst, returns false if the batch record does not have the tag
+bool BatchCombiner::CopyFormat(size_t batch, const char *tag, int32_t *dst, size_t per_sample)
+{
+    int ret = bcf_get_format_int32(_input_headers[batch], _input_records[batch], tag, &_values, &_num_values);
+    if (ret <= 0)
+    {
+        return (false);
+    }
+    size_t num_sample = bcf_hdr_nsamples(_input_headers[batch]);
+    size_t num_values = ret / num_sample;
+    for (size_t i = 0; i < num_sample; i++)
+    {
+        int32_t *sample_dst = dst + (_first_sample[batch] + i) * per_sample;
+        for (size_t j = 0; j < per_sample; j++)
+        {
+            sample_dst[j] = j < num_values ? _values[i * num_values + j] : bcf_int32_vector_end;
+        }
+    }
+    return (true);
+}
+
+void BatchCombiner::CopyFt(size_t batch)
+{
+    int ret = bcf_get_format_string(_input_headers[batch], _input_records[batch], "FT", &_strings[batch], &_num_strings[batch]);
+    for (int i = 0; i < bcf_hdr_nsamples(_input_headers[batch]); i++)
+    {
+        char *&ft = _format->ft[_first_sample[batch] + i];
+        free(ft);
+        ft = strdup(ret > 0 ? _strings[batch][i] : ".");
+    }
+}
+
+void BatchCombiner::CombineRecords()
+{
+    bcf1_t *first = _input_records[0];
+    bcf_clear(_output_record);
+    _output_record->rid = first->rid;
+    _output_record->pos = first->pos;
+    bcf_update_id(_output_header, _output_record, ".");
+    bcf_update_alleles(_output_header, _output_record, (const char **) first->d.allele, first->n_allele);
+
+    const int num_allele = first->n_allele;
+    const int num_pl_per_sample = ggutils::get_number_of_gt_combinations(2, num_allele);
+    _format->resize(num_allele);
+    _format->set_missing();
+    bool has_strand_ad = true;
+    int32_t sum_mq[2] = {0, 0};
+    _output_record->qual = 0;
+    for (size_t i = 0; i < _input_files.size(); i++)
+    {
+        bcf1_t *record = _input_records[i];
+        if (!bcf_float_is_missing(record->qual))
+        {
+            _output_record->qual += record->qual;
+        }
+        int num_mq = bcf_get_info_int32(_input_headers[i], record, "MQ_SUM", &_values, &_num_values);
+        if (num_mq == 2)
+        {
+            sum_mq[0] += _values[0];
+            sum_mq[1] += _values[1];
+        }
+        CopyFormat(i, "GT", _format->gt, 2);
+        CopyFt(i);
+        CopyFormat(i, "GQ", _format->gq, 1);
+        CopyFormat(i, "GQX", _format->gqx, 1);
+        CopyFormat(i, "DP", _format->dp, 1);
+        CopyFormat(i, "DPF", _format->dpf, 1);
+        CopyFormat(i, "AD", _format->ad, num_allele);
+        //a run only writes ADF/ADR if every input has them, so the batches have to agree
+        has_strand_ad &= CopyFormat(i, "ADF", _format->adf, num_allele);
+        has_strand_ad &= CopyFormat(i, "ADR", _format->adr, num_allele);
+        if (_has_pl)
+        {
+            CopyFormat(i, "PL", _format->pl, num_pl_per_sample);
+        }
+    }
+
+    //same INFO and FORMAT order as GVCFMerger
+    if (sum_mq[1] > 0)
+    {
+        int32_t mq = sum_mq[0] / sum_mq[1];
+        assert(bcf_update_info_int32(_output_header, _output_record, "MQ", &mq, 1) == 0);
+    }
+    _cohort_info.Update(_output_header, _output_record, _format, has_strand_ad);
+
+    size_t num_sample = _format->num_sample;
+    assert(bcf_update_genotypes(_output_header, _output_record, _format->gt, num_sample * 2) == 0);
+    assert(bcf_update_format_string(_output_header, _output_record, "FT", (const char **) _format->ft, num_sample) == 0);
+    assert(bcf_update_format_int32(_output_header, _output_record, "GQ", _format->gq, num_sample) == 0);
+    assert(bcf_update_format_int32(_output_header, _output_record, "GQX", _format->gqx, num_sample) == 0);
+    assert(bcf_update_format_int32(_output_header, _output_record, "DP", _format->dp, num_sample) == 0);
+    assert(bcf_update_format_int32(_output_header, _output_record, "DPF", _format->dpf, num_sample) == 0);
+    assert(bcf_update_format_int32(_output_header, _output_record, "AD", _format->ad, num_sample * num_allele) == 0);
+    if (has_strand_ad)
+    {
+        assert(bcf_update_format_int32(_output_header, _output_record, "ADF", _format->adf, num_sample * num_allele) == 0);
+        assert(bcf_update_format_int32(_output_header, _output_record, "ADR", _format->adr, num_sample * num_allele) == 0);
+    }
+    //the batches already replaced all-missing PL with dummy values
+    if (_has_pl)
+    {
+        assert(bcf_update_format_int32(_output_header, _output_record, "PL", _format->pl, _format->num_pl) == 0);
+    }
+}
+
+int BatchCombiner::Combine()
+{
+    int num_written = 0;
+    if (bcf_hdr_write(_output_file, _output_header) != 0)
+    {
+        ggutils::die("problem writing header");
+    }
+    while (ReadRecords())
+    {
+        CombineRecords();
+        if (bcf_write1(_output_file, _output_header, _output_record) != 0)
+        {
+            ggutils::die("problem writing record");
+        }
+        num_written++;
+    }
+    return (num_written);
+}
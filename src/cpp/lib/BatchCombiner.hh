@@ -0,0 +1,60 @@
+//
+// Combines the outputs of sample batches genotyped against the same site catalogue (--sites).
+//
+
+#ifndef GVCFGENOTYPER_BATCHCOMBINER_HH
+#define GVCFGENOTYPER_BATCHCOMBINER_HH
+
+extern "C" {
+#include <htslib/hts.h>
+#include <htslib/vcf.h>
+}
+
+#include "ggutils.hh"
+#include "CohortInfo.hh"
+
+//Pastes the samples of the batches record by record and recomputes the cohort INFO from their FORMAT values,
+//so the output is the same as a single run over every sample. QUAL and MQ are summed from the batch QUAL and
+//INFO/MQ_SUM since their per-sample terms are not in FORMAT. The batches must have the same records in the same
+//order, which --sites guarantees when they are run with the same catalogue, region and --max-alleles.
+//Two things are done per batch rather than over the cohort: QUAL is added up in float precision in another
+//order, and a batch where no sample has PL at a site gets the dummy PL that a single run only writes when no
+//sample of the cohort has any.
+class BatchCombiner
+{
+public:
+    //sample_groups_file is the --sample-groups file of the batches, the groups are counted over all samples
+    BatchCombiner(const std::vector<std::string> &input_files, const std::string &output_file, const std::string &output_mode,
+                  const std::string &sample_groups_file = "");
+    ~BatchCombiner();
+
+    //combines every record of the batches, returns the number of records written
+    int Combine();
+    bcf_hdr_t *GetHeader() {return _output_header;};
+
+private:
+    void BuildHeader(const std::string &sample_groups_file);
+    bool ReadRecords();
+    void CombineRecords();
+    bool CopyFormat(size_t batch, const char *tag, int32_t *dst, size_t per_sample);
+    void CopyFt(size_t batch);
+
+    std::vector<std::string> _input_names;
+    std::vector<htsFile *> _input_files;
+    std::vector<bcf_hdr_t *> _input_headers;
+    std::vector<bcf1_t *> _input_records;
+    std::vector<size_t> _first_sample;//index of each batch's first sample in the output
+    htsFile *_output_file;
+    bcf_hdr_t *_output_header;
+    bcf1_t *_output_record;
+    ggutils::vcf_data_t *_format;
+    CohortInfo _cohort_info;
+    bool _has_pl;
+    int32_t *_values;
+    int _num_values;
+    //htslib sizes the string pointers for the samples of the first header they are used with, so one per batch
+    std::vector<char **> _strings;
+    std::vector<int> _num_strings;
+};
+
+#endif //GVCFGENOTYPER_BATCHCOMBINER_HH
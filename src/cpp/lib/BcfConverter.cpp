@@ -0,0 +1,132 @@
+#include "BcfConverter.hh"
+#include "ggutils.hh"
+
+#include <thread>
+#include <atomic>
+#include <map>
+#include <algorithm>
+
+extern "C" {
+#include <htslib/vcf.h>
+#include <htslib/hts.h>
+#include <htslib/bgzf.h>
+}
+
+static bool strip_suffix(std::string &name, const std::string &suffix)
+{
+    if (name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+        return (false);
+    name.erase(name.size() - suffix.size());
+    return (true);
+}
+
+BcfConverter::BcfConverter(const std::string &output_dir, int compression_level)
+{
+    _output_dir = output_dir;
+    while (_output_dir.size() > 1 && _output_dir.back() == '/')
+        _output_dir.pop_back();
+    if (_output_dir.empty())
+        _output_dir = ".";
+    _compression_level = compression_level;
+    _num_records = 0;
+}
+
+std::string BcfConverter::GetOutput(const std::string &filename) const
+{
+    std::string name = filename.substr(filename.find_last_of('/') + 1);
+    strip_suffix(name, ".gz");
+    if (!strip_suffix(name, ".vcf") && !strip_suffix(name, ".gvcf"))
+        strip_suffix(name, ".bcf");
+    return (_output_dir + "/" + name + ".bcf");
+}
+
+void BcfConverter::Convert(const std::vector<std::string> &filenames, int num_threads)
+{
+    _outputs.clear();
+    std::map<std::string, std::string> inputs;//output -> input
+    for (auto &filename : filenames)
+    {
+        std::string output = GetOutput(filename);
+        if (output == filename)
+            ggutils::die("converting " + filename + " would overwrite it, choose another output directory");
+        auto inserted = inputs.emplace(output, filename);
+        if (!inserted.second)
+            ggutils::die(filename + " and " + inserted.first->second + " would both be written to " + output);
+        _outputs.push_back(output);
+    }
+
+    std::vector<uint64_t> num_records(filenames.size(), 0);
+    std::atomic<size_t> next(0);
+    auto convert = [&]()
+    {
+        for (size_t i = next++; i < filenames.size(); i = next++)
+            num_records[i] = ConvertOne(filenames[i], _outputs[i]);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads && (size_t) t < filenames.size(); t++)
+        threads.emplace_back(convert);
+    convert();
+    for (auto &t : threads)
+        t.join();
+    for (auto n : num_records)
+        _num_records += n;
+}
+
+uint64_t BcfConverter::ConvertOne(const std::string &input, const std::string &output) const
+{
+    htsFile *in = hts_open(input.c_str(), "r");
+    if (in == nullptr)
+        ggutils::die("problem opening " + input);
+    bcf_hdr_t *header = bcf_hdr_read(in);
+    if (header == nullptr)
+        ggutils::die("problem reading the header of " + input);
+    std::string mode = "wb" + (_compression_level >= 0 ? std::to_string(_compression_level) : "");
+    htsFile *out = hts_open(output.c_str(), mode.c_str());
+    if (out == nullptr)
+        ggutils::die("problem opening " + output);
+    if (bcf_hdr_write(out, header) < 0)
+        ggutils::die("problem writing " + output);
+    //vcf_parse1 adds what the header lacks, which the BCF header already written would not have
+    int num_ids = header->n[BCF_DT_ID], num_contigs = header->n[BCF_DT_CTG];
+
+    //same bins as bcf_index_build(output, 14)
+    int min_shift = 14, n_lvls;
+    int64_t max_len = 0;
+    for (int i = 0; i < num_contigs; i++)
+        max_len = std::max(max_len, ggutils::get_contig_length(header, i));
+    if (!max_len) max_len = ((int64_t) 1 << 31) - 1;
+    max_len += 256;
+    for (n_lvls = 0; max_len > ((int64_t) 1 << (min_shift + 3 * n_lvls)); n_lvls++);
+    hts_idx_t *index = hts_idx_init(num_contigs, HTS_FMT_CSI, bgzf_tell(out->fp.bgzf), min_shift, n_lvls);
+    if (index == nullptr)
+        ggutils::die("problem initialising index for " + output);
+
+    bcf1_t *record = bcf_init1();
+    uint64_t num_records = 0;
+    int ret;
+    while ((ret = bcf_read(in, header, record)) == 0)
+    {
+        if (record->errcode != 0)
+            ggutils::die("problem parsing " + input + " at record " + std::to_string(num_records + 1));
+        if (header->n[BCF_DT_ID] != num_ids || header->n[BCF_DT_CTG] != num_contigs)
+            ggutils::die("the header of " + input + " does not define all the contigs and fields of its records");
+        if (bcf_write(out, header, record) < 0)
+            ggutils::die("problem writing " + output);
+        if (hts_idx_push(index, record->rid, record->pos, record->pos + record->rlen, bgzf_tell(out->fp.bgzf), 1) < 0)
+            ggutils::die("problem indexing " + output + ", is " + input + " sorted?");
+        num_records++;
+    }
+    if (ret < -1)
+        ggutils::die("problem reading " + input);
+    hts_idx_finish(index, bgzf_tell(out->fp.bgzf));
+    //close the output first, htslib warns about indices older than their data file
+    if (hts_close(out) != 0)
+        ggutils::die("problem closing " + output);
+    if (hts_idx_save(index, output.c_str(), HTS_FMT_CSI) < 0)
+        ggutils::die("problem writing index for " + output);
+    hts_idx_destroy(index);
+    bcf_destroy1(record);
+    bcf_hdr_destroy(header);
+    hts_close(in);
+    return (num_records);
+}
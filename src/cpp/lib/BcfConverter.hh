@@ -0,0 +1,42 @@
+//
+// Rewrites a cohort's GVCFs as CSI-indexed BCF, the input gvcfgenotyper reads fastest.
+//
+
+#ifndef GVCFGENOTYPER_BCFCONVERTER_HH
+#define GVCFGENOTYPER_BCFCONVERTER_HH
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//Each input becomes <output_dir>/<name>.bcf, where name is its file name without .gz and .vcf/.gvcf, with
+//its .csi built while it is written. Headers and records are kept as they are. Text GVCFs are parsed by every
+//run that reads them, so a cohort that is merged more than once, eg. shard by shard, is cheaper to convert
+//first. Inputs must be sorted and their headers must define every contig and field of their records.
+class BcfConverter
+{
+public:
+    //compression_level -1 is the BGZF default
+    BcfConverter(const std::string &output_dir, int compression_level);
+
+    //converts the inputs num_threads at a time, dies if two of them would be written to the same file
+    void Convert(const std::vector<std::string> &filenames, int num_threads);
+
+    //output of each input, in input order
+    const std::vector<std::string> &GetOutputs() const {return (_outputs);};
+    uint64_t GetNumRecords() const {return (_num_records);};
+
+    //output file of an input
+    std::string GetOutput(const std::string &filename) const;
+
+private:
+    //number of records written
+    uint64_t ConvertOne(const std::string &input, const std::string &output) const;
+
+    std::string _output_dir;
+    int _compression_level;
+    std::vector<std::string> _outputs;
+    uint64_t _num_records;
+};
+
+#endif //GVCFGENOTYPER_BCFCONVERTER_HH
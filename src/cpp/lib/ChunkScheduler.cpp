@@ -0,0 +1,195 @@
+#include "ChunkScheduler.hh"
+#include "ggutils.hh"
+
+#include <algorithm>
+
+extern "C" {
+#include <htslib/synced_bcf_reader.h>
+}
+
+ChunkScheduler::ChunkScheduler(const bcf_hdr_t *header, const std::string &region, int is_file, int num_chunks,
+                               int64_t min_split)
+{
+    _header = header;
+    _min_split = std::max((int64_t) 1, min_split);
+    _num_steals = 0;
+    int num_contigs = header->n[BCF_DT_CTG];
+    if (region.empty())
+    {
+        for (int rid = 0; rid < num_contigs; rid++)
+        {
+            int64_t length = ggutils::get_contig_length(header, rid);
+            _segments.push_back({rid, 0, length > 0 ? length : 1, length <= 0, 0});
+        }
+    }
+    else
+    {
+        bcf_sr_regions_t *regions = bcf_sr_regions_init(region.c_str(), is_file, 0, 1, -2);
+        if (regions == nullptr)
+            ggutils::die("Cannot navigate to region " + region);
+        while (bcf_sr_regions_next(regions) == 0)
+        {
+            const char *seq = regions->seq_names[regions->iseq];
+            int rid = bcf_hdr_name2id(header, seq);
+            if (rid < 0)
+                ggutils::die(std::string(seq) + " is not a contig of the inputs");
+            int64_t length = ggutils::get_contig_length(header, rid);
+            int64_t end = (int64_t) regions->end + 1;
+            if (length > 0)
+                end = std::min(end, length);
+            if (regions->start >= end && length > 0)
+                continue;
+            //a whole contig without a length
+            if (length <= 0)
+                _segments.push_back({rid, regions->start, regions->start + 1, true, 0});
+            else
+                _segments.push_back({rid, regions->start, end, false, 0});
+        }
+        bcf_sr_regions_destroy(regions);
+        std::sort(_segments.begin(), _segments.end(), [](const segment_t &a, const segment_t &b)
+        {
+            return (a.rid < b.rid || (a.rid == b.rid && a.beg < b.beg));
+        });
+    }
+    if (_segments.empty())
+        ggutils::die("no contigs to merge");
+    _length = 0;
+    for (auto &s : _segments)
+    {
+        s.offset = _length;
+        _length += s.end - s.beg;
+    }
+
+    num_chunks = (int) std::max((int64_t) 1, std::min((int64_t) num_chunks, _length));
+    for (int k = 0; k < num_chunks; k++)
+    {
+        int64_t beg = _length * k / num_chunks, end = _length * (k + 1) / num_chunks;
+        _chunks.push_back({beg, end, beg, false});
+        _order.emplace(beg, k);
+        _queue.push_back(k);
+    }
+}
+
+size_t ChunkScheduler::FindSegment(int64_t x)
+{
+    auto it = std::upper_bound(_segments.begin(), _segments.end(), x, [](int64_t value, const segment_t &s)
+    {
+        return (value < s.offset);
+    });
+    return (it - _segments.begin() - 1);
+}
+
+int64_t ChunkScheduler::Locate(int rid, int64_t pos)
+{
+    auto it = std::upper_bound(_segments.begin(), _segments.end(), std::make_pair(rid, pos),
+                               [](const std::pair<int, int64_t> &value, const segment_t &s)
+                               {
+                                   return (value.first < s.rid || (value.first == s.rid && value.second < s.beg));
+                               });
+    if (it == _segments.begin() || (it - 1)->rid != rid)
+        return (-1);
+    const segment_t &s = *(it - 1);
+    return (s.offset + std::min(pos, s.end - 1) - s.beg);
+}
+
+bool ChunkScheduler::Next(size_t &chunk)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_queue.empty())
+    {
+        chunk = _queue.front();
+        _queue.pop_front();
+        return (true);
+    }
+    //the running chunk with the most left to write
+    size_t victim = _chunks.size();
+    int64_t most_left = 0;
+    for (size_t k = 0; k < _chunks.size(); k++)
+    {
+        int64_t left = _chunks[k].end - _chunks[k].pos;
+        if (!_chunks[k].finished && left > most_left)
+        {
+            victim = k;
+            most_left = left;
+        }
+    }
+    if (victim == _chunks.size() || most_left < 2 * _min_split)
+        return (false);
+    int64_t cut = _chunks[victim].pos + most_left / 2;
+    chunk = _chunks.size();
+    _chunks.push_back({cut, _chunks[victim].end, cut, false});
+    _chunks[victim].end = cut;
+    _order.emplace(cut, chunk);
+    _num_steals++;
+    return (true);
+}
+
+std::string ChunkScheduler::GetRegion(size_t chunk)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const chunk_t &c = _chunks[chunk];
+    std::string ret;
+    for (size_t i = FindSegment(c.beg); i < _segments.size() && _segments[i].offset < c.end; i++)
+    {
+        const segment_t &s = _segments[i];
+        if (!ret.empty())
+            ret += ',';
+        ret += bcf_hdr_id2name(_header, s.rid);
+        int64_t beg = s.beg + std::max((int64_t) 0, c.beg - s.offset);
+        if (!s.open_end)
+            ret += ":" + std::to_string(beg + 1) + "-" + std::to_string(s.end);
+        else if (beg > 0)
+            ret += ":" + std::to_string(beg + 1);
+    }
+    return (ret);
+}
+
+bool ChunkScheduler::Continue(size_t chunk, int rid, int64_t pos)
+{
+    int64_t x = Locate(rid, pos);
+    std::lock_guard<std::mutex> lock(_mutex);
+    chunk_t &c = _chunks[chunk];
+    if (x < 0)
+        return (true);
+    if (x >= c.end)
+        return (false);
+    c.pos = std::max(c.pos, x);
+    return (true);
+}
+
+void ChunkScheduler::Finish(size_t chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _chunks[chunk].finished = true;
+        _chunks[chunk].pos = _chunks[chunk].end;
+    }
+    _finished.notify_all();
+}
+
+bool ChunkScheduler::NextFinished(size_t &chunk)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    //a chunk is only split while it runs, so the piece cut off it is queued before it can finish
+    _finished.wait(lock, [this]()
+    {
+        return (_order.empty() || _chunks[_order.begin()->second].finished);
+    });
+    if (_order.empty())
+        return (false);
+    chunk = _order.begin()->second;
+    _order.erase(_order.begin());
+    return (true);
+}
+
+size_t ChunkScheduler::GetNumChunks()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_chunks.size());
+}
+
+size_t ChunkScheduler::GetNumSteals()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_num_steals);
+}
@@ -0,0 +1,76 @@
+//
+// Hands out genomic chunks to the merge threads of one run, splitting the remainder of slow chunks for idle threads.
+//
+
+#ifndef GVCFGENOTYPER_CHUNKSCHEDULER_HH
+#define GVCFGENOTYPER_CHUNKSCHEDULER_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+//The region (or every contig of the header) is laid end to end and cut into num_chunks chunks of equal
+//length, queued in genomic order. Each thread merges one chunk at a time into a file of its own. Once the
+//queue is empty, an idle thread takes the second half of what is left of the chunk furthest from done, so a
+//dense stretch such as HLA is shared out instead of holding up the run. The chunk being split stops writing at
+//the cut, which is always after the last record it wrote. Chunk 0 starts the output and finished chunks are
+//handed back in genomic order, however they were split, so that their files can be concatenated.
+class ChunkScheduler
+{
+public:
+    //chunks are not split below min_split bp
+    ChunkScheduler(const bcf_hdr_t *header, const std::string &region, int is_file, int num_chunks, int64_t min_split);
+
+    //a queued chunk, else the remainder of the running chunk with the most left. false once there is nothing to split.
+    bool Next(size_t &chunk);
+    //-r argument of a chunk. It runs to the end of the contig (or region) of its last base, so that records
+    //left-aligned across the chunk end are still read and written by this chunk.
+    std::string GetRegion(size_t chunk);
+    //the chunk is about to write a record at rid/pos: false once that is at or past its end, which Next() may have moved
+    bool Continue(size_t chunk, int rid, int64_t pos);
+    void Finish(size_t chunk);
+    //waits for the next chunk in genomic order to finish, false once every chunk has been returned
+    bool NextFinished(size_t &chunk);
+
+    size_t GetNumChunks();
+    size_t GetNumSteals();
+
+private:
+    struct segment_t
+    {
+        int rid;
+        int64_t beg, end;//0-based, end exclusive
+        bool open_end;//contig without a length, counted as 1bp and never split
+        int64_t offset;//position of beg when the segments are laid end to end
+    };
+    struct chunk_t
+    {
+        int64_t beg, end, pos;//end to end positions, pos is the last record written
+        bool finished;
+    };
+    //end to end position of rid/pos, -1 if it is in no segment
+    int64_t Locate(int rid, int64_t pos);
+    //segment holding end to end position x
+    size_t FindSegment(int64_t x);
+
+    const bcf_hdr_t *_header;
+    std::vector<segment_t> _segments;
+    int64_t _length;
+    int64_t _min_split;
+    std::vector<chunk_t> _chunks;
+    std::deque<size_t> _queue;
+    std::map<int64_t, size_t> _order;//chunks not yet returned by NextFinished, by their start
+    size_t _num_steals;
+    std::mutex _mutex;
+    std::condition_variable _finished;
+};
+
+#endif //GVCFGENOTYPER_CHUNKSCHEDULER_HH
@@ -0,0 +1,371 @@
+#include "CohortInfo.hh"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+
+#include "spdlog.h"
+
+CohortInfo::CohortInfo()
+{
+    _header = nullptr;
+    _record = nullptr;
+    _format = nullptr;
+    _tag_hwe = _tag_maf = _tag_exc_het = _tag_f_missing = false;
+}
+
+void CohortInfo::SetTags(const std::string &tags, bcf_hdr_t *header)
+{
+    vector<string> tag_list;
+    ggutils::strsplit(tags, ',', tag_list);
+    for (auto tag = tag_list.begin(); tag != tag_list.end(); tag++)
+    {
+        if (*tag == "HWE")
+        {
+            _tag_hwe = true;
+            bcf_hdr_append(header, "##INFO=<ID=HWE,Number=A,Type=Float,Description=\"HWE test (PMID:15789306); 1=good, 0=bad\">");
+        }
+        else if (*tag == "MAF")
+        {
+            _tag_maf = true;
+            bcf_hdr_append(header, "##INFO=<ID=MAF,Number=A,Type=Float,Description=\"Minor Allele frequency\">");
+        }
+        else if (*tag == "ExcHet")
+        {
+            _tag_exc_het = true;
+            bcf_hdr_append(header, "##INFO=<ID=ExcHet,Number=A,Type=Float,Description=\"Test excess heterozygosity; 1=good, 0=bad\">");
+        }
+        else if (*tag == "F_MISSING")
+        {
+            _tag_f_missing = true;
+            bcf_hdr_append(header, "##INFO=<ID=F_MISSING,Number=1,Type=Float,Description=\"Fraction of missing genotypes (all samples)\">");
+        }
+        else
+        {
+            ggutils::die("unknown tag " + *tag + ", valid tags are HWE,MAF,ExcHet,F_MISSING");
+        }
+    }
+}
+
+void CohortInfo::SetSampleGroups(const std::string &sample_groups_file, bcf_hdr_t *header)
+{
+    auto lg = spdlog::get("gg_logger");
+    vector<string> lines;
+    ggutils::read_text_file(sample_groups_file, lines);
+    for (auto line = lines.begin(); line != lines.end(); line++)
+    {
+        std::istringstream ss(*line);
+        string sample, groups;
+        if (!(ss >> sample >> groups))
+        {
+            continue;
+        }
+        vector<string> group_list;
+        ggutils::strsplit(groups, ',', group_list);
+        //AC_<group> and AN_<group> must be valid INFO IDs, which htslib would otherwise refuse without an error
+        for (auto group = group_list.begin(); group != group_list.end(); group++)
+        {
+            if (group->empty() || group->find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.") != string::npos)
+            {
+                ggutils::die("sample group \"" + *group + "\" in " + sample_groups_file + " is not a valid INFO ID, use only letters, digits, _ and .");
+            }
+        }
+        int sample_index = bcf_hdr_id2int(header, BCF_DT_SAMPLE, sample.c_str());
+        if (sample_index < 0)
+        {
+            lg->warn("Sample {} from {} is not in the input GVCFs", sample, sample_groups_file);
+            continue;
+        }
+        for (auto group = group_list.begin(); group != group_list.end(); group++)
+        {
+            size_t group_index = std::find(_group_names.begin(), _group_names.end(), *group) - _group_names.begin();
+            if (group_index == _group_names.size())
+            {
+                _group_names.push_back(*group);
+                _group_samples.push_back(vector<size_t>());
+                bcf_hdr_append(header, ("##INFO=<ID=AC_" + *group + ",Number=A,Type=Integer,Description=\"Allele count in genotypes of group " + *group + "\">").c_str());
+                bcf_hdr_append(header, ("##INFO=<ID=AN_" + *group + ",Number=1,Type=Integer,Description=\"Total number of alleles in called genotypes of group " + *group + "\">").c_str());
+            }
+            //a sample listed twice, or with the same group twice, is counted once
+            vector<size_t> &samples = _group_samples[group_index];
+            if (std::find(samples.begin(), samples.end(), (size_t) sample_index) == samples.end())
+                samples.push_back(sample_index);
+        }
+    }
+    lg->info("Read {} sample groups from {}", _group_names.size(), sample_groups_file);
+}
+
+void CohortInfo::Update(bcf_hdr_t *header, bcf1_t *record, const ggutils::vcf_data_t *format, bool has_strand_ad)
+{
+    _header = header;
+    _record = record;
+    _format = format;
+    const size_t num_sample = _format->num_sample;
+    const int num_allele = _record->n_allele;
+    const int num_gt_per_sample = ggutils::get_number_of_gt_combinations(_format->ploidy, num_allele);
+    _info_adf.assign(num_allele, 0);
+    _info_adr.assign(num_allele, 0);
+    _info_ac.assign(num_allele, 0);
+    _info_gc.assign(num_gt_per_sample, 0);
+
+    // Calculate AC/AN directly from our GT buffer (same counting rules as htslib's bcf_calc_ac)
+    for (size_t i=0; i<num_sample*2; i++)
+    {
+        if (_format->gt[i] == bcf_int32_vector_end || bcf_gt_is_missing(_format->gt[i]))
+            continue;
+        assert(bcf_gt_allele(_format->gt[i]) < num_allele);
+        _info_ac[bcf_gt_allele(_format->gt[i])]++;
+    }
+    // sum over all allele counts to get AN
+    int an = 0;
+    for (int i=0; i<num_allele; i++)
+        an += _info_ac[i];
+
+    bcf_update_info_int32(_header, _record, "AN", &an, 1);
+    bcf_update_info_int32(_header, _record, "AC", _info_ac.data()+1, num_allele-1);
+
+    // Calculate INFO/ADF + INFO/ADR
+    if(has_strand_ad)
+    {
+        for (size_t i=0;i<(num_sample*num_allele);i+=num_allele)
+        {
+            bool all_info_adf_missing(true);
+            bool all_info_adr_missing(true);
+            for (int j=0;j<num_allele;++j)
+            {
+                assert( (_format->adr[i+j]==bcf_int32_missing) == (_format->adf[i+j]==bcf_int32_missing) );
+                if(_format->adf[i+j]!=bcf_int32_missing)
+                {
+                    _info_adf[j] += _format->adf[i+j];
+                    all_info_adf_missing = false;
+                }
+                if(_format->adr[i+j]!=bcf_int32_missing)
+                {
+                    _info_adr[j] += _format->adr[i+j];
+                    all_info_adr_missing = false;
+                }
+            }
+            // Set INFO/ADF array entries to dummy value if they are all missing
+            if (all_info_adf_missing) {
+                std::fill(_info_adf.begin(),_info_adf.end(),0);
+            }
+            // Set INFO/ADR array entries to dummy value if they are all missing
+            if (all_info_adr_missing) {
+                std::fill(_info_adr.begin(),_info_adr.end(),0);
+            }
+        }
+        bcf_update_info_int32(_header,_record,"ADF",_info_adf.data(),num_allele);
+        bcf_update_info_int32(_header,_record,"ADR",_info_adr.data(),num_allele);
+        ggutils::fisher_sb_test(_info_adr.data(),_info_adf.data(),num_allele,_sb_pvalue);
+        bcf_update_info_float(_header,_record,"FS",_sb_pvalue.data(),num_allele-1);
+    }
+
+    // Calculate INFO/HOM (probably better called INFO/HOM_ALT?)
+    if (_format->ploidy>1)
+    {
+        int32_t n_hom_alt=0;
+        for(size_t i=0;i<num_sample;++i)
+        {
+            if (!bcf_gt_is_missing(_format->gt[2*i]) && !bcf_gt_is_missing(_format->gt[2*i+1])) {
+                if (bcf_gt_allele(_format->gt[2*i])==bcf_gt_allele(_format->gt[2*i+1])) {
+                    ++n_hom_alt;
+                }
+            }
+        }
+        bcf_update_info_int32(_header,_record,"HOM",&n_hom_alt,1);
+    }
+
+    // Calculate INFO/GC
+    if (_format->ploidy>1)
+    {
+        for(size_t i=0;i<num_sample;++i)
+        {
+            if (!bcf_gt_is_missing(_format->gt[2*i]) && !bcf_gt_is_missing(_format->gt[2*i+1])) {
+                if ( (_format->gt[2*i] == bcf_int32_vector_end) ||
+                     (_format->gt[2*i+1] == bcf_int32_vector_end) ) {
+                       // this indicates a sample with ploidy==1 which we skip
+                       continue;
+                }
+                int gt0 = bcf_gt_allele(_format->gt[2*i]);
+                int gt1 = bcf_gt_allele(_format->gt[2*i+1]);
+                size_t idx = bcf_alleles2gt(gt0,gt1);
+                _info_gc[idx] += 1;
+            }
+        }
+        assert(bcf_update_info_int32(_header,_record,"GC",_info_gc.data(),num_gt_per_sample)==0);
+    }
+
+    SetMedianInfoValues();
+    SetHistogramInfoValues();
+    if (_tag_hwe || _tag_maf || _tag_exc_het || _tag_f_missing)
+        SetQcInfoValues(an);
+    if (!_group_names.empty())
+        SetGroupInfoValues();
+}
+
+std::vector<int> CohortInfo::FindAltGenotypes(const int allele)
+{
+    std::vector<int> indices_of_alt_genotypes;
+    for(size_t i=0;i<_format->num_sample;++i)
+    {
+        bool is_alt(false);
+        if(_format->ploidy==1)
+            is_alt = !bcf_gt_is_missing(_format->gt[i]) && bcf_gt_allele(_format->gt[i])==allele;
+        else
+            is_alt = !bcf_gt_is_missing(_format->gt[2*i+1]) && !bcf_gt_is_missing(_format->gt[2*i]) && (bcf_gt_allele(_format->gt[2*i])==allele||bcf_gt_allele(_format->gt[2*i+1])==allele);
+        if(is_alt) {
+            indices_of_alt_genotypes.push_back(i);
+        }
+    }
+    return indices_of_alt_genotypes;
+}
+
+void CohortInfo::SetMedianInfoValues()
+{
+    std::vector<float> median_gq(_record->n_allele);
+    std::vector<float> median_gqx(_record->n_allele);
+    std::vector<float> median_dp(_record->n_allele);
+    for(int allele=0;allele<_record->n_allele;allele++)
+    {
+        std::vector<int> indices_of_alt_genotypes = FindAltGenotypes(allele);
+        // INFO/GQX_MEDIAN
+        std::vector<int> values_at_alt_genotypes;
+        for(const auto alt_gt : indices_of_alt_genotypes) {
+            if(_format->gq[alt_gt]!=bcf_int32_missing)
+                values_at_alt_genotypes.push_back(_format->gq[alt_gt]);
+        }
+        bcf_float_set_missing(median_gq[allele]);
+        if(!values_at_alt_genotypes.empty())
+            median_gq[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
+
+        // INFO/GQ_MEDIAN
+        values_at_alt_genotypes.clear();
+        for(const auto alt_gt : indices_of_alt_genotypes) {
+            if(_format->gqx[alt_gt]!=bcf_int32_missing)
+                values_at_alt_genotypes.push_back(_format->gqx[alt_gt]);
+        }
+        bcf_float_set_missing(median_gqx[allele]);
+        if(!values_at_alt_genotypes.empty())
+            median_gqx[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
+
+        // INFO/DP_MEDIAN
+        values_at_alt_genotypes.clear();
+        for(const auto alt_gt : indices_of_alt_genotypes) {
+            if(_format->dp[alt_gt]!=bcf_int32_missing)
+                values_at_alt_genotypes.push_back(_format->dp[alt_gt]);
+        }
+        bcf_float_set_missing(median_dp[allele]);
+        if(!values_at_alt_genotypes.empty())
+            median_dp[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
+    }
+    assert(bcf_update_info_float(_header,_record,"GQX_MEDIAN",median_gqx.data()+1,_record->n_allele-1)==0);
+    assert(bcf_update_info_float(_header,_record,"GQ_MEDIAN",median_gq.data()+1,_record->n_allele-1)==0);
+    assert(bcf_update_info_float(_header,_record,"DP_MEDIAN",median_dp.data()+1,_record->n_allele-1)==0);
+}
+
+void CohortInfo::SetHistogramInfoValues()
+{
+    //histogram bins
+    const int maxval = 100;
+    const unsigned nbins = 20;
+    const unsigned bin_width = 5;
+    const unsigned n_allele(_record->n_allele);
+    vector<vector<unsigned>> allele_hist(n_allele,vector<unsigned>(nbins));
+
+    // INFO/DP_HIST_ALT
+    // count depth only at ALT sites and sum over all alleles
+    std::string hist_dp_alt;
+    for(int allele=0;allele<_record->n_allele;++allele)
+    {
+        for(const auto alt_gt_idx : FindAltGenotypes(allele)) {
+            if(_format->dp[alt_gt_idx]!=bcf_int32_missing) {
+                size_t bin_idx = _format->dp[alt_gt_idx] >= maxval ? (nbins-1) : ((size_t)(_format->dp[alt_gt_idx] / bin_width));
+                //assert(bin_idx < nbins);
+                ++allele_hist[allele][bin_idx];
+            }
+        }
+    }
+    hist_dp_alt = ggutils::uint_vec2str(allele_hist);
+
+    assert(bcf_update_info_string(_header,_record,"DP_HIST_ALT",hist_dp_alt.c_str())==0);
+}
+
+//same definitions as bcftools +fill-tags
+void CohortInfo::SetQcInfoValues(int an)
+{
+    const int num_alt = _record->n_allele - 1;
+    const size_t num_sample = _format->num_sample;
+    if (_tag_maf)
+    {
+        std::vector<float> maf(num_alt);
+        for (int i = 0; i < num_alt; i++)
+        {
+            if (an > 0)
+            {
+                float af = (float) _info_ac[i + 1] / an;
+                maf[i] = af > 0.5 ? 1 - af : af;
+            }
+            else
+            {
+                bcf_float_set_missing(maf[i]);
+            }
+        }
+        assert(bcf_update_info_float(_header,_record,"MAF",maf.data(),num_alt)==0);
+    }
+    if (_tag_hwe || _tag_exc_het)
+    {
+        //each alternate allele is tested against all other alleles using diploid calls only
+        std::vector<float> hwe(num_alt), exc_het(num_alt);
+        for (int i = 0; i < num_alt; i++)
+        {
+            int allele = i + 1, num_het = 0, num_hom_alt = 0, num_other = 0;
+            for (size_t j = 0; j < num_sample; j++)
+            {
+                int32_t gt0 = _format->gt[2 * j], gt1 = _format->gt[2 * j + 1];
+                if (gt1 == bcf_int32_vector_end || bcf_gt_is_missing(gt0) || bcf_gt_is_missing(gt1))
+                    continue;
+                int num_copies = (bcf_gt_allele(gt0) == allele) + (bcf_gt_allele(gt1) == allele);
+                if (num_copies == 1) num_het++;
+                else if (num_copies == 2) num_hom_alt++;
+                else num_other++;
+            }
+            double p_hwe, p_exc_het;
+            ggutils::hwe_exact(num_het, num_hom_alt, num_other, p_hwe, p_exc_het);
+            hwe[i] = p_hwe;
+            exc_het[i] = p_exc_het;
+        }
+        if (_tag_hwe)
+            assert(bcf_update_info_float(_header,_record,"HWE",hwe.data(),num_alt)==0);
+        if (_tag_exc_het)
+            assert(bcf_update_info_float(_header,_record,"ExcHet",exc_het.data(),num_alt)==0);
+    }
+    if (_tag_f_missing)
+    {
+        int num_missing = 0;
+        for (size_t j = 0; j < num_sample; j++)
+            num_missing += bcf_gt_is_missing(_format->gt[2 * j]);
+        float f_missing = (float) num_missing / num_sample;
+        assert(bcf_update_info_float(_header,_record,"F_MISSING",&f_missing,1)==0);
+    }
+}
+
+void CohortInfo::SetGroupInfoValues()
+{
+    std::vector<int32_t> ac(_record->n_allele);
+    for (size_t g = 0; g < _group_names.size(); g++)
+    {
+        std::fill(ac.begin(), ac.end(), 0);
+        for (auto sample = _group_samples[g].begin(); sample != _group_samples[g].end(); sample++)
+        {
+            for (size_t j = 2 * (*sample); j < 2 * (*sample) + 2; j++)
+            {
+                if (_format->gt[j] == bcf_int32_vector_end || bcf_gt_is_missing(_format->gt[j]))
+                    continue;
+                ac[bcf_gt_allele(_format->gt[j])]++;
+            }
+        }
+        int an = std::accumulate(ac.begin(), ac.end(), 0);
+        assert(bcf_update_info_int32(_header,_record,("AN_" + _group_names[g]).c_str(),&an,1)==0);
+        assert(bcf_update_info_int32(_header,_record,("AC_" + _group_names[g]).c_str(),ac.data()+1,_record->n_allele-1)==0);
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Cohort INFO fields computed from the merged FORMAT values of every sample.
+//
+
+#ifndef GVCFGENOTYPER_COHORTINFO_HH
+#define GVCFGENOTYPER_COHORTINFO_HH
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+#include "ggutils.hh"
+
+//INFO/AC, AN, ADF, ADR, FS, HOM, GC, the medians, DP_HIST_ALT, the optional --tags and the sample group counts.
+//GVCFMerger and BatchCombiner share it, so combining batches gives the INFO of a single run over all samples.
+class CohortInfo
+{
+public:
+    CohortInfo();
+
+    //comma separated list of extra INFO tags to compute, any of HWE,MAF,ExcHet,F_MISSING
+    void SetTags(const std::string &tags, bcf_hdr_t *header);
+    //adds INFO/AC_<group> and INFO/AN_<group>, file has lines of "sample group1[,group2...]"
+    void SetSampleGroups(const std::string &sample_groups_file, bcf_hdr_t *header);
+    //writes the INFO fields of record from format, which has the FORMAT values of every sample in header
+    void Update(bcf_hdr_t *header, bcf1_t *record, const ggutils::vcf_data_t *format, bool has_strand_ad);
+
+private:
+    std::vector<int> FindAltGenotypes(const int allele);
+    void SetMedianInfoValues();
+    void SetHistogramInfoValues();
+    void SetQcInfoValues(int an);
+    void SetGroupInfoValues();
+
+    //the record being updated
+    bcf_hdr_t *_header;
+    bcf1_t *_record;
+    const ggutils::vcf_data_t *_format;
+
+    std::vector<int32_t> _info_adf, _info_adr, _info_ac, _info_gc;
+    std::vector<float> _sb_pvalue;
+    bool _tag_hwe, _tag_maf, _tag_exc_het, _tag_f_missing;
+    std::vector<std::string> _group_names;
+    std::vector<std::vector<size_t>> _group_samples;//sample indices in each group
+};
+
+#endif //GVCFGENOTYPER_COHORTINFO_HH
@@ -3,7 +3,7 @@
 #include<iostream>
 
 DepthBlock::DepthBlock()
-    : _rid(0),_start(0),_end(0)
+    : _rid(0),_start(0),_end(0),_ploidy(2)
 {
     SetToMissing();
 }
@@ -60,6 +60,15 @@ void DepthBlock::Divide(int n)
     }
 }
 
+bool DepthBlock::HasSameValues(const DepthBlock &db) const
+{
+    return (_rid == db._rid &&
+            _dp == db._dp &&
+            _dpf == db._dpf &&
+            _gq == db._gq &&
+            _ploidy == db._ploidy);
+}
+
 int DepthBlock::size() const
 {
     return (_end - _start + 1);
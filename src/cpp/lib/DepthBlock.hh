@@ -29,6 +29,9 @@ public:
                );
     }
 
+    //true if db would produce the same FORMAT values as this block (ignores start/end)
+    bool HasSameValues(const DepthBlock &db) const;
+
     DepthBlock Intersect(const DepthBlock &db);
     DepthBlock Intersect(int rid, int start, int end);
     int IntersectSize(int rid, int a, int b) const;
@@ -34,6 +34,7 @@ public:
 
     //accessors/mutators
     size_t Size();
+    size_t GetMemoryUsage() {return (_buffer.size() * sizeof(DepthBlock));};
 
     bool Empty();
 
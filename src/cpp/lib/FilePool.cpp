@@ -0,0 +1,47 @@
+#include "FilePool.hh"
+#include "IndexedReader.hh"
+
+#include <algorithm>
+
+FilePool::FilePool(size_t max_open)
+{
+    _max_open = std::max((size_t) 1, max_open);
+    _tick = 1;
+    _num_opens = 0;
+    _num_reopens = 0;
+}
+
+void FilePool::Opened(IndexedReader *reader, bool reopen)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_opens++;
+    _num_reopens += reopen;
+    while (!_open.empty() && _open.size() >= _max_open)
+    {
+        auto oldest = std::min_element(_open.begin(), _open.end(), [](IndexedReader *a, IndexedReader *b)
+        {
+            return (a->GetLastUse() < b->GetLastUse());
+        });
+        (*oldest)->Release();
+        *oldest = _open.back();
+        _open.pop_back();
+    }
+    _open.push_back(reader);
+}
+
+void FilePool::Closed(IndexedReader *reader)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = std::find(_open.begin(), _open.end(), reader);
+    if (it != _open.end())
+    {
+        *it = _open.back();
+        _open.pop_back();
+    }
+}
+
+size_t FilePool::GetNumOpen()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_open.size());
+}
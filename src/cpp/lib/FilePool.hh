@@ -0,0 +1,44 @@
+//
+// Caps the number of inputs open at once by closing the least recently read ones.
+//
+
+#ifndef GVCFGENOTYPER_FILEPOOL_HH
+#define GVCFGENOTYPER_FILEPOOL_HH
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+class IndexedReader;
+
+//IndexedReaders of bgzipped inputs register here when they open their file. Once more than
+//max_open are open, the one that read least recently is closed (IndexedReader::Release keeps its
+//virtual offset) and reopens itself when it next needs a record. Since GVCFReader reads in
+//batches, a reader whose buffer is full is idle for a while and is the one given up.
+class FilePool
+{
+public:
+    explicit FilePool(size_t max_open);
+
+    //reader has opened its file, releases the least recently used others if over the limit
+    void Opened(IndexedReader *reader, bool reopen);
+    //reader has closed its file itself or is being destroyed
+    void Closed(IndexedReader *reader);
+    //use counter for the least recently used ordering
+    uint64_t Tick() {return (_tick.fetch_add(1, std::memory_order_relaxed));};
+
+    size_t GetMaxOpen() {return (_max_open);};
+    size_t GetNumOpen();
+    size_t GetNumReopens() {return (_num_reopens);};
+
+private:
+    size_t _max_open;
+    std::vector<IndexedReader *> _open;
+    std::atomic<uint64_t> _tick;
+    size_t _num_opens, _num_reopens;
+    std::mutex _mutex;
+};
+
+#endif //GVCFGENOTYPER_FILEPOOL_HH
@@ -0,0 +1,181 @@
+#include "FormatFields.hh"
+#include "ggutils.hh"
+
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include <htslib/hts_endian.h>
+}
+
+static const char *FIELD_NAMES[FormatFields::NUM_FIELDS] = {"GT", "AD", "ADF", "ADR", "DP", "DPF", "GQ", "GQX", "PL", "FT"};
+
+//value j of a typed integer array with missing and vector end mapped to their int32 values
+static inline int32_t read_int(const bcf_fmt_t *fmt, const uint8_t *p, int j)
+{
+    switch (fmt->type)
+    {
+        case BCF_BT_INT8:
+        {
+            int8_t value = le_to_i8(p + j);
+            return (value == bcf_int8_missing ? bcf_int32_missing :
+                    value == bcf_int8_vector_end ? bcf_int32_vector_end : value);
+        }
+        case BCF_BT_INT16:
+        {
+            int16_t value = le_to_i16(p + j * sizeof(int16_t));
+            return (value == bcf_int16_missing ? bcf_int32_missing :
+                    value == bcf_int16_vector_end ? bcf_int32_vector_end : value);
+        }
+        case BCF_BT_INT32:
+            return (le_to_i32(p + j * sizeof(int32_t)));
+        default:
+            ggutils::die("unexpected type " + std::to_string(fmt->type) + " of an integer FORMAT field");
+    }
+    return (bcf_int32_missing);
+}
+
+FormatFields::FormatFields(const bcf_hdr_t *header, bcf1_t *record)
+{
+    _header = header;
+    std::fill(_fields, _fields + NUM_FIELDS, nullptr);
+    bcf_unpack(record, BCF_UN_FMT);
+    for (int i = 0; i < record->n_fmt; i++)
+    {
+        const bcf_fmt_t *fmt = &record->d.fmt[i];
+        const char *key = bcf_hdr_int2id(header, BCF_DT_ID, fmt->id);
+        for (int f = 0; f < NUM_FIELDS; f++)
+        {
+            //htslib takes the first of repeated tags
+            if (strcmp(key, FIELD_NAMES[f]) == 0)
+            {
+                if (_fields[f] == nullptr)
+                    _fields[f] = fmt;
+                break;
+            }
+        }
+    }
+}
+
+int FormatFields::Check(Field field, int type) const
+{
+    const bcf_fmt_t *fmt = _fields[field];
+    //the header is only searched for fields the record does not have
+    int id = fmt != nullptr ? fmt->id : bcf_hdr_id2int(_header, BCF_DT_ID, FIELD_NAMES[field]);
+    if (!bcf_hdr_idinfo_exists(_header, BCF_HL_FMT, id))
+        return (-1);
+    //GT is a string in the header but integers in the record
+    if ((int) bcf_hdr_id2type(_header, BCF_HL_FMT, id) != (field == GT ? BCF_HT_STR : type))
+        return (-2);
+    if (fmt == nullptr || fmt->p == nullptr)
+        return (-3);
+    return (fmt->n * bcf_hdr_nsamples(_header));
+}
+
+int FormatFields::GetInt(Field field, int32_t **dst, int *ndst) const
+{
+    int n = Check(field, BCF_HT_INT);
+    if (n < 0)
+        return (n);
+    if (*ndst < n)
+    {
+        *ndst = n;
+        *dst = (int32_t *) realloc(*dst, n * sizeof(int32_t));
+    }
+    const bcf_fmt_t *fmt = _fields[field];
+    int32_t *out = *dst;
+    for (int s = 0; s < bcf_hdr_nsamples(_header); s++, out += fmt->n)
+    {
+        const uint8_t *p = fmt->p + s * fmt->size;
+        int j = 0;
+        for (; j < fmt->n; j++)
+        {
+            int32_t value = read_int(fmt, p, j);
+            if (value == bcf_int32_vector_end)
+                break;
+            out[j] = value;
+        }
+        for (; j < fmt->n; j++)
+            out[j] = bcf_int32_vector_end;
+    }
+    return (n);
+}
+
+int FormatFields::GetFloat(Field field, float **dst, int *ndst) const
+{
+    int n = Check(field, BCF_HT_REAL);
+    if (n < 0)
+        return (n);
+    const bcf_fmt_t *fmt = _fields[field];
+    if (fmt->type != BCF_BT_FLOAT)
+        ggutils::die("unexpected type " + std::to_string(fmt->type) + " of a float FORMAT field");
+    if (*ndst < n)
+    {
+        *ndst = n;
+        *dst = (float *) realloc(*dst, n * sizeof(float));
+    }
+    float *out = *dst;
+    for (int s = 0; s < bcf_hdr_nsamples(_header); s++, out += fmt->n)
+    {
+        const uint8_t *p = fmt->p + s * fmt->size;
+        int j = 0;
+        for (; j < fmt->n; j++)
+        {
+            uint32_t value = le_to_u32(p + j * sizeof(float));
+            if (value == bcf_float_vector_end)
+                break;
+            bcf_float_set(out + j, value);
+        }
+        for (; j < fmt->n; j++)
+            bcf_float_set_vector_end(out[j]);
+    }
+    return (n);
+}
+
+int FormatFields::GetOneInt(Field field, int32_t &value) const
+{
+    int n = Check(field, BCF_HT_INT);
+    if (n > 1)
+        ggutils::die("bcf1_get_one_format_int:" + (std::string) FIELD_NAMES[field] + " more than one value returned");
+    if (n < 0)
+        value = bcf_int32_missing;
+    else if (n == 1)
+        value = read_int(_fields[field], _fields[field]->p, 0);
+    return (n);
+}
+
+int FormatFields::GetOneFloat(Field field, float &value) const
+{
+    int n = Check(field, BCF_HT_REAL);
+    if (n > 1)
+        ggutils::die("bcf1_get_one_format_float:" + (std::string) FIELD_NAMES[field] + " more than one value returned");
+    if (n < 0)
+        bcf_float_set_missing(value);
+    else if (n == 1)
+    {
+        if (_fields[field]->type != BCF_BT_FLOAT)
+            ggutils::die("unexpected type " + std::to_string(_fields[field]->type) + " of a float FORMAT field");
+        bcf_float_set(&value, le_to_u32(_fields[field]->p));
+    }
+    return (n);
+}
+
+int FormatFields::GetOneString(Field field, std::string &value) const
+{
+    if (bcf_hdr_nsamples(_header) != 1)
+        ggutils::die("bcf1_get_one_format_string: number samples != 1");
+    int n = Check(field, BCF_HT_STR);
+    if (n < 0)
+    {
+        value = ".";
+        return (n);
+    }
+    const char *p = (const char *) _fields[field]->p;
+    value.assign(p, strnlen(p, _fields[field]->n));
+    return (n + 1);
+}
+
+int FormatFields::GetPloidy() const
+{
+    return (Check(GT, BCF_HT_INT));
+}
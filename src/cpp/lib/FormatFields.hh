@@ -0,0 +1,44 @@
+//
+// The FORMAT fields GVCFGenotyper reads from a record, taken in place from its typed arrays.
+//
+
+#ifndef GVCFGENOTYPER_FORMATFIELDS_HH
+#define GVCFGENOTYPER_FORMATFIELDS_HH
+
+#include <string>
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+//bcf_get_format_int32 and friends look the tag up in the header, scan the record's fields for it and convert
+//its values into a buffer, once for every field asked for. Every variant and block of every input has up to ten
+//of these read. FormatFields finds them all in one pass over the unpacked record and reads the int8/int16/int32
+//or float arrays where they are, which for BCF inputs is straight out of the decompressed block. The results,
+//including the negative statuses, are those of the htslib calls they replace. A FormatFields is only valid
+//until the record is next changed, eg. by bcf_update_format_string.
+class FormatFields
+{
+public:
+    enum Field {GT, AD, ADF, ADR, DP, DPF, GQ, GQX, PL, FT, NUM_FIELDS};
+
+    FormatFields(const bcf_hdr_t *header, bcf1_t *record);
+    //as bcf_get_format_int32 (bcf_get_genotypes for GT) and bcf_get_format_float
+    int GetInt(Field field, int32_t **dst, int *ndst) const;
+    int GetFloat(Field field, float **dst, int *ndst) const;
+    //as ggutils::bcf1_get_one_format_int/_float/_string: one value, missing (or ".") if there is none
+    int GetOneInt(Field field, int32_t &value) const;
+    int GetOneFloat(Field field, float &value) const;
+    int GetOneString(Field field, std::string &value) const;
+    //as ggutils::get_ploidy
+    int GetPloidy() const;
+
+private:
+    //number of values of field if it is present with the given type, else the htslib status
+    int Check(Field field, int type) const;
+
+    const bcf_hdr_t *_header;
+    const bcf_fmt_t *_fields[NUM_FIELDS];
+};
+
+#endif //GVCFGENOTYPER_FORMATFIELDS_HH
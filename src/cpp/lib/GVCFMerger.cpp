@@ -1,9 +1,17 @@
 #include "GVCFMerger.hh"
 #include "ggutils.hh"
+#include "StageTimer.hh"
+#include "LogThrottle.hh"
 #include <htslib/hts.h>
 #include <htslib/vcf.h>
 
 #include <unordered_map>
+#include <numeric>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <set>
 
 extern "C" {
       size_t hts_realloc_or_die(unsigned long, unsigned long, unsigned long, unsigned long, int, void**, char const*);
@@ -23,14 +31,19 @@ extern "C" {
 GVCFMerger::~GVCFMerger()
 {
     delete _normaliser;
-    hts_close(_output_file);
+    if(_output_file!=nullptr)
+        hts_close(_output_file);
+    hts_idx_destroy(_output_index);
     bcf_hdr_destroy(_output_header);
     delete _format;
-    free(_info_adf);
-    free(_info_adr);
-    free(_info_ac);
-    free(_info_gc);
+    free(_sample_gt);
+    if(_sites_reader!=nullptr)
+        bcf_sr_destroy(_sites_reader);
+    delete _zarr_writer;
     bcf_destroy(_output_record);
+    _readers.clear();//readers report to _read_ahead and _file_pool
+    delete _read_ahead;
+    delete _file_pool;
 }
 
 GVCFMerger::GVCFMerger(const vector<string> &input_files,
@@ -41,47 +54,80 @@ GVCFMerger::GVCFMerger(const vector<string> &input_files,
                        const string &region /*= ""*/,
                        const int is_file /*= 0*/,
                        bool ignore_non_matching_ref,
-                       bool force_samples)
+                       bool force_samples,
+                       size_t max_open_files,
+                       int open_threads,
+                       Manifest *manifest)
 {    
     _force_samples = force_samples;
+    _region = region;
+    _is_file = is_file;
     _has_pl = true;
     _has_strand_ad=true;
     _num_variants=0;
     _normaliser = new Normaliser(reference_genome,ignore_non_matching_ref);
     _num_gvcfs = input_files.size();
-    _readers.reserve(_num_gvcfs);
+    //inputs beyond the limit are closed while idle and reopened through their index
+    _file_pool = max_open_files > 0 && max_open_files < _num_gvcfs ? new FilePool(max_open_files) : nullptr;
+    _header_cache.AddHeaderLine(GVCFReader::FT_HEADER_LINE);
 
     // retrieve logger from factory
     _lg = spdlog::get("gg_logger");
     assert(_lg!=nullptr);
+    if (manifest != nullptr)
+    {
+        manifest->AddHeaderLine(GVCFReader::FT_HEADER_LINE);
+        _lg->info("Reading headers and index offsets of {} inputs from the manifest", manifest->GetNumInputs());
+    }
     _lg->info("Input GVCFs:");
+    //opening reads the header and index and fills the buffer, which is mostly waiting on storage
+    _readers.resize(_num_gvcfs);
+    size_t num_threads = std::min((size_t) std::max(1, open_threads), _num_gvcfs);
+    if (_file_pool != nullptr)//a pooled reader is only released when idle, so all open ones must fit
+        num_threads = std::min(num_threads, _file_pool->GetMaxOpen());
+    if (num_threads > 1)
+    {
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; t++)
+        {
+            threads.emplace_back([&]()
+            {
+                for (size_t i = next++; i < _num_gvcfs; i = next++)
+                {
+                    _readers[i].Open(input_files[i], _normaliser, buffer_size, region, is_file, &_header_cache, _file_pool, manifest);
+                    _readers[i].ReleaseFile();
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+    }
     for (size_t i = 0; i < _num_gvcfs; i++)
-
     {
+        if (num_threads <= 1)
+            _readers[i].Open(input_files[i], _normaliser, buffer_size, region, is_file, &_header_cache, _file_pool, manifest);
         _lg->info("Opened {} {}/{}",input_files[i],(i+1),_num_gvcfs);
-        _readers.emplace_back(input_files[i], _normaliser, buffer_size, region, is_file);
-        _has_pl &= _readers.back().HasPl();
-        _has_strand_ad &= _readers.back().HasStrandAd();
+        _has_pl &= _readers[i].HasPl();
+        _has_strand_ad &= _readers[i].HasStrandAd();
     }
-    assert(_readers.size() == _num_gvcfs);
+    if (num_threads > 1)
+        _lg->info("Opened {} inputs with {} threads", _num_gvcfs, num_threads);
+    ValidateHeaders();
+    _lg->info("{} inputs share {} distinct header layouts", _num_gvcfs,
+              _header_cache.GetNumHeaders());
+    if (_file_pool != nullptr)
+        _lg->info("At most {} inputs are kept open, the others are reopened when they need more data", _file_pool->GetMaxOpen());
 
-    _output_file = hts_open(!output_filename.empty() ? output_filename.c_str() : "-", ("w" + output_mode).c_str());
-
-    if (!_output_file)
-    {
-        ggutils::die("problem opening output file: " + output_filename);
-    }
+    //opened once the output is known to be VCF/BCF, see OpenOutput
+    _output_filename = output_filename;
+    _output_mode = output_mode;
+    _output_file = nullptr;
 
     size_t n_allele = 2;
     size_t n_ploidy = 2;
     _format = new ggutils::vcf_data_t(n_ploidy,n_allele,_num_gvcfs);
 
-    _info_adf = (int32_t *) malloc(n_allele * sizeof(int32_t));
-    _info_adr = (int32_t *) malloc(n_allele * sizeof(int32_t));
-    _info_ac = (int32_t *) malloc(n_allele * sizeof(int32_t));
-    int num_gt_per_sample = ggutils::get_number_of_gt_combinations(_format->ploidy,n_allele);
-    _info_gc = (int32_t *) malloc(num_gt_per_sample * sizeof(int32_t));
-
     BuildHeader();
     _record_collapser.Init(_output_header);
     _output_record = bcf_init1();
@@ -90,11 +136,218 @@ GVCFMerger::GVCFMerger(const vector<string> &input_files,
     _mean_weighted_mq = 0;
     _sum_mq_weights = 0;
     _max_alleles = INT32_MAX;
+    _sparse_ref_blocks = false;
+    _sites_only = false;
+    _sample_gt = nullptr;
+    _num_sample_gt = 0;
+    _sites_reader = nullptr;
+    _num_dropped_records = 0;
+    _zarr_writer = nullptr;
+    _hail = false;
+    _output_index = nullptr;
+    _output_index_fmt = -1;
+    _progress_interval = 0;
+    _read_ahead = nullptr;
+    _progress_total_bp = 0;
+    _header_bytes = 0;
+    _num_headers = 0;
+    _chunk_scheduler = nullptr;
+    _chunk = 0;
+}
+
+void GVCFMerger::SetSparseRefBlocks(bool sparse_ref_blocks)
+{
+    _sparse_ref_blocks = sparse_ref_blocks;
+    if(!_sparse_ref_blocks) return;
+    _last_ref_block.assign(_num_gvcfs, DepthBlock());
+    _ref_block_unchanged.assign(_num_gvcfs, false);
+    bcf_hdr_append(_output_header, "##gvcfgenotyper_reference_blocks=sparse");
+    bcf_hdr_append(_output_header, "##gvcfgenotyper_reference_blocks_description=\"Homozygous reference samples whose reference block is unchanged since their last written value have all FORMAT fields missing. Use 'gvcfgenotyper expand' to restore dense output\"");
+}
+
+void GVCFMerger::SetSitesOnly(bool sites_only)
+{
+    _sites_only = sites_only;
+    if(!_sites_only) return;
+    if(_sparse_ref_blocks)
+    {
+        ggutils::die("--sites-only cannot be combined with --sparse-ref-blocks");
+    }
+    //the sites-only header has no samples and only the INFO fields that can be computed from carriers
+    bcf_hdr_destroy(_output_header);
+    _output_header = bcf_hdr_init("w");
+    bcf_hdr_append(_output_header, "##INFO=<ID=AC,Number=A,Type=Integer,Description=\"Allele count in genotypes\">");
+    bcf_hdr_append(_output_header, "##INFO=<ID=NC,Number=A,Type=Integer,Description=\"Number of samples carrying this alternate allele\">");
+    bcf_hdr_append(_output_header, ("##gvcfgenotyper_version="+(string)GG_VERSION).c_str());
+    bcf_hdr_append(_output_header, "##gvcfgenotyper_sites_only=true");
+    ggutils::copy_contigs(_readers[0].GetHeader(), _output_header);
+    //homref blocks are never queried so there is no need to buffer them
+    for (auto it = _readers.begin(); it != _readers.end(); it++)
+        it->SetBufferDepth(false);
+}
+
+void GVCFMerger::SetSites(const string &sites_file)
+{
+    if(sites_file.empty()) return;
+    if(_sites_only)
+    {
+        ggutils::die("--sites cannot be combined with --sites-only");
+    }
+    _sites_reader = bcf_sr_init();
+    if (!_region.empty() && bcf_sr_set_regions(_sites_reader, _region.c_str(), _is_file) == -1)
+    {
+        ggutils::die("Cannot navigate to region " + _region + " in " + sites_file);
+    }
+    if (!bcf_sr_add_reader(_sites_reader, sites_file.c_str()))
+    {
+        ggutils::die("problem opening " + sites_file + "\n" + bcf_sr_strerror(_sites_reader->errnum));
+    }
+    //sites are genotyped in catalogue order while the readers go through the GVCFs in theirs, so the
+    //contigs both have must come in the same order. The catalogue may have contigs the GVCFs do not.
+    const bcf_hdr_t *sites_header = bcf_sr_get_header(_sites_reader, 0);
+    int last_rid = -1;
+    const char *last_contig = nullptr;
+    for (int i = 0; i < sites_header->n[BCF_DT_CTG]; i++)
+    {
+        const char *contig = bcf_hdr_id2name(sites_header, i);
+        int rid = bcf_hdr_name2id(_output_header, contig);
+        if (rid < 0)
+            continue;
+        if (rid < last_rid)
+        {
+            ggutils::die(sites_file + " has contig " + contig + " after " + last_contig +
+                         ", the site catalogue must have the contigs of the GVCFs in the same order");
+        }
+        last_rid = rid;
+        last_contig = contig;
+    }
+    //the MQ terms of each batch, see BatchCombiner
+    bcf_hdr_append(_output_header, "##INFO=<ID=MQ_SUM,Number=2,Type=Integer,Description=\"Sum of DP*MQ and sum of DP over the samples with MQ\">");
+    _lg->info("Genotyping sites from {}", sites_file);
+}
+
+void GVCFMerger::SetZarrOutput(const string &directory, int max_alleles)
+{
+    if(directory.empty()) return;
+    if(_sparse_ref_blocks || _sites_only)
+    {
+        ggutils::die("--zarr cannot be combined with --sparse-ref-blocks or --sites-only");
+    }
+    //the header is otherwise only synced when it is written
+    bcf_hdr_sync(_output_header);
+    _zarr_writer = new ZarrWriter(directory, _output_header, max_alleles);
+    _lg->info("Writing Zarr store to {} in chunks of {} variants", directory, _zarr_writer->GetVariantChunkSize());
+}
+
+void GVCFMerger::OpenOutput()
+{
+    if(_output_file!=nullptr) return;
+    _output_file = hts_open(!_output_filename.empty() ? _output_filename.c_str() : "-", ("w" + _output_mode).c_str());
+    if (!_output_file)
+    {
+        ggutils::die("problem opening output file: " + _output_filename);
+    }
+}
+
+void GVCFMerger::SetWriteIndex(bool write_index)
+{
+    if(!write_index) return;
+    if(_zarr_writer!=nullptr)
+    {
+        ggutils::die("--write-index cannot be combined with --zarr");
+    }
+    if(_output_filename.empty() || _output_filename == "-")
+    {
+        ggutils::die("--write-index needs an output file");
+    }
+    OpenOutput();
+    if(!_output_file->is_bgzf)
+    {
+        ggutils::die("--write-index needs bgzipped output (-Ob or -Oz)");
+    }
+    //the index type is chosen once the header is complete, see InitOutputIndex
+    _output_index_fmt = _output_file->is_bin ? HTS_FMT_CSI : HTS_FMT_TBI;
+}
+
+void GVCFMerger::SetHail(bool hail)
+{
+    _hail = hail;
+    if(!_hail) return;
+    if(_sparse_ref_blocks || _sites_only)
+    {
+        ggutils::die("--hail cannot be combined with --sparse-ref-blocks or --sites-only");
+    }
+    //FORMAT is rewritten after INFO is computed, so batches written this way cannot be combined
+    bcf_hdr_append(_output_header, "##gvcfgenotyper_hail=true");
+    //hail needs FORMAT/PL even if none of the inputs had it
+    if (!_has_pl)
+    {
+        _has_pl = true;
+        bcf_hdr_append(_output_header,
+                       "##FORMAT=<ID=PL,Number=G,Type=Integer,Description=\"Normalized, Phred-scaled likelihoods for genotypes as defined in "
+                               "the VCF specification.\">");
+    }
+}
+
+void GVCFMerger::SetInfoTags(const string &tags)
+{
+    if(tags.empty()) return;
+    if(_sites_only)
+    {
+        ggutils::die("--tags cannot be combined with --sites-only");
+    }
+    _cohort_info.SetTags(tags, _output_header);
+}
 
+void GVCFMerger::SetSampleGroups(const string &sample_groups_file)
+{
+    if(sample_groups_file.empty()) return;
+    if(_sites_only)
+    {
+        ggutils::die("--sample-groups cannot be combined with --sites-only");
+    }
+    _cohort_info.SetSampleGroups(sample_groups_file, _output_header);
+}
+
+//loads the next row of the site catalogue into the record collapser, returns 0 at the end of the catalogue
+int GVCFMerger::GetNextSite()
+{
+    StageTimer timer(Stage::GetNextVariant);
+    assert(_sites_reader != nullptr);
+    if (!bcf_sr_next_line(_sites_reader))
+    {
+        _lg->info("Dropped {} sample records that were not in the site catalogue", _num_dropped_records);
+        return (0);
+    }
+    bcf_hdr_t *sites_header = bcf_sr_get_header(_sites_reader, 0);
+    bcf1_t *site = bcf_dup(bcf_sr_get_line(_sites_reader, 0));
+    bcf_unpack(site, BCF_UN_STR);
+    //contigs are in the same order (see SetSites) but the catalogue may have others, so the ids can differ
+    site->rid = bcf_hdr_name2id(_output_header, bcf_hdr_id2name(sites_header, site->rid));
+    if (site->rid < 0 || site->n_allele < 2)
+    {
+        ggutils::die("bad site catalogue record " + ggutils::record2string(sites_header, bcf_sr_get_line(_sites_reader, 0)));
+    }
+
+    _record_collapser.SetPosition(site->rid, site->pos);
+    for (int i = 1; i < site->n_allele; i++)
+    {
+        _record_collapser.Allele(site, i);
+    }
+    bcf_destroy(site);
+
+    //sample rows before this site, or at this site but not in the catalogue, are never genotyped
+    for (auto it = _readers.begin(); it != _readers.end(); it++)
+    {
+        it->FlushBuffer(_record_collapser.rid(), _record_collapser.pos() - 1);
+        _num_dropped_records += it->DropVariantsNotIn(_record_collapser.GetMax(), _record_collapser);
+    }
+    return (1);
 }
 
 int GVCFMerger::GetNextVariant()
 {
+    StageTimer timer(Stage::GetNextVariant);
     assert(_readers.size() == _num_gvcfs);
     assert(!AreAllReadersEmpty());
     bcf1_t *min_rec = nullptr;
@@ -145,19 +398,6 @@ void GVCFMerger::SetOutputBuffersToMissing(int num_alleles)
 {
     _format->resize(num_alleles);
     _format->set_missing();
-
-    _info_adf = (int32_t *) realloc(_info_adf, num_alleles * sizeof(int32_t));
-    _info_adr = (int32_t *) realloc(_info_adr, num_alleles * sizeof(int32_t));
-    _info_ac = (int32_t *) realloc(_info_ac, num_alleles * sizeof(int32_t));
-
-    int num_gt_per_sample = ggutils::get_number_of_gt_combinations(_format->ploidy,num_alleles);
-    _info_gc = (int32_t *) realloc(_info_gc, num_gt_per_sample * sizeof(int32_t));
-
-    std::fill(_info_adf, _info_adf + num_alleles, 0);
-    std::fill(_info_adr, _info_adr + num_alleles, 0);
-    std::fill(_info_ac, _info_ac + num_alleles, 0);
-    std::fill(_info_gc, _info_gc + num_gt_per_sample, 0);
-
 }
 
 void GVCFMerger::GenotypeHomrefVariant(int sample_index, const DepthBlock &homref_block)
@@ -228,30 +468,49 @@ void GVCFMerger::GenotypeAltVariant(int sample_index,bcf1_t *sample_variants)
 
 void GVCFMerger::GenotypeSample(int sample_index)
 {
+    StageTimer timer(Stage::GenotypeSample);
     auto hdr = _readers[sample_index].GetHeader();
     auto records = _readers[sample_index].GetAllVariantsUpTo(_record_collapser.GetMax());
-    bcf1_t *sample_record = CollapseRecords(hdr,records);
+    bcf1_t *sample_record = CollapseRecords(hdr,records,_readers[sample_index].GetSampleName());
     //this sample has variants at this position, we need to populate its FORMAT field
     if (sample_record!=nullptr)
     {
         GenotypeAltVariant(sample_index, sample_record);
         bcf_destroy(sample_record);
+        //a carrier always forces the next homref values for this sample to be written
+        if(_sparse_ref_blocks)
+            _last_ref_block[sample_index].SetToMissing();
     }
     else    //this sample does not have the variant, reconstruct the format fields from homref blocks
     {
         DepthBlock homref_block;//working structure to store homref info.
         _readers[sample_index].GetDepth(_output_record->rid, _output_record->pos,
                                         ggutils::get_end_of_variant(_output_record), homref_block);
+        //INFO fields need dense values, unchanged samples are masked again in MaskUnchangedRefBlocks
         GenotypeHomrefVariant(sample_index, homref_block);
+        if(_sparse_ref_blocks)
+        {
+            if(_last_ref_block[sample_index].HasSameValues(homref_block))
+                _ref_block_unchanged[sample_index] = true;
+            else
+                _last_ref_block[sample_index] = homref_block;
+        }
     }
 }
 
 bool GVCFMerger::next()
 {
-    if (AreAllReadersEmpty()) return false;
+    if (_sites_reader == nullptr && AreAllReadersEmpty()) return false;
 
     bcf_clear(_output_record);
-    GetNextVariant(); //stores all the alleles at the next position.
+    if (_sites_reader != nullptr)
+    {
+        if (GetNextSite() == 0) return false;
+    }
+    else
+    {
+        GetNextVariant(); //stores all the alleles at the next position.
+    }
     bcf_update_id(_output_header, _output_record, ".");
     _record_collapser.Collapse(_output_record);
     _output_record->qual = 0;
@@ -259,7 +518,15 @@ bool GVCFMerger::next()
     ggutils::print_variant(_output_header,_output_record);
 #endif
 
-    if(_output_record->n_allele <= _max_alleles)
+    if(_output_record->n_allele <= _max_alleles && _sites_only)
+    {
+        CountCarriers();
+        for (size_t i = 0; i < _num_gvcfs; i++)
+            _readers[i].FlushBuffer(_record_collapser.GetMax());
+        _num_variants++;
+        return true;
+    }
+    else if(_output_record->n_allele <= _max_alleles)
     {
         //fill in the format information for every sample.
         SetOutputBuffersToMissing(_output_record->n_allele);
@@ -268,6 +535,8 @@ bool GVCFMerger::next()
         _num_ps_written = 0;
         _mean_weighted_mq = 0;
         _sum_mq_weights = 0;
+        if(_sparse_ref_blocks)
+            std::fill(_ref_block_unchanged.begin(), _ref_block_unchanged.end(), false);
 
         for (size_t i = 0; i < _num_gvcfs; i++)
         {
@@ -280,102 +549,147 @@ bool GVCFMerger::next()
     }
     else
     {
-        _lg->warn("Too many alleles at {}:{} dropping this position.",
-                  bcf_hdr_id2name(_output_header,_output_record->rid),_output_record->pos+1);
+        LogThrottle::Warn(_lg, "Too many alleles at {}:{} dropping this position.",
+                          bcf_hdr_id2name(_output_header,_output_record->rid),_output_record->pos+1);
         for (size_t i = 0; i < _num_gvcfs; i++)
             _readers[i].FlushBuffer(_record_collapser.GetMax());
         return(next());
     }
 }
 
-std::vector<int> GVCFMerger::FindAltGenotypes(const int allele) 
+//INFO/AC and INFO/NC for --sites-only, counted straight from the normalised sample records.
+//Each buffered record is bi-allelic with respect to the allele at index 1 (see Normaliser::MultiSplit)
+void GVCFMerger::CountCarriers()
 {
-    std::vector<int> indices_of_alt_genotypes;
-    for(size_t i=0;i<_num_gvcfs;++i)
+    const int num_alt = _output_record->n_allele - 1;
+    std::vector<int32_t> ac(num_alt, 0), nc(num_alt, 0);
+    std::vector<bool> is_carrier(num_alt);
+    for (size_t i = 0; i < _num_gvcfs; i++)
     {
-        bool is_alt(false);
-        if(_format->ploidy==1)
-            is_alt = !bcf_gt_is_missing(_format->gt[i]) && bcf_gt_allele(_format->gt[i])==allele;
-        else
-            is_alt = !bcf_gt_is_missing(_format->gt[2*i+1]) && !bcf_gt_is_missing(_format->gt[2*i]) && (bcf_gt_allele(_format->gt[2*i])==allele||bcf_gt_allele(_format->gt[2*i+1])==allele);
-        if(is_alt) {
-            indices_of_alt_genotypes.push_back(i);
+        bcf_hdr_t *hdr = _readers[i].GetHeader();
+        auto records = _readers[i].GetAllVariantsUpTo(_record_collapser.GetMax());
+        std::fill(is_carrier.begin(), is_carrier.end(), false);
+        bool has_qual = false;
+        for (auto rec = records.first; rec != records.second; rec++)
+        {
+            int allele = _record_collapser.AlleleIndex(*rec, 1);
+            assert(allele > 0 && allele <= num_alt);
+            int num_gt = bcf_get_genotypes(hdr, *rec, &_sample_gt, &_num_sample_gt);
+            for (int j = 0; j < num_gt; j++)
+            {
+                if (_sample_gt[j] != bcf_int32_vector_end && !bcf_gt_is_missing(_sample_gt[j]) &&
+                    bcf_gt_allele(_sample_gt[j]) == 1)
+                {
+                    ac[allele - 1]++;
+                    is_carrier[allele - 1] = true;
+                }
+            }
+            //QUAL is summed once per sample as in GenotypeAltVariant
+            if (!has_qual && !bcf_float_is_missing((*rec)->qual))
+            {
+                _output_record->qual += (*rec)->qual;
+                has_qual = true;
+            }
         }
+        for (int j = 0; j < num_alt; j++)
+            nc[j] += is_carrier[j];
     }
-    return indices_of_alt_genotypes;
+    assert(bcf_update_info_int32(_output_header, _output_record, "AC", ac.data(), num_alt)==0);
+    assert(bcf_update_info_int32(_output_header, _output_record, "NC", nc.data(), num_alt)==0);
+}
+
+void GVCFMerger::UpdateFormatAndInfo()
+{
+    StageTimer timer(Stage::UpdateFormatAndInfo);
+    // INFO is computed first since it needs dense genotypes for every sample
+    UpdateInfo();
+    if(_sparse_ref_blocks)
+        MaskUnchangedRefBlocks();
+    if(_hail)
+        ApplyHailRules();
+    UpdateFormat();
 }
 
-void GVCFMerger::SetMedianInfoValues()
+//Same transformations as docs/hail/ilmn2hail.agg.c. Haploid calls become 0/a with dummy PL,
+//every sample gets a full set of PL and FORMAT/ADF/ADR are set to missing if any entry is missing.
+void GVCFMerger::ApplyHailRules()
 {
-    std::vector<float> median_gq(_output_record->n_allele);
-    std::vector<float> median_gqx(_output_record->n_allele);
-    std::vector<float> median_dp(_output_record->n_allele);
-    for(int allele=0;allele<_output_record->n_allele;allele++)
+    const int num_allele = _output_record->n_allele;
+    const int num_pl_per_sample = ggutils::get_number_of_gt_combinations(2,num_allele);
+    for(size_t i=0;i<_num_gvcfs;++i)
     {
-        std::vector<int> indices_of_alt_genotypes = FindAltGenotypes(allele);
-        // INFO/GQX_MEDIAN
-        std::vector<int> values_at_alt_genotypes;
-        for(const auto alt_gt : indices_of_alt_genotypes) {
-            if(_format->gq[alt_gt]!=bcf_int32_missing)
-                values_at_alt_genotypes.push_back(_format->gq[alt_gt]);
+        int32_t *gt = _format->gt + 2 * i;
+        int32_t *pl = _format->pl + i * num_pl_per_sample;
+        if (gt[1] == bcf_int32_vector_end)
+        {
+            std::fill(pl, pl + num_pl_per_sample, 255);
+            if (bcf_gt_is_missing(gt[0]))
+            {
+                gt[0] = gt[1] = bcf_gt_missing;
+            }
+            else
+            {
+                int allele = bcf_gt_allele(gt[0]);
+                gt[0] = bcf_gt_unphased(0);
+                gt[1] = bcf_gt_unphased(allele);
+                pl[bcf_alleles2gt(0, allele)] = 0;
+            }
+        }
+        else if (bcf_gt_is_missing(gt[0]))
+        {
+            std::fill(pl, pl + num_pl_per_sample, 255);
         }
-        bcf_float_set_missing(median_gq[allele]);
-        if(!values_at_alt_genotypes.empty())
-            median_gq[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
-
-        // INFO/GQ_MEDIAN
-        values_at_alt_genotypes.clear();
-        for(const auto alt_gt : indices_of_alt_genotypes) {
-            if(_format->gqx[alt_gt]!=bcf_int32_missing)
-                values_at_alt_genotypes.push_back(_format->gqx[alt_gt]);
+        else
+        {
+            for (int j = 0; j < num_pl_per_sample; j++)
+                if (pl[j] == bcf_int32_missing || pl[j] == bcf_int32_vector_end)
+                    pl[j] = 255;
         }
-        bcf_float_set_missing(median_gqx[allele]);
-        if(!values_at_alt_genotypes.empty())
-            median_gqx[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
-
-        // INFO/DP_MEDIAN
-        values_at_alt_genotypes.clear();
-        for(const auto alt_gt : indices_of_alt_genotypes) {
-            if(_format->dp[alt_gt]!=bcf_int32_missing)
-                values_at_alt_genotypes.push_back(_format->dp[alt_gt]);
+
+        //http://discuss.hail.is/t/matrix-table-error/485/2
+        int32_t *adf = _format->adf + i * num_allele;
+        int32_t *adr = _format->adr + i * num_allele;
+        if (std::find(adf, adf + num_allele, bcf_int32_missing) != adf + num_allele)
+        {
+            std::fill(adf, adf + num_allele, bcf_int32_vector_end);
+            adf[0] = bcf_int32_missing;
         }
-        bcf_float_set_missing(median_dp[allele]);
-        if(!values_at_alt_genotypes.empty())
-            median_dp[allele] =  ggutils::inplace_median(values_at_alt_genotypes);
-    }
-    assert(bcf_update_info_float(_output_header,_output_record,"GQX_MEDIAN",median_gqx.data()+1,_output_record->n_allele-1)==0);
-    assert(bcf_update_info_float(_output_header,_output_record,"GQ_MEDIAN",median_gq.data()+1,_output_record->n_allele-1)==0);
-    assert(bcf_update_info_float(_output_header,_output_record,"DP_MEDIAN",median_dp.data()+1,_output_record->n_allele-1)==0);
-}
-
-void GVCFMerger::SetHistogramInfoValues() 
-{
-    //histogram bins
-    const int maxval = 100;
-    const unsigned nbins = 20;
-    const unsigned bin_width = 5;
-    const unsigned n_allele(_output_record->n_allele);
-    vector<vector<unsigned>> allele_hist(n_allele,vector<unsigned>(nbins));
-
-    // INFO/DP_HIST_ALT
-    // count depth only at ALT sites and sum over all alleles
-    std::string hist_dp_alt;
-    for(int allele=0;allele<_output_record->n_allele;++allele)
-    {
-        for(const auto alt_gt_idx : FindAltGenotypes(allele)) {
-            if(_format->dp[alt_gt_idx]!=bcf_int32_missing) {
-                size_t bin_idx = _format->dp[alt_gt_idx] >= maxval ? (nbins-1) : ((size_t)(_format->dp[alt_gt_idx] / bin_width));
-                //assert(bin_idx < nbins);
-                ++allele_hist[allele][bin_idx];
-            }
+        if (std::find(adr, adr + num_allele, bcf_int32_missing) != adr + num_allele)
+        {
+            std::fill(adr, adr + num_allele, bcf_int32_vector_end);
+            adr[0] = bcf_int32_missing;
         }
     }
-    hist_dp_alt = ggutils::uint_vec2str(allele_hist);
+}
 
-    assert(bcf_update_info_string(_output_header,_output_record,"DP_HIST_ALT",hist_dp_alt.c_str())==0);
+//sets every FORMAT value to missing for homref samples whose reference block was already written.
+//The masked samples are still genotyped (for INFO) and encoded, so only the compressed output shrinks.
+void GVCFMerger::MaskUnchangedRefBlocks()
+{
+    const int num_allele = _output_record->n_allele;
+    const int num_pl_per_sample = ggutils::get_number_of_gt_combinations(2,num_allele);
+    for(size_t i=0;i<_num_gvcfs;++i)
+    {
+        if(!_ref_block_unchanged[i]) continue;
+        _format->gt[2 * i] = bcf_gt_missing;
+        _format->gt[2 * i + 1] = bcf_int32_vector_end;
+        _format->gq[i] = _format->dp[i] = _format->dpf[i] = bcf_int32_missing;
+        int32_t *ad = _format->ad + i * num_allele;
+        int32_t *adf = _format->adf + i * num_allele;
+        int32_t *adr = _format->adr + i * num_allele;
+        std::fill(ad, ad + num_allele, bcf_int32_vector_end);
+        std::fill(adf, adf + num_allele, bcf_int32_vector_end);
+        std::fill(adr, adr + num_allele, bcf_int32_vector_end);
+        ad[0] = adf[0] = adr[0] = bcf_int32_missing;
+        if (_has_pl) {
+            int32_t *pl = _format->pl + i * num_pl_per_sample;
+            std::fill(pl, pl + num_pl_per_sample, bcf_int32_vector_end);
+            pl[0] = bcf_int32_missing;
+        }
+    }
 }
 
-void GVCFMerger::UpdateFormatAndInfo()
+void GVCFMerger::UpdateFormat()
 {
     assert(bcf_update_genotypes(_output_header, _output_record,_format->gt, _num_gvcfs * 2)==0);
     assert(bcf_update_format_string(_output_header, _output_record, "FT",(const char **)_format->ft, _num_gvcfs)==0);    
@@ -406,128 +720,337 @@ void GVCFMerger::UpdateFormatAndInfo()
 
         assert(bcf_update_format_int32(_output_header, _output_record, "PL",_format->pl, _format->num_pl)==0);
     }
+}
 
+void GVCFMerger::UpdateInfo()
+{
     // Write INFO/MQ
     if (_sum_mq_weights>0)
     {
+        //batches genotyped against a site catalogue keep the sums, so combine can average over all of them
+        if (_sites_reader != nullptr)
+        {
+            int32_t mq_sum[2] = {_mean_weighted_mq, _sum_mq_weights};
+            assert(bcf_update_info_int32(_output_header,_output_record,"MQ_SUM",mq_sum,2)==0);
+        }
         _mean_weighted_mq /= _sum_mq_weights;
         assert(bcf_update_info_int32(_output_header,_output_record,"MQ",&_mean_weighted_mq,1)==0);
     }
+    _cohort_info.Update(_output_header, _output_record, _format, _has_strand_ad);
+}
 
-    // Calculate AC/AN using htslib standard functions
-    int ret = bcf_calc_ac(_output_header,_output_record,_info_ac,BCF_UN_FMT);
-    if (ret)
+void GVCFMerger::write_vcf()
+{
+    int last_rid = -1;
+    int last_pos = 0;
+    int num_written = 0;
+    bool stopped = false;
+    //no VCF is written with --zarr, not even a header or an empty file
+    if (_zarr_writer == nullptr)
+        OpenOutput();
+    if (_zarr_writer == nullptr && (_chunk_scheduler == nullptr || _chunk == 0))
+        bcf_hdr_write(_output_file, _output_header);
+    else
+        bcf_hdr_sync(_output_header);//as writing the header would
+    if (_output_index_fmt != -1)
+        InitOutputIndex();
+    if (_progress_interval > 0)
+        InitProgress();
+    auto start_time = std::chrono::steady_clock::now();
+    auto last_progress_time = start_time, last_memory_time = start_time;
+    int last_progress_written = 0;
+    while (next())
     {
-        // sum over all allele counts to get AN
-        int an = 0;
-        for (int i=0; i<_output_record->n_allele; i++)
-            an += _info_ac[i];
-
-        bcf_update_info_int32(_output_header, _output_record, "AN", &an, 1);
-        bcf_update_info_int32(_output_header, _output_record, "AC", _info_ac+1, _output_record->n_allele-1);
-    }
+        if (!(_output_record->pos >= last_pos || _output_record->rid > last_rid))
+        {
+            std::cerr << bcf_hdr_int2id(_output_header, BCF_DT_CTG, _output_record->rid) << ":"
+                      << _output_record->pos + 1 << std::endl;
+            std::cerr << bcf_hdr_int2id(_output_header, BCF_DT_CTG, last_rid) << ":" << last_pos + 1 << std::endl;
+            ggutils::print_variant(_output_header, _output_record);
+            throw std::runtime_error("GVCFMerger::write_vcf variants out of order");
+        }
 
-    // Calculate INFO/ADF + INFO/ADR
-    if(_has_strand_ad)
-    {
-        for (size_t i=0;i<(_num_gvcfs*_output_record->n_allele);i+=_output_record->n_allele)
+        //another thread has taken the rest of the chunk
+        if (_chunk_scheduler != nullptr && !_chunk_scheduler->Continue(_chunk, _output_record->rid, _output_record->pos))
+        {
+            stopped = true;
+            break;
+        }
+        last_pos = _output_record->pos;
+        last_rid = _output_record->rid;
+        StageTimer timer(Stage::Write);
+        if (_zarr_writer != nullptr)
+            _zarr_writer->AddSite(_output_record, _format);
+        else
         {
-            bool all_info_adf_missing(true);
-            bool all_info_adr_missing(true);
-            for (size_t j=0;j<_output_record->n_allele;++j)
+            bcf_write1(_output_file, _output_header, _output_record);
+            if (_output_index != nullptr &&
+                hts_idx_push(_output_index, _output_record->rid, _output_record->pos,
+                             _output_record->pos + _output_record->rlen, bgzf_tell(_output_file->fp.bgzf), 1) < 0)
             {
-                assert( (_format->adr[i+j]==bcf_int32_missing) == (_format->adf[i+j]==bcf_int32_missing) );
-                if(_format->adf[i+j]!=bcf_int32_missing)
-                {
-                    _info_adf[j] += _format->adf[i+j];
-                    all_info_adf_missing = false;
-                }
-                if(_format->adr[i+j]!=bcf_int32_missing)
-                {
-                    _info_adr[j] += _format->adr[i+j];
-                    all_info_adr_missing = false;
-                }
-            }
-            // Set INFO/ADF array entries to dummy value if they are all missing
-            if (all_info_adf_missing) {
-                std::fill(_info_adf,_info_adf+_output_record->n_allele,0);
+                ggutils::die("problem indexing " + _output_filename);
             }
-            // Set INFO/ADR array entries to dummy value if they are all missing
-            if (all_info_adr_missing) {
-                std::fill(_info_adr,_info_adr+_output_record->n_allele,0);
+        }
+        num_written++;
+        auto now = std::chrono::steady_clock::now();
+        bool log_progress = _progress_interval > 0 &&
+                            std::chrono::duration<double>(now - last_progress_time).count() >= _progress_interval;
+        if (log_progress || num_written == 1 || now - last_memory_time >= std::chrono::seconds(1))
+        {
+            merge_memory_t memory = GetMemoryUsage();
+            if (memory.TotalBytes() > _peak_memory.TotalBytes())
+                _peak_memory = memory;
+            last_memory_time = now;
+            if (log_progress)
+            {
+                double interval = std::chrono::duration<double>(now - last_progress_time).count();
+                LogProgress(std::chrono::duration<double>(now - start_time).count(), interval,
+                            num_written, num_written - last_progress_written);
+                LogMemoryUsage("Memory", memory);
+                last_progress_time = now;
+                last_progress_written = num_written;
             }
         }
-        bcf_update_info_int32(_output_header,_output_record,"ADF",_info_adf,_output_record->n_allele);
-        bcf_update_info_int32(_output_header,_output_record,"ADR",_info_adr,_output_record->n_allele);
-        ggutils::fisher_sb_test(_info_adr,_info_adf,_output_record->n_allele,_sb_pvalue);
-        bcf_update_info_float(_output_header,_output_record,"FS",_sb_pvalue.data(),_output_record->n_allele-1);
     }
-    
+    if (_zarr_writer != nullptr)
+        _zarr_writer->Close();
+    if (_output_index != nullptr)
+        SaveOutputIndex();
+    //with a site catalogue, sample rows after the last site are never read
+    assert(_sites_reader != nullptr || stopped || AreAllReadersEmpty());
+    _lg->info("Wrote {} variants",num_written);
+    if (_read_ahead != nullptr)
+        _lg->info("Read ahead {}MB in {} requests", _read_ahead->GetBytesRequested() >> 20, _read_ahead->GetNumRequests());
+    if (_file_pool != nullptr)
+        _lg->info("Reopened inputs {} times with at most {} open", _file_pool->GetNumReopens(), _file_pool->GetMaxOpen());
+    LogMemoryUsage("Peak memory", _peak_memory);
+}
+
+//Same bins as bcf_index/tbx_index in htslib so the index matches one built by bcftools index afterwards.
+void GVCFMerger::InitOutputIndex()
+{
+    int min_shift = 14, n_lvls = 5;
+    int64_t max_len = 0;
+    int num_contigs = 0;
+    const char **names = bcf_hdr_seqnames(_output_header, &num_contigs);
+    for (int i = 0; i < num_contigs; i++)
+        max_len = std::max(max_len, ggutils::get_contig_length(_output_header, i));
+    if (!max_len) max_len = ((int64_t) 1 << 31) - 1;
+    max_len += 256;
+    //tbi bins only cover 2^29bp
+    if (_output_index_fmt == HTS_FMT_TBI && max_len > ((int64_t) 1 << 29))
+        _output_index_fmt = HTS_FMT_CSI;
+    if (_output_index_fmt == HTS_FMT_CSI)
+        for (n_lvls = 0; max_len > ((int64_t) 1 << (min_shift + 3 * n_lvls)); n_lvls++);
+    _output_index = hts_idx_init(num_contigs, _output_index_fmt, bgzf_tell(_output_file->fp.bgzf), min_shift, n_lvls);
+    if (_output_index == nullptr)
+    {
+        ggutils::die("problem initialising index for " + _output_filename);
+    }
+
+    //tabix stores the VCF column layout and the contig names (in rid order) in the index
+    if (!_output_file->is_bin)
+    {
+        string meta((const char *) &tbx_conf_vcf, 24);
+        string contig_names;
+        for (int i = 0; i < num_contigs; i++)
+            contig_names.append(names[i], strlen(names[i]) + 1);
+        int32_t l_nm = contig_names.size();
+        meta.append((const char *) &l_nm, 4);
+        meta += contig_names;
+        assert(hts_idx_set_meta(_output_index, meta.size(), (uint8_t *) meta.data(), 1) == 0);
+    }
+    free(names);
+}
+
+void GVCFMerger::SaveOutputIndex()
+{
+    hts_idx_finish(_output_index, bgzf_tell(_output_file->fp.bgzf));
+    //close the output first, htslib warns about indices older than their data file
+    hts_close(_output_file);
+    _output_file = nullptr;
+    if (hts_idx_save(_output_index, _output_filename.c_str(), _output_index_fmt) < 0)
+    {
+        ggutils::die("problem writing index for " + _output_filename);
+    }
+    _lg->info("Wrote index for {}", _output_filename);
+}
+
+//The readers have filled their buffers on construction, which gives the bytes per buffered variant
+//(including the depth blocks read along with it).
+void GVCFMerger::SetBufferMemory(size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    merge_memory_t memory = GetMemoryUsage();
+    double bytes_per_variant = 1024;
+    if (memory.variant_buffer_records > 0)
+        bytes_per_variant = (double) (memory.variant_buffer_bytes + memory.depth_buffer_bytes) / memory.variant_buffer_records;
+    size_t max_variants = std::max((size_t) 2, (size_t) (bytes / bytes_per_variant / _num_gvcfs));
+    for (auto &reader : _readers)
+        reader.SetMaxBufferedVariants(max_variants);
+    _lg->info("Read-ahead budget of {}MB allows about {} buffered variants per input ({:.0f} bytes per variant)",
+              bytes >> 20, max_variants, bytes_per_variant);
+}
+
+void GVCFMerger::SetIoThreads(int num_threads)
+{
+    if (num_threads <= 0 || _read_ahead != nullptr)
+        return;
+    _read_ahead = new ReadAhead(num_threads);
+    size_t num_prefetched = 0;
+    for (auto &reader : _readers)
+        num_prefetched += reader.SetReadAhead(_read_ahead);
+    _lg->info("Prefetching {} of {} inputs with {} I/O threads, {}kB ahead of each",
+              num_prefetched, _num_gvcfs, num_threads, _read_ahead->GetWindow() >> 10);
+}
+
+void GVCFMerger::SetProgressInterval(double seconds)
+{
+    _progress_interval = seconds;
+}
 
+void GVCFMerger::SetChunk(ChunkScheduler *chunk_scheduler, size_t chunk)
+{
+    if (_zarr_writer != nullptr || _output_index_fmt != -1)
+        ggutils::die("-@ cannot be combined with --zarr or an index written on the fly");
+    _chunk_scheduler = chunk_scheduler;
+    _chunk = chunk;
+}
 
-    // Calculate INFO/HOM (probably better called INFO/HOM_ALT?)
-    if (_format->ploidy>1) 
+//The genomic intervals covered by the run, so progress is the fraction of their bases behind the
+//current position. Region files are not parsed and count as the whole genome.
+void GVCFMerger::InitProgress()
+{
+    _progress_regions.clear();
+    int num_contigs = 0;
+    const char **names = bcf_hdr_seqnames(_output_header, &num_contigs);
+    free(names);
+    if (_region.empty() || _is_file)
+    {
+        for (int rid = 0; rid < num_contigs; rid++)
+            _progress_regions.push_back({rid, 0, ggutils::get_contig_length(_output_header, rid)});
+    }
+    else
     {
-        size_t n_hom_alt=0;
-        for(size_t i=0;i<_num_gvcfs;++i)
+        std::stringstream ss(_region);
+        string region;
+        while (getline(ss, region, ','))
         {
-            if (!bcf_gt_is_missing(_format->gt[2*i]) && !bcf_gt_is_missing(_format->gt[2*i+1])) {
-                if (bcf_gt_allele(_format->gt[2*i])==bcf_gt_allele(_format->gt[2*i+1])) {
-                    ++n_hom_alt;
-                }
-            }
+            int beg, end;
+            const char *name_end = hts_parse_reg(region.c_str(), &beg, &end);
+            int rid = name_end ? bcf_hdr_name2id(_output_header, region.substr(0, name_end - region.c_str()).c_str()) : -1;
+            if (rid < 0)
+                continue;
+            int64_t length = ggutils::get_contig_length(_output_header, rid);
+            _progress_regions.push_back({rid, beg, length > 0 ? std::min((int64_t) end, length) : 0});
         }
-        bcf_update_info_int32(_output_header,_output_record,"HOM",&n_hom_alt,1);
     }
+    _progress_total_bp = 0;
+    for (auto &r : _progress_regions)
+        _progress_total_bp += std::max((int64_t) 0, r.end - r.beg);
+}
 
-    // Calculate INFO/GC
-    if (_format->ploidy>1) 
+merge_memory_t GVCFMerger::GetMemoryUsage()
+{
+    merge_memory_t ret;
+    if (_header_bytes == 0)
     {
-        int num_gt_per_sample = ggutils::get_number_of_gt_combinations(_format->ploidy,_output_record->n_allele);
-        for(size_t i=0;i<_num_gvcfs;++i)
+        _header_bytes = _header_cache.GetMemoryUsage();
+        _num_headers = _header_cache.GetNumHeaders();
+        //the collapser keeps a sample-less copy of the output header
+        size_t collapser_header_bytes = _record_collapser.GetHeaderMemoryUsage();
+        if (collapser_header_bytes > 0)
         {
-            if (!bcf_gt_is_missing(_format->gt[2*i]) && !bcf_gt_is_missing(_format->gt[2*i+1])) {
-                if ( (_format->gt[2*i] == bcf_int32_vector_end) ||
-                     (_format->gt[2*i+1] == bcf_int32_vector_end) ) {
-                       // this indicates a sample with ploidy==1 which we skip
-                       continue;
-                }
-                int gt0 = bcf_gt_allele(_format->gt[2*i]);
-                int gt1 = bcf_gt_allele(_format->gt[2*i+1]);
-                size_t idx = bcf_alleles2gt(gt0,gt1);
-                _info_gc[idx] += 1;
-            }
+            _header_bytes += collapser_header_bytes;
+            _num_headers++;
         }
-        assert(bcf_update_info_int32(_output_header,_output_record,"GC",_info_gc,num_gt_per_sample)==0);
+        for (auto &reader : _readers)
+            _header_bytes += reader.GetHeaderMemoryUsage();
     }
+    for (size_t i = 0; i < _num_gvcfs; i++)
+    {
+        size_t variant_bytes = _readers[i].GetVariantBufferMemoryUsage();
+        size_t depth_bytes = _readers[i].GetDepthBufferMemoryUsage();
+        ret.variant_buffer_bytes += variant_bytes;
+        ret.variant_buffer_records += _readers[i].GetNumVariants();
+        ret.depth_buffer_bytes += depth_bytes;
+        ret.depth_buffer_blocks += _readers[i].GetNumDepthBlocks();
+        if (variant_bytes + depth_bytes > ret.worst_reader_bytes)
+        {
+            ret.worst_reader_bytes = variant_bytes + depth_bytes;
+            ret.worst_reader = _readers[i].GetFileName();
+        }
+    }
+    ret.header_bytes = _header_bytes + ggutils::bcf_hdr_memory_usage(_output_header);
+    ret.num_headers = _num_headers + 1;
+    ret.collapser_bytes = _record_collapser.GetMemoryUsage();
+    ret.collapser_records = _record_collapser.GetNumAlleles();
+    ret.format_bytes = _format->memory_usage();
+    ret.format_values = _format->num_sample * (5 + _format->ploidy) + 3 * _format->num_ad + _format->num_pl;
+    ret.output_record_bytes = ggutils::bcf1_memory_usage(_output_record);
+    return (ret);
+}
 
-    SetMedianInfoValues();
-    SetHistogramInfoValues();
+void GVCFMerger::LogMemoryUsage(const string &label, const merge_memory_t &memory)
+{
+    _lg->info("{}: total_bytes={} variant_buffer_bytes={} variant_buffer_records={} depth_buffer_bytes={} depth_buffer_blocks={} "
+              "header_bytes={} headers={} collapser_bytes={} collapser_records={} format_bytes={} format_values={} "
+              "output_record_bytes={} worst_input={} worst_input_bytes={}",
+              label, memory.TotalBytes(), memory.variant_buffer_bytes, memory.variant_buffer_records,
+              memory.depth_buffer_bytes, memory.depth_buffer_blocks, memory.header_bytes, memory.num_headers,
+              memory.collapser_bytes, memory.collapser_records, memory.format_bytes, memory.format_values,
+              memory.output_record_bytes, memory.worst_reader.empty() ? "NA" : memory.worst_reader, memory.worst_reader_bytes);
 }
 
-void GVCFMerger::write_vcf()
+void GVCFMerger::LogProgress(double elapsed, double interval, int num_written, int num_written_interval)
 {
-    int last_rid = -1;
-    int last_pos = 0;
-    int num_written = 0;
-    while (next())
+    int rid = _output_record->rid;
+    int64_t pos = _output_record->pos;
+    int64_t done_bp = 0;
+    for (auto &r : _progress_regions)
     {
-        if (!(_output_record->pos >= last_pos || _output_record->rid > last_rid))
+        if (r.rid < rid)
+            done_bp += std::max((int64_t) 0, r.end - r.beg);
+        else if (r.rid == rid)
+            done_bp += std::max((int64_t) 0, std::min(pos, r.end) - r.beg);
+    }
+    size_t num_buffered = 0;
+    for (auto &reader : _readers)
+        num_buffered += reader.GetNumVariants() + reader.GetNumDepthBlocks();
+
+    double sites_per_second = num_written_interval / interval;
+    string eta = "NA", percent_done = "NA";
+    if (_progress_total_bp > 0 && done_bp > 0)
+    {
+        double fraction = std::min(1., (double) done_bp / _progress_total_bp);
+        percent_done = to_string((int) (100 * fraction)) + "%";
+        eta = ggutils::string_duration(elapsed * (1 - fraction) / fraction);
+    }
+    _lg->info("Progress: {}:{} sites={} sites_per_second={:.1f} sample_sites_per_second={:.0f} buffered_records={} done={} eta={}",
+              bcf_hdr_id2name(_output_header, rid), pos + 1, num_written, sites_per_second,
+              sites_per_second * _num_gvcfs, num_buffered, percent_done, eta);
+}
+
+//Records are merged by rid, so every input must list its contigs in the same order. This only
+//needs checking once per distinct header.
+void GVCFMerger::ValidateHeaders()
+{
+    const bcf_hdr_t *first = _readers[0].GetHeader();
+    std::set<const bcf_hdr_t *> checked = {first};
+    for (auto &reader : _readers)
+    {
+        const bcf_hdr_t *hdr = reader.GetHeader();
+        if (!checked.insert(hdr).second)
+            continue;
+        int n = std::min(hdr->n[BCF_DT_CTG], first->n[BCF_DT_CTG]);
+        for (int rid = 0; rid < n; rid++)
         {
-            std::cerr << bcf_hdr_int2id(_output_header, BCF_DT_CTG, _output_record->rid) << ":"
-                      << _output_record->pos + 1 << std::endl;
-            std::cerr << bcf_hdr_int2id(_output_header, BCF_DT_CTG, last_rid) << ":" << last_pos + 1 << std::endl;
-            ggutils::print_variant(_output_header, _output_record);
-            throw std::runtime_error("GVCFMerger::write_vcf variants out of order");
+            if (strcmp(bcf_hdr_id2name(hdr, rid), bcf_hdr_id2name(first, rid)) != 0)
+                ggutils::die("contig " + std::to_string(rid + 1) + " of " + reader.GetFileName() + " is " + bcf_hdr_id2name(hdr, rid) +
+                             " but " + bcf_hdr_id2name(first, rid) + " in " + _readers[0].GetFileName() + ", inputs must have the same contigs in the same order");
         }
-
-        last_pos = _output_record->pos;
-        last_rid = _output_record->rid;
-        bcf_write1(_output_file, _output_header, _output_record);
-        num_written++;
     }
-    assert(AreAllReadersEmpty());
-    _lg->info("Wrote {} variants",num_written);
 }
 
 void GVCFMerger::BuildHeader()
@@ -536,10 +1059,9 @@ void GVCFMerger::BuildHeader()
     std::unordered_map<std::string,long long> repeat_count;
     for (size_t i = 0; i < _num_gvcfs; i++)
     {
-        const bcf_hdr_t *hr = _readers[i].GetHeader();
-        for (int j = 0; j < bcf_hdr_nsamples(hr); j++)
+        for (auto &name : _readers[i].GetSampleNames())
         {
-            string sample_name = hr->samples[j];
+            string sample_name = name;
             if (bcf_hdr_id2int(_output_header, BCF_DT_SAMPLE, sample_name.c_str()) != -1)
             {
                 if (_force_samples)
@@ -605,6 +1127,4 @@ void GVCFMerger::BuildHeader()
             "variant sites, otherwise minimum of {Genotype quality assuming variant position,Genotype quality assuming non-variant position}\">");
     bcf_hdr_append(_output_header, ("##gvcfgenotyper_version="+(string)GG_VERSION).c_str());
     ggutils::copy_contigs(_readers[0].GetHeader(), _output_header);
-    
-    bcf_hdr_write(_output_file, _output_header);
 }
@@ -18,6 +18,28 @@ extern "C" {
 #include "GVCFReader.hh"
 #include "multiAllele.hh"
 #include "Genotype.hh"
+#include "ZarrWriter.hh"
+#include "ChunkScheduler.hh"
+#include "CohortInfo.hh"
+
+//approximate heap bytes and element counts of the structures held during a merge
+struct merge_memory_t
+{
+    merge_memory_t() : variant_buffer_bytes(0), variant_buffer_records(0), depth_buffer_bytes(0), depth_buffer_blocks(0),
+                       header_bytes(0), num_headers(0), collapser_bytes(0), collapser_records(0), format_bytes(0),
+                       format_values(0), output_record_bytes(0), worst_reader_bytes(0) {};
+    size_t TotalBytes() const
+    { return (variant_buffer_bytes + depth_buffer_bytes + header_bytes + collapser_bytes + format_bytes + output_record_bytes); };
+
+    size_t variant_buffer_bytes, variant_buffer_records;//VariantBuffer of every reader
+    size_t depth_buffer_bytes, depth_buffer_blocks;//DepthBuffer of every reader
+    size_t header_bytes, num_headers;//distinct input header layouts, the output header and the collapser's copy of it
+    size_t collapser_bytes, collapser_records;//multiAllele
+    size_t format_bytes, format_values;//ggutils::vcf_data_t
+    size_t output_record_bytes;
+    size_t worst_reader_bytes;//reader holding the most buffered bytes
+    string worst_reader;
+};
 
 class GVCFMerger
 {
@@ -30,12 +52,44 @@ public:
 	           const string &region = "",
                const int is_file = 0,
                bool ignore_non_matching_ref=false,
-               bool force_samples=false);
+               bool force_samples=false,
+               size_t max_open_files=0,
+               int open_threads=1,
+               Manifest *manifest=nullptr);
     ~GVCFMerger();
     void write_vcf();
     bool next();
     int GetNextVariant();
+    int GetNextSite();
     void SetMaxAlleles(size_t max_alleles) {_max_alleles=max_alleles;};
+    //only write homref FORMAT values when a sample's reference block changes (see docs/sparse_output.md)
+    void SetSparseRefBlocks(bool sparse_ref_blocks);
+    //only write the merged sites with carrier counts, samples are not genotyped
+    void SetSitesOnly(bool sites_only);
+    //genotype against a fixed site catalogue (eg. --sites-only output) instead of the union of the input alleles
+    void SetSites(const string &sites_file);
+    //write chunked variant x sample arrays to a Zarr directory store instead of VCF/BCF
+    void SetZarrOutput(const string &directory, int max_alleles);
+    //write FORMAT fields the way hail's import_vcf expects them (replaces docs/hail/ilmn2hail.agg.c)
+    void SetHail(bool hail);
+    //comma separated list of extra INFO tags to compute, any of HWE,MAF,ExcHet,F_MISSING
+    void SetInfoTags(const string &tags);
+    //adds INFO/AC_<group> and INFO/AN_<group>, file has lines of "sample group1[,group2...]"
+    void SetSampleGroups(const string &sample_groups_file);
+    //builds a .csi (BCF) or .tbi (VCF) index for the bgzipped output while records are written
+    void SetWriteIndex(bool write_index);
+    //splits a read-ahead memory budget across the readers, dense regions then get a shorter window
+    void SetBufferMemory(size_t bytes);
+    //prefetches the inputs from storage with this many background threads (0 turns it off)
+    void SetIoThreads(int num_threads);
+    //logs position, throughput, buffered records and an ETA every this many seconds (0 turns it off)
+    void SetProgressInterval(double seconds);
+    //merges one chunk of a multi-threaded run: stops once the scheduler moves the chunk's end before the next
+    //record, and only chunk 0 writes the header
+    void SetChunk(ChunkScheduler *chunk_scheduler, size_t chunk);
+    //sizes of the buffers right now, and the largest total seen by write_vcf (sampled about once a second)
+    merge_memory_t GetMemoryUsage();
+    const merge_memory_t &GetPeakMemoryUsage() {return (_peak_memory);};
 
     //void dumpGT();
 
@@ -44,21 +98,32 @@ private:
     void GenotypeAltVariant(int sample_index,bcf1_t *sample_variants);
     void GenotypeSample(int sample_index);
     void UpdateFormatAndInfo();
+    void UpdateInfo();
+    void UpdateFormat();
+    void MaskUnchangedRefBlocks();
+    void CountCarriers();
+    void ApplyHailRules();
+    void ValidateHeaders();
     void BuildHeader();
     void SetOutputBuffersToMissing(int num_alleles);
     bool AreAllReadersEmpty();
-    void SetMedianInfoValues();
-    vector<int> FindAltGenotypes(const int allele);
-    void SetHistogramInfoValues();
+    void OpenOutput();
+    void InitOutputIndex();
+    void SaveOutputIndex();
+    void InitProgress();
+    void LogProgress(double elapsed, double interval, int num_written, int num_written_interval);
+    void LogMemoryUsage(const string &label, const merge_memory_t &memory);
 
     multiAllele _record_collapser;
+    HeaderCache _header_cache;//shared by the readers, so declared before them
+    FilePool *_file_pool;//nullptr when every input stays open
     vector<GVCFReader> _readers;
     size_t _num_gvcfs;
     bcf1_t *_output_record;
     htsFile *_output_file;
     bcf_hdr_t *_output_header;
     ggutils::vcf_data_t *_format;//stores all our format fields.
-    int32_t *_info_adf, *_info_adr, *_info_ac, *_info_gc;
+    CohortInfo _cohort_info;
     int _mean_weighted_mq,_sum_mq_weights,_num_variants;
     size_t _num_ps_written;
     bool _has_strand_ad,_has_pl;
@@ -66,7 +131,31 @@ private:
     std::shared_ptr<spdlog::logger> _lg;
     bool _force_samples;
 	size_t _max_alleles;
-    std::vector<float> _sb_pvalue;
+    bool _sparse_ref_blocks;
+    std::vector<DepthBlock> _last_ref_block;//last homref values written for each sample in sparse mode
+    std::vector<bool> _ref_block_unchanged;
+    bool _sites_only;
+    int32_t *_sample_gt;//GT buffer used by CountCarriers
+    int _num_sample_gt;
+    string _region;
+    int _is_file;
+    bcf_srs_t *_sites_reader;//site catalogue for two-pass genotyping
+    size_t _num_dropped_records;//sample records not in the site catalogue
+    ZarrWriter *_zarr_writer;
+    bool _hail;
+    string _output_filename, _output_mode;
+    hts_idx_t *_output_index;
+    int _output_index_fmt;//HTS_FMT_CSI or HTS_FMT_TBI
+    double _progress_interval;
+    struct progress_region_t {int rid; int64_t beg, end;};
+    vector<progress_region_t> _progress_regions;
+    int64_t _progress_total_bp;
+    ReadAhead *_read_ahead;
+    merge_memory_t _peak_memory;
+    size_t _header_bytes;//headers do not change, so they are only measured once
+    size_t _num_headers;//those in _header_bytes: the header cache's and the collapser's
+    ChunkScheduler *_chunk_scheduler;
+    size_t _chunk;
 };
 
 #endif
@@ -1,6 +1,9 @@
 #include <htslib/vcf.h>
 #include "GVCFReader.hh"
 #include "StringUtil.hh"
+#include "StageTimer.hh"
+#include "LogThrottle.hh"
+#include "FormatFields.hh"
 //#define DEBUG
 
 int GVCFReader::FlushBuffer(bcf1_t *record)
@@ -20,52 +23,90 @@ int GVCFReader::FlushBuffer(int chrom, int pos)
     return (num_flushed);
 }
 
+int GVCFReader::DropVariantsNotIn(bcf1_t *record, multiAllele &alleles)
+{
+    return (_variant_buffer.RemoveIf(record, [&alleles](bcf1_t *v) { return !alleles.HasAllele(v, 1); }));
+}
+
 int GVCFReader::FlushBuffer()
 {
     _depth_buffer.FlushBuffer();
     return (_variant_buffer.FlushBuffer());
 }
 
+const char *GVCFReader::FT_HEADER_LINE = "##FORMAT=<ID=FT,Number=1,Type=String,Description=\"Sample filter, 'PASS' indicates that all single sample filters passed for this sample\">";
+
+GVCFReader::GVCFReader()
+{
+    _reader = nullptr;
+    _homref_parser = nullptr;
+    _bcf_record = nullptr;
+    _bcf_header = nullptr;
+    _normaliser = nullptr;
+}
+
 GVCFReader::GVCFReader(const std::string &input_gvcf, Normaliser * normaliser, const int buffer_size,
-                       const string &region /*=""*/, const int is_file /*=0*/)
+                       const string &region /*=""*/, const int is_file /*=0*/,
+                       HeaderCache *header_cache /*=nullptr*/, FilePool *file_pool /*=nullptr*/) : GVCFReader()
 {
+    Open(input_gvcf, normaliser, buffer_size, region, is_file, header_cache, file_pool);
+}
+
+void GVCFReader::Open(const std::string &input_gvcf, Normaliser * normaliser, const int buffer_size,
+                      const string &region /*=""*/, const int is_file /*=0*/,
+                      HeaderCache *header_cache /*=nullptr*/, FilePool *file_pool /*=nullptr*/,
+                      const Manifest *manifest /*=nullptr*/)
+{
+    assert(_reader == nullptr);
     _input_gvcf=input_gvcf;
     _lg = spdlog::get("gg_logger");
     assert(_lg!=nullptr);
-    _bcf_record = nullptr;
-    _bcf_reader = bcf_sr_init();
-    if (!region.empty())
-    {
-        if (bcf_sr_set_regions(_bcf_reader, region.c_str(), is_file) == -1)
-        {
-            ggutils::die("Cannot navigate to region " + region);
-        }
-    }
-    if (!(bcf_sr_add_reader(_bcf_reader, input_gvcf.c_str())))
+    int manifest_index = manifest != nullptr ? manifest->Find(input_gvcf) : -1;
+    if (manifest != nullptr && manifest_index < 0)
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} is not in the manifest, reading its header and index", input_gvcf);
+    else if (manifest_index >= 0 && !manifest->IsCurrent(manifest_index))
     {
-      ggutils::die("problem opening "+input_gvcf+"\n"+bcf_sr_strerror(_bcf_reader->errnum));
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} has changed since the manifest was built, reading its header and index", input_gvcf);
+        manifest_index = -1;
     }
+    if (manifest_index >= 0)
+        _reader = new IndexedReader(*manifest, manifest_index, region, is_file, file_pool, header_cache);
+    else
+        _reader = new IndexedReader(input_gvcf, region, is_file, header_cache, file_pool);
     if (buffer_size < 2)
     {
         ggutils::die("GVCFReader needs buffer size of at least 2");
     }
     _buffer_size = buffer_size;
-    _bcf_record = nullptr;
-
-    //header setup
-    _bcf_header = bcf_hdr_dup(_bcf_reader->readers[0].header);
-    bcf_hdr_append(_bcf_header, "##FORMAT=<ID=FT,Number=1,Type=String,Description=\"Sample filter, 'PASS' indicates that all single sample filters passed for this sample\">");
-    bcf_hdr_sync(_bcf_header);
+    _window = buffer_size;
+    _max_buffered_variants = 0;
+    _variants_per_bp = 0;
+    _max_shift = 0;
+    _num_refills = 0;
+    _bcf_record = bcf_init();
+
+    //header setup, FT is added to the reader's header so records can be parsed and updated with one copy of it.
+    //A header_cache adds it to shared headers itself (see HeaderCache::AddHeaderLine).
+    _bcf_header = _reader->GetHeader();
+    if (!bcf_hdr_idinfo_exists(_bcf_header, BCF_HL_FMT, bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "FT")))
+    {
+        assert(header_cache == nullptr);
+        bcf_hdr_append(_bcf_header, FT_HEADER_LINE);
+        bcf_hdr_sync(_bcf_header);
+    }
+    _homref_parser = new HomrefParser(_bcf_header);
     _normaliser = normaliser;
+    _buffer_depth = true;
     FillBuffer();
 
     // flush variant buffer to get rid of variants overlapping 
-    // the interval start
-    if(region.find(":")!=std::string::npos)
+    // the interval start (of the first of a list of regions)
+    string first_region = region.substr(0, region.find(','));
+    if(first_region.find(":")!=std::string::npos)
     {
         string chr;
         int64_t start=0, end = 0;
-        stringutil::parsePos(region, chr, start, end);
+        stringutil::parsePos(first_region, chr, start, end);
         if (!region.empty())
         {
             int rid = bcf_hdr_name2id(_bcf_header, chr.c_str());
@@ -75,13 +116,13 @@ GVCFReader::GVCFReader(const std::string &input_gvcf, Normaliser * normaliser, c
 
     //Checking and warning if a few tags are not present. This is how we support legacy GVCFs without crashing.
     if(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "ADF")==-1)
-        _lg->warn("WARNING: {} has no FORMAT/ADF tag",input_gvcf);
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} has no FORMAT/ADF tag",input_gvcf);
     if(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "ADR")==-1)
-        _lg->warn("WARNING: {} has no FORMAT/ADR tag",input_gvcf);
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} has no FORMAT/ADR tag",input_gvcf);
     if(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "PL")==-1) 
-        _lg->warn("WARNING: {} has no FORMAT/PL tag",input_gvcf);
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} has no FORMAT/PL tag",input_gvcf);
     if(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "MQ")==-1)
-        _lg->warn("WARNING: {} has no MQ tag",input_gvcf);
+        LogThrottle::WarnOnce(_lg, input_gvcf, "WARNING: {} has no MQ tag",input_gvcf);
 }
 
 bool GVCFReader::HasPl()
@@ -89,6 +130,15 @@ bool GVCFReader::HasPl()
     return(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "PL")!=-1);
 }
 
+void GVCFReader::SetBufferDepth(bool buffer_depth)
+{
+    _buffer_depth = buffer_depth;
+    if (!_buffer_depth)
+    {
+        _depth_buffer.FlushBuffer();
+    }
+}
+
 bool GVCFReader::HasStrandAd()
 {
     return(bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "ADF")!=-1 && bcf_hdr_id2int(_bcf_header, BCF_DT_ID, "ADR")!=-1);
@@ -96,34 +146,78 @@ bool GVCFReader::HasStrandAd()
 
 GVCFReader::~GVCFReader()
 {
-    if (_bcf_reader->errnum)
-    {
-        error("Error: %s\n", bcf_sr_strerror(_bcf_reader->errnum));
-    }
-    bcf_sr_destroy(_bcf_reader);
-    bcf_hdr_destroy(_bcf_header);
+    bcf_destroy(_bcf_record);
+    delete _homref_parser;
+    delete _reader;
 }
 
+//Keeps at least _window bp of variants buffered ahead of Front(). Once the window falls short the
+//buffer is topped up to a quarter window past it, reading as many variants as the observed density
+//suggests per ReadLines call, so the next few sites do not need to read at all.
 size_t GVCFReader::FillBuffer()
 {
-
     if (_variant_buffer.Size() < 2)
     {
         ReadLines(2);
     }
-    while (_variant_buffer.Size() > 1 && _variant_buffer.Back()->rid == _variant_buffer.Front()->rid &&
-           (_variant_buffer.Back()->pos - _variant_buffer.Front()->pos) < _buffer_size)
+    while (_variant_buffer.Size() > 1 && _variant_buffer.Back()->rid == _variant_buffer.Front()->rid)
     {
-        int num_read = ReadLines(1);
-        if (num_read == 0)
+        int span = _variant_buffer.Back()->pos - _variant_buffer.Front()->pos;
+        if (span >= _window)
+        {
+            break;
+        }
+        double deficit = _window + _window / 4 - span;
+        unsigned batch = std::min(64., std::max(1., deficit * _variants_per_bp));
+        _num_refills++;
+        if (ReadLines(batch) == 0)
         {
             break;
         }
+        UpdateWindow();
     }
 
     return (_variant_buffer.Size());
 }
 
+//The window shrinks where variants are dense so this reader stays within its share of the memory budget,
+//but never below a few times the largest shift seen from left-aligning a record, since a record read
+//later must not be realigned to before a position that has already been flushed.
+void GVCFReader::UpdateWindow()
+{
+    if (_variant_buffer.Size() < 2 || _variant_buffer.Back()->rid != _variant_buffer.Front()->rid)
+    {
+        return;
+    }
+    int span = _variant_buffer.Back()->pos - _variant_buffer.Front()->pos;
+    double density = (double) _variant_buffer.Size() / (span + 1);
+    _variants_per_bp = _variants_per_bp > 0 ? 0.8 * _variants_per_bp + 0.2 * density : density;
+    if (_max_buffered_variants == 0)
+    {
+        _window = _buffer_size;
+        return;
+    }
+    int min_window = std::min(_buffer_size, std::max(1000, 4 * _max_shift));
+    double window = _max_buffered_variants / _variants_per_bp;
+    _window = window >= _buffer_size ? _buffer_size : std::max(min_window, (int) window);
+}
+
+void GVCFReader::ReleaseFile()
+{
+    _reader->Park();
+}
+
+bool GVCFReader::SetReadAhead(ReadAhead *read_ahead)
+{
+    return (_reader->SetReadAhead(read_ahead));
+}
+
+void GVCFReader::SetMaxBufferedVariants(size_t max_buffered_variants)
+{
+    _max_buffered_variants = max_buffered_variants;
+    UpdateWindow();
+}
+
 int GVCFReader::ReadUntil(int rid, int pos)
 {
     int num_read = 0;
@@ -135,7 +229,7 @@ int GVCFReader::ReadUntil(int rid, int pos)
         db = _depth_buffer.Back();
     }
 
-    while (db != nullptr && bcf_sr_has_line(_bcf_reader, 0) && (db->rid() < rid || (db->rid() == rid && db->end() < pos)))
+    while (db != nullptr && !_reader->Eof() && (db->rid() < rid || (db->rid() == rid && db->end() < pos)))
     {
         if (ReadLines(1) < 1)
         {
@@ -160,12 +254,25 @@ int GVCFReader::ReadLines(const unsigned num_lines)
 
     unsigned num_read = 0;
 
-    while (num_read < num_lines && bcf_sr_next_line(_bcf_reader))
+    while (num_read < num_lines)
     {
-        _bcf_record = bcf_sr_get_line(_bcf_reader, 0);
+        int status;
+        {
+            StageTimer timer(Stage::Read);
+            status = _reader->Next(_bcf_record, _homref_parser, &_homref_block);
+        }
+        if (status == 0)
+            break;
+        //a homref block read straight from the text, the same as the one built from the parsed record below
+        if (status == 2)
+        {
+            if (_buffer_depth)
+                _depth_buffer.push_back(_homref_block);
+            continue;
+        }
 
         if (ggutils::has_non_ref_symb_allele(_bcf_record)) {
-            //cout << "convert" << "\n";
+            StageTimer timer(Stage::ConvertDragen);
             ggutils::convert_dragen_gvcf_record(_bcf_header,_bcf_record);
         }
         #ifdef DEBUG
@@ -191,44 +298,53 @@ int GVCFReader::ReadLines(const unsigned num_lines)
 		        free(filter.s);
 		
 		        vector<bcf1_t *> atomised_variants;
-		        _normaliser->Unarise(_bcf_record, atomised_variants,_bcf_header);
+		        {
+		            StageTimer timer(Stage::Normalise);
+		            _normaliser->Unarise(_bcf_record, atomised_variants,_bcf_header, GetSampleName());
+		        }
+		        StageTimer timer(Stage::VariantBuffer);
 		        for (auto v = atomised_variants.begin();v!=atomised_variants.end();v++)
 		        {
+		            _max_shift = std::max(_max_shift, (int) (_bcf_record->pos - (*v)->pos));
 		            _variant_buffer.PushBack(_bcf_header, *v);
 		        }
 		        num_read++;
 	        }
 	        else
 	        {
-		        _lg->warn("WARNING: {} from {} is not a valid GVCFGenotyper variant, this record will be ignored.",ggutils::record2string(_bcf_header,_bcf_record),_input_gvcf);
+		        //checked first so suppressed warnings do not format the record
+		        if (LogThrottle::Allow("WARNING: {} from {} is not a valid GVCFGenotyper variant, this record will be ignored."))
+		            _lg->warn("WARNING: {} from {} is not a valid GVCFGenotyper variant, this record will be ignored.",ggutils::record2string(_bcf_header,_bcf_record),_input_gvcf);
 	        }
         }
         int32_t dp;
         //buffer a depth block. FIXME: this should really all be in the DepthBlock constructor.
-        if(ggutils::bcf1_get_one_format_int(_bcf_header, _bcf_record, "DP",dp)==1)
+        FormatFields fields(_bcf_header, _bcf_record);
+        if(_buffer_depth && fields.GetOneInt(FormatFields::DP,dp)==1)
         {
-            int ploidy = ggutils::get_ploidy(_bcf_header,_bcf_record);
+            int ploidy = fields.GetPloidy();
             int start = _bcf_record->pos;
             int32_t dpf, gq, end;
             end = ggutils::get_end_of_gvcf_block_or_variant(_bcf_header, _bcf_record);
             //If the record has FORMAT/GQ, use that, otherwise take FORMAT/GQX (illumina gvcf quirk).
-            int status = ggutils::bcf1_get_one_format_int(_bcf_header,_bcf_record,"GQ",gq);
+            int status = fields.GetOneInt(FormatFields::GQ,gq);
             if(status!=1)
             {
                 float tmp;
-                status = ggutils::bcf1_get_one_format_float(_bcf_header, _bcf_record, "GQ", tmp);
+                status = fields.GetOneFloat(FormatFields::GQ, tmp);
                 if (status == 1)
                     gq = bcf_float_is_missing(tmp) ? 0 : (int32_t) tmp; //replace missing values with 0
                 if (status != 1)
-                    status = ggutils::bcf1_get_one_format_int(_bcf_header, _bcf_record, "GQX", gq);
+                    status = fields.GetOneInt(FormatFields::GQX, gq);
                 if (status != 1)
                     ggutils::die("no FORMAT/GQ found");
             }
             gq = gq==bcf_int32_missing ? 0 : gq; //replace missing values with 0
-            ggutils::bcf1_get_one_format_int(_bcf_header,_bcf_record,"DPF",dpf);
+            fields.GetOneInt(FormatFields::DPF,dpf);
             _depth_buffer.push_back(DepthBlock(_bcf_record->rid, start, end, dp, dpf, gq, ploidy));
         }
     }
+    _reader->AdvanceReadAhead();
     return (num_read);
 }
 
@@ -267,6 +383,21 @@ bcf_hdr_t *GVCFReader::GetHeader()
     return (_bcf_header);
 }
 
+size_t GVCFReader::GetVariantBufferMemoryUsage()
+{
+    return (_variant_buffer.GetMemoryUsage());
+}
+
+size_t GVCFReader::GetDepthBufferMemoryUsage()
+{
+    return (_depth_buffer.GetMemoryUsage());
+}
+
+size_t GVCFReader::GetHeaderMemoryUsage()
+{
+    return (_reader->GetMemoryUsage());
+}
+
 //gets dp/dpf/gq (possibly interpolated) for a give interval a<=x<b
 void GVCFReader::GetDepth(int rid, int start, int stop, DepthBlock &db)
 {
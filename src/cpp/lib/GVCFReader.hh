@@ -18,6 +18,9 @@ extern "C" {
 #include "Normaliser.hh"
 #include "VariantBuffer.hh"
 #include "DepthBuffer.hh"
+#include "multiAllele.hh"
+#include "ReadAhead.hh"
+#include "IndexedReader.hh"
 
 #include "spdlog.h"
 
@@ -26,7 +29,17 @@ class GVCFReader
 {
 public:
     GVCFReader(const std::string &input_gvcf,Normaliser *normaliser, const int buffer_size,
-               const string &region = "", const int is_file = 0);
+               const string &region = "", const int is_file = 0, HeaderCache *header_cache = nullptr,
+               FilePool *file_pool = nullptr);
+    //an unopened reader, so that several can be opened concurrently with Open()
+    GVCFReader();
+    //opens the input and fills the buffer, the same as the constructor. Readers sharing normaliser, header_cache
+    //and file_pool may be opened from different threads; a header_cache must have FT_HEADER_LINE added.
+    //An input that is unchanged since it was added to manifest is read without its header and index.
+    void Open(const std::string &input_gvcf,Normaliser *normaliser, const int buffer_size,
+              const string &region = "", const int is_file = 0, HeaderCache *header_cache = nullptr,
+              FilePool *file_pool = nullptr, const Manifest *manifest = nullptr);
+    static const char *FT_HEADER_LINE;
 
     ~GVCFReader();
 
@@ -35,6 +48,8 @@ public:
     int FlushBuffer(int chrom, int pos);
     //empty buffer containing rows before and including record
     int FlushBuffer(bcf1_t *record);
+    //drop buffered rows up to and including record whose allele is not in alleles (used with a fixed site catalogue)
+    int DropVariantsNotIn(bcf1_t *record, multiAllele &alleles);
 
     pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> GetAllVariantsUpTo(bcf1_t *record);
     pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> GetAllVariantsInInterval(int chrom, int stop);
@@ -49,16 +64,45 @@ public:
     size_t GetNumVariants();
     size_t GetNumDepthBlocks();
     bcf_hdr_t *GetHeader();
+    //sample names of the input, GetHeader() may be shared with inputs of other samples
+    const std::vector<std::string> &GetSampleNames() {return (_reader->GetSampleNames());};
+    //first sample name for messages, nullptr without samples
+    const char *GetSampleName() {return (GetSampleNames().empty() ? nullptr : GetSampleNames()[0].c_str());};
+    const std::string &GetFileName() {return (_input_gvcf);};
+    //approximate bytes held by the buffered variants, depth blocks and the header (0 if it is shared)
+    size_t GetVariantBufferMemoryUsage();
+    size_t GetDepthBufferMemoryUsage();
+    size_t GetHeaderMemoryUsage();
     int ReadUntil(int rid, int pos);
     bool HasStrandAd();
     bool HasPl();
+    //when false homref blocks are not buffered and GetDepth is unavailable (used by --sites-only)
+    void SetBufferDepth(bool buffer_depth);
+    //shrinks the read-ahead window in dense regions to hold about this many variants (0: always buffer_size bp)
+    void SetMaxBufferedVariants(size_t max_buffered_variants);
+    //gives the file handle back to the file pool until more records are needed (no-op without a pool)
+    void ReleaseFile();
+    //prefetches the input with read_ahead, false if it is not a local bgzipped file
+    bool SetReadAhead(ReadAhead *read_ahead);
+    int GetWindow() {return (_window);};
+    size_t GetNumRefills() {return (_num_refills);};
 private:
-    int _buffer_size;//ensure buffer has at least _buffer_size/2 variants avaiable (except at end of file)
-    bcf_srs_t *_bcf_reader;//htslib synced reader.
-    bcf1_t *_bcf_record;
+    void UpdateWindow();
+
+    int _buffer_size;//largest read-ahead window in bp
+    int _window;//current read-ahead window in bp, at most _buffer_size
+    size_t _max_buffered_variants;
+    double _variants_per_bp;//moving average of the buffered variant density
+    int _max_shift;//largest left shift of a record by normalisation
+    size_t _num_refills;//ReadLines calls made by FillBuffer
+    IndexedReader *_reader;
+    HomrefParser *_homref_parser;//homref block lines skip vcf_parse1
+    DepthBlock _homref_block;
+    bcf1_t *_bcf_record;//records are parsed into this one, Unarise copies what is buffered
     bcf_hdr_t *_bcf_header;
     VariantBuffer _variant_buffer;
     DepthBuffer _depth_buffer;
+    bool _buffer_depth;
     Normaliser *_normaliser;
     std::shared_ptr<spdlog::logger> _lg;
     std::string _input_gvcf;
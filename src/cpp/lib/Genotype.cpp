@@ -1,4 +1,5 @@
 #include "Genotype.hh"
+#include "FormatFields.hh"
 
 #include <stdexcept>
 #include <htslib/vcf.h>
@@ -24,12 +25,6 @@ void Genotype::SetAdf(int val,int index)
     _adf[index] = val;
 }
 
-void Genotype::init_logger() 
-{
-    _lg = spdlog::get("gg_logger");
-    assert(_lg!=nullptr);
-}
-
 
 void Genotype::SetDp(int val)
 {
@@ -120,7 +115,6 @@ bool Genotype::IsDpMissing()
 
 Genotype::Genotype(int ploidy, int num_allele)
 {
-    init_logger();
     allocate(ploidy,num_allele);
 }
 
@@ -186,12 +180,12 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
 {
 
     int status;//keeps track of return values from htslib
-    init_logger();
     _num_allele = record->n_allele;
     bcf_unpack(record, BCF_UN_ALL);
     assert(_num_allele > 1);
+    FormatFields fields(header, record);
 
-    status = ggutils::bcf1_get_one_format_string(header,record,"FT",_filter);
+    status = fields.GetOneString(FormatFields::FT,_filter);
 //    if(status<=0) ggutils::die("bad return value ("+std::to_string(status)+") on bcf_get_format_char(header, record, \"FT\", &_filter, &_num_filter):");
 
     //this chunk of codes reads our canonical FORMAT fields (PL,GQ,DP,DPF,AD)
@@ -199,7 +193,7 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
     _gt[1] = bcf_int32_vector_end;
     _ad = _adf = _adr = _gq = _gqx = _dpf = _dp = _pl = nullptr;
     _num_gt = 2;
-    _ploidy = bcf_get_genotypes(header, record, &_gt, &_num_gt);
+    _ploidy = fields.GetInt(FormatFields::GT, &_gt, &_num_gt);
     assert(_ploidy >= 0 && _ploidy <= 2);
     _num_pl = _ploidy == 1 ? _num_allele : _num_allele * (1 + _num_allele) / 2;
 
@@ -208,7 +202,7 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
 
     _qual = record->qual;
     _pl = (int32_t *) malloc(sizeof(int32_t) * _num_pl);
-    status = bcf_get_format_int32(header, record, "PL", &_pl, &_num_pl);
+    status = fields.GetInt(FormatFields::PL, &_pl, &_num_pl);
     if (status == 1 || status == -3 || status == -1)
     {
         std::fill(_pl, _pl + _num_pl, MAXPL);
@@ -226,11 +220,11 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
         std::cerr << "Got " << status << " values instead of " << _num_pl << " ploidy=" << _ploidy << " num_allele=" << _num_allele << std::endl;
         ggutils::die("incorrect number of values in  FORMAT/PL");
     }
-    status = bcf_get_format_int32(header, record, "AD", &_ad, &_num_ad);
+    status = fields.GetInt(FormatFields::AD, &_ad, &_num_ad);
     if(status!=_num_allele)    
 	ggutils::die("incorrect number of FORMAT/AD values at "+ggutils::record2string(header,record));
     
-    if (bcf_get_format_int32(header, record, "ADF", &_adf, &_num_adf) == _num_allele)
+    if (fields.GetInt(FormatFields::ADF, &_adf, &_num_adf) == _num_allele)
     {
         _adf_found = true;
     }
@@ -238,7 +232,7 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
     {
         _adf_found = false;
     }
-    if (bcf_get_format_int32(header, record, "ADR", &_adr, &_num_adr) == _num_allele)
+    if (fields.GetInt(FormatFields::ADR, &_adr, &_num_adr) == _num_allele)
     {
         _adr_found = true;
     }
@@ -246,7 +240,7 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
     {
         _adr_found = false;
     }
-    status = bcf_get_format_int32(header, record, "DP", &_dp, &_num_dp);
+    status = fields.GetInt(FormatFields::DP, &_dp, &_num_dp);
     if (status != 1)
     {
         if (status == -3)
@@ -255,22 +249,24 @@ Genotype::Genotype(bcf_hdr_t const *header, bcf1_t *record)
             ggutils::die("problem extracting FORMAT/DP");
     }
     ggutils::bcf1_get_one_info_int(header,record,"MQ",_mq);
-    status = bcf_get_format_int32(header, record, "DPF", &_dpf, &_num_dpf);
+    status = fields.GetInt(FormatFields::DPF, &_dpf, &_num_dpf);
     if (status != 1)
     {
         _dpf = (int32_t *)malloc(sizeof(int32_t));
         *_dpf = bcf_int32_missing;
         _num_dpf=1;
     }
-    bcf_get_format_int32(header, record, "GQX", &_gqx, &_num_gqx);
+    fields.GetInt(FormatFields::GQX, &_gqx, &_num_gqx);
 
-    if (bcf_get_format_int32(header, record, "GQ", &_gq, &_num_gq) == -2)
+    if (fields.GetInt(FormatFields::GQ, &_gq, &_num_gq) == -2)
     {
         _gq = ggutils::assign_bcf_int32_missing(_gq,1);
         float *tmp_gq = nullptr;
-        if(bcf_get_format_float(header, record, "GQ", &tmp_gq, &_num_gq) != 1)
+        if(fields.GetFloat(FormatFields::GQ, &tmp_gq, &_num_gq) != 1)
         {
-	        _lg->warn("WARNING: missing FORMAT/GQ at {}:{}",bcf_hdr_int2id(header,BCF_DT_CTG,record->rid),record->pos+1);
+	        //Genotype is constructed for every sample at every site, so the logger is only looked up when needed
+	        if (LogThrottle::Allow("WARNING: missing FORMAT/GQ at {}:{}"))
+	            spdlog::get("gg_logger")->warn("WARNING: missing FORMAT/GQ at {}:{}",bcf_hdr_int2id(header,BCF_DT_CTG,record->rid),record->pos+1);
         }
         else
         {
@@ -0,0 +1,114 @@
+#include "HeaderCache.hh"
+#include "ggutils.hh"
+
+HeaderCache::HeaderCache()
+{
+    _num_lookups = 0;
+}
+
+HeaderCache::~HeaderCache()
+{
+    for (auto &it : _headers)
+        bcf_hdr_destroy(it.second.hdr);
+    for (auto &it : _copies)
+        bcf_hdr_destroy(it.second.hdr);
+}
+
+std::string HeaderCache::Layout(const bcf_hdr_t *hdr)
+{
+    std::string ret = std::to_string(bcf_hdr_nsamples(hdr));
+    for (int i = 0; i < hdr->n[BCF_DT_ID]; i++)
+    {
+        const bcf_idpair_t &id = hdr->id[BCF_DT_ID][i];
+        ret += '\n';
+        if (id.key == nullptr)
+            continue;
+        ret += id.key;
+        for (int type = BCF_HL_FLT; type <= BCF_HL_FMT; type++)
+            ret += ' ' + (id.val->hrec[type] ? std::to_string(id.val->info[type]) : ".");
+    }
+    ret += "\ncontigs";
+    for (int i = 0; i < hdr->n[BCF_DT_CTG]; i++)
+    {
+        const bcf_idpair_t &id = hdr->id[BCF_DT_CTG][i];
+        ret += '\n';
+        if (id.key != nullptr)
+            ret += std::string(id.key) + ' ' + std::to_string(id.val->info[0]);
+    }
+    return (ret);
+}
+
+void HeaderCache::AddHeaderLine(const std::string &line)
+{
+    _header_lines.push_back(line);
+}
+
+bcf_hdr_t *HeaderCache::Intern(bcf_hdr_t *hdr, std::mutex **parse_mutex)
+{
+    std::string layout = Layout(hdr);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_lookups++;
+    auto inserted = _headers.emplace(layout, shared_header_t());
+    shared_header_t &shared = inserted.first->second;
+    if (parse_mutex != nullptr)
+    {
+        if (!shared.parse_mutex)
+            shared.parse_mutex.reset(new std::mutex);
+        *parse_mutex = shared.parse_mutex.get();
+    }
+    if (!inserted.second)
+    {
+        bcf_hdr_destroy(hdr);
+        return (shared.hdr);
+    }
+    shared.hdr = hdr;
+    if (!_header_lines.empty())
+    {
+        for (auto &line : _header_lines)
+            bcf_hdr_append(hdr, line.c_str());
+        bcf_hdr_sync(hdr);
+    }
+    return (hdr);
+}
+
+bcf_hdr_t *HeaderCache::Copy(const bcf_hdr_t *hdr, std::mutex **parse_mutex)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_lookups++;
+    auto inserted = _copies.emplace(hdr, shared_header_t());
+    shared_header_t &copy = inserted.first->second;
+    if (inserted.second)
+    {
+        //bcf_hdr_dup keeps the IDX of each line, so BCF records still decode
+        copy.hdr = bcf_hdr_dup(hdr);
+        if (copy.hdr == nullptr)
+            ggutils::die("problem copying a header");
+        copy.parse_mutex.reset(new std::mutex);
+    }
+    if (parse_mutex != nullptr)
+        *parse_mutex = copy.parse_mutex.get();
+    return (copy.hdr);
+}
+
+size_t HeaderCache::GetNumHeaders()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_headers.size() + _copies.size());
+}
+
+size_t HeaderCache::GetNumLookups()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_num_lookups);
+}
+
+size_t HeaderCache::GetMemoryUsage()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t ret = 0;
+    for (auto &it : _headers)
+        ret += it.first.capacity() + ggutils::bcf_hdr_memory_usage(it.second.hdr);
+    for (auto &it : _copies)
+        ret += ggutils::bcf_hdr_memory_usage(it.second.hdr);
+    return (ret);
+}
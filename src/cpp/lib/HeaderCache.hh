@@ -0,0 +1,58 @@
+//
+// One shared copy of each distinct input header layout.
+//
+
+#ifndef GVCFGENOTYPER_HEADERCACHE_HH
+#define GVCFGENOTYPER_HEADERCACHE_HH
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+//GVCFs from one pipeline have the same contigs, FILTER/INFO/FORMAT dictionary and a single sample,
+//differing only in the sample name and free-text lines such as ##cmdline. Records parse identically
+//with any of these headers, so readers keep their sample names and share the first header seen with
+//each layout. With thousands of alt/decoy contigs this is the bulk of the per-sample memory.
+//Shared headers belong to the cache, which must outlive the readers using them. Intern() may be called
+//from several threads, so lines the readers need in the header are added by the cache to each new layout.
+class HeaderCache
+{
+public:
+    HeaderCache();
+    ~HeaderCache();
+
+    //header line added to every layout, before the first Intern()
+    void AddHeaderLine(const std::string &line);
+    //takes ownership of hdr and returns the shared header with its layout (hdr itself plus the added lines for a new layout).
+    //VCF parsing writes to a scratch buffer in the header, parse_mutex is set to the lock to hold while parsing with it.
+    bcf_hdr_t *Intern(bcf_hdr_t *hdr, std::mutex **parse_mutex = nullptr);
+    //this cache's own copy of a header that other caches use too, eg. a manifest layout, so that readers of
+    //different caches (the merge threads of -@) do not parse with the same header. Lines are not added.
+    bcf_hdr_t *Copy(const bcf_hdr_t *hdr, std::mutex **parse_mutex = nullptr);
+    //dictionaries that decide how a record is parsed: IDs with their FILTER/INFO/FORMAT types, contigs and sample count
+    static std::string Layout(const bcf_hdr_t *hdr);
+
+    size_t GetNumHeaders();//distinct layouts
+    size_t GetNumLookups();
+    size_t GetMemoryUsage();
+
+private:
+    struct shared_header_t
+    {
+        bcf_hdr_t *hdr;
+        std::unique_ptr<std::mutex> parse_mutex;
+    };
+    std::unordered_map<std::string, shared_header_t> _headers;
+    std::unordered_map<const bcf_hdr_t *, shared_header_t> _copies;//by the header copied
+    std::vector<std::string> _header_lines;
+    size_t _num_lookups;
+    std::mutex _mutex;
+};
+
+#endif //GVCFGENOTYPER_HEADERCACHE_HH
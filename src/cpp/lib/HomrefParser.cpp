@@ -0,0 +1,206 @@
+#include "HomrefParser.hh"
+
+#include <cstring>
+#include <cstdlib>
+
+//a FORMAT or INFO field of the header with the given type
+static bool has_field(const bcf_hdr_t *hdr, int hl_type, const char *key, int type)
+{
+    int id = bcf_hdr_id2int(hdr, BCF_DT_ID, key);
+    return (bcf_hdr_idinfo_exists(hdr, hl_type, id) && (int) bcf_hdr_id2type(hdr, hl_type, id) == type);
+}
+
+static bool is_key(const char *key, size_t length, const char *name)
+{
+    return (strlen(name) == length && memcmp(key, name, length) == 0);
+}
+
+//value [p, end) as vcf_parse1 would store it: a plain integer or "." for missing
+static bool parse_int(const char *p, const char *end, int32_t &value)
+{
+    if (end - p == 1 && *p == '.')
+    {
+        value = bcf_int32_missing;
+        return (true);
+    }
+    bool negative = p < end && *p == '-';
+    if (negative)
+        p++;
+    //a few digits, so that the value cannot overflow
+    if (p == end || end - p > 9)
+        return (false);
+    int64_t ret = 0;
+    for (; p < end; p++)
+    {
+        if (*p < '0' || *p > '9')
+            return (false);
+        ret = ret * 10 + (*p - '0');
+    }
+    value = (int32_t) (negative ? -ret : ret);
+    return (true);
+}
+
+static bool parse_float(const char *p, const char *end, float &value)
+{
+    if (end - p == 1 && *p == '.')
+    {
+        bcf_float_set_missing(value);
+        return (true);
+    }
+    if (p == end || end - p > 32)
+        return (false);
+    char text[33];
+    for (const char *q = p; q < end; q++)
+        if (!strchr("0123456789.+-eE", *q))
+            return (false);
+    memcpy(text, p, end - p);
+    text[end - p] = '\0';
+    char *parsed;
+    value = (float) strtod(text, &parsed);
+    return (parsed == text + (end - p));
+}
+
+HomrefParser::HomrefParser(const bcf_hdr_t *hdr)
+{
+    _header = hdr;
+    _rid = -1;
+    _has_gqx = has_field(hdr, BCF_HL_FMT, "GQX", BCF_HT_INT);
+    _has_dpf = has_field(hdr, BCF_HL_FMT, "DPF", BCF_HT_INT);
+    _gq_type = has_field(hdr, BCF_HL_FMT, "GQ", BCF_HT_INT) ? BCF_HT_INT :
+               has_field(hdr, BCF_HL_FMT, "GQ", BCF_HT_REAL) ? BCF_HT_REAL : -1;
+    int gq_id = bcf_hdr_id2int(hdr, BCF_DT_ID, "GQ");
+    //a GQ of any other type is read by vcf_parse1
+    bool gq_ok = _gq_type != -1 || !bcf_hdr_idinfo_exists(hdr, BCF_HL_FMT, gq_id);
+    _enabled = bcf_hdr_nsamples(hdr) == 1 && gq_ok &&
+               has_field(hdr, BCF_HL_INFO, "END", BCF_HT_INT) &&
+               has_field(hdr, BCF_HL_FMT, "GT", BCF_HT_STR) &&
+               has_field(hdr, BCF_HL_FMT, "DP", BCF_HT_INT);
+}
+
+bool HomrefParser::Parse(const kstring_t &line, DepthBlock &block)
+{
+    if (!_enabled)
+        return (false);
+    //the ten columns, CHROM to the sample
+    const char *column[10], *column_end[10];
+    const char *p = line.s, *line_end = line.s + line.l;
+    for (int c = 0; c < 10; c++)
+    {
+        if (p > line_end)
+            return (false);
+        const char *tab = (const char *) memchr(p, '\t', line_end - p);
+        column[c] = p;
+        column_end[c] = tab != nullptr ? tab : line_end;
+        if (c < 9 && tab == nullptr)
+            return (false);
+        p = column_end[c] + 1;
+    }
+    if (column_end[9] != line_end)//more than one sample
+        return (false);
+    //ALT
+    if (column_end[4] - column[4] != 1 || column[4][0] != '.')
+        return (false);
+
+    //INFO/END, a site outside a block ends with its REF
+    int32_t end = bcf_int32_missing;
+    for (const char *key = column[7]; key < column_end[7];)
+    {
+        const char *field_end = (const char *) memchr(key, ';', column_end[7] - key);
+        if (field_end == nullptr)
+            field_end = column_end[7];
+        if (field_end - key > 4 && memcmp(key, "END=", 4) == 0 && !parse_int(key + 4, field_end, end))
+            return (false);
+        key = field_end + 1;
+    }
+    int32_t pos;
+    if (!parse_int(column[1], column_end[1], pos) || pos < 1 || column_end[3] == column[3])
+        return (false);
+    if (end == bcf_int32_missing)
+        end = pos + (int32_t) (column_end[3] - column[3]) - 1;
+    if (end < pos)
+        return (false);
+
+    //FORMAT keys and sample values side by side, values missing from the end of the sample are "."
+    int32_t dp = bcf_int32_missing, dpf = bcf_int32_missing, gq = bcf_int32_missing;
+    int ploidy = -1;
+    bool has_dp = false, has_gq = false, has_gqx = false;
+    int32_t gqx = bcf_int32_missing;
+    float gq_float;
+    static const char *missing = ".";
+    const char *key = column[8], *value = column[9];
+    bool values_left = true;
+    while (key < column_end[8])
+    {
+        const char *key_end = (const char *) memchr(key, ':', column_end[8] - key);
+        if (key_end == nullptr)
+            key_end = column_end[8];
+        const char *value_end;
+        if (values_left)
+        {
+            value_end = (const char *) memchr(value, ':', column_end[9] - value);
+            if (value_end == nullptr)
+                value_end = column_end[9];
+        }
+        else
+        {
+            value = missing;
+            value_end = missing + 1;
+        }
+        size_t length = key_end - key;
+        bool ok = true;
+        if (is_key(key, length, "GT"))
+        {
+            if (value == value_end)
+                return (false);
+            ploidy = 1;
+            for (const char *q = value; q < value_end; q++)
+                ploidy += *q == '/' || *q == '|';
+        }
+        else if (is_key(key, length, "DP"))
+        {
+            has_dp = true;
+            ok = parse_int(value, value_end, dp);
+        }
+        else if (is_key(key, length, "GQ"))
+        {
+            has_gq = true;
+            if (_gq_type == BCF_HT_INT)
+                ok = parse_int(value, value_end, gq);
+            else if (_gq_type == BCF_HT_REAL && (ok = parse_float(value, value_end, gq_float)))
+                gq = bcf_float_is_missing(gq_float) ? 0 : (int32_t) gq_float;
+            else
+                ok = false;
+        }
+        else if (is_key(key, length, "GQX"))
+        {
+            has_gqx = true;
+            ok = _has_gqx && parse_int(value, value_end, gqx);
+        }
+        else if (is_key(key, length, "DPF"))
+            ok = _has_dpf && parse_int(value, value_end, dpf);
+        if (!ok)
+            return (false);
+        key = key_end + 1;
+        if (values_left)
+        {
+            values_left = value_end < column_end[9];
+            value = value_end + 1;
+        }
+    }
+    //records without DP do not give a block and ones without GQ or GQX are an error, vcf_parse1 handles both
+    if (ploidy < 0 || !has_dp || (!has_gq && !has_gqx))
+        return (false);
+    if (!has_gq)
+        gq = gqx;
+
+    size_t contig_length = column_end[0] - column[0];
+    if (contig_length != _contig.size() || memcmp(column[0], _contig.data(), contig_length) != 0)
+    {
+        _contig.assign(column[0], contig_length);
+        _rid = bcf_hdr_name2id(_header, _contig.c_str());
+    }
+    if (_rid < 0)//vcf_parse1 warns about contigs missing from the header
+        return (false);
+    block = DepthBlock(_rid, pos - 1, end - 1, dp, dpf, gq == bcf_int32_missing ? 0 : gq, ploidy);
+    return (true);
+}
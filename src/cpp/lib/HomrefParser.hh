@@ -0,0 +1,42 @@
+//
+// Reads strelka homref block lines straight from the VCF text into a DepthBlock.
+//
+
+#ifndef GVCFGENOTYPER_HOMREFPARSER_HH
+#define GVCFGENOTYPER_HOMREFPARSER_HH
+
+#include <string>
+
+extern "C" {
+#include <htslib/vcf.h>
+#include <htslib/kstring.h>
+}
+
+#include "DepthBlock.hh"
+
+//Most lines of a GVCF are homref blocks, and of these GVCFReader only keeps the contig, start, INFO/END,
+//FORMAT/DP, DPF, GQ (or GQX) and the ploidy of GT. Parsing such a line with vcf_parse1 and then taking each
+//value out of the bcf1_t costs several times more than scanning the text for them. A line is recognised if
+//ALT is "." and it has FORMAT/GT and DP, with each value of interest a single number or missing. Without
+//INFO/END the block ends with REF, as for the single homref sites strelka writes. The values are then
+//exactly those the parsed record would give. Anything else, eg. a variant, a block without DP or a field
+//the header does not define, is left to vcf_parse1. Only the contig lookup
+//touches the header, so a parser may be used with a header that is shared between threads.
+class HomrefParser
+{
+public:
+    //hdr must have one sample and define the fields with the types strelka uses, otherwise no line is recognised
+    explicit HomrefParser(const bcf_hdr_t *hdr);
+    //true if line is a homref block, which is then in block. The line is not changed.
+    bool Parse(const kstring_t &line, DepthBlock &block);
+
+private:
+    const bcf_hdr_t *_header;
+    bool _enabled;
+    int _gq_type;//BCF_HT_INT or BCF_HT_REAL, -1 if the header has no FORMAT/GQ
+    bool _has_gqx, _has_dpf;
+    std::string _contig;//last contig looked up
+    int _rid;
+};
+
+#endif //GVCFGENOTYPER_HOMREFPARSER_HH
@@ -0,0 +1,387 @@
+#include "IndexedReader.hh"
+#include "ggutils.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+extern "C" {
+#include <htslib/hfile.h>
+}
+
+IndexedReader::IndexedReader(const std::string &filename, const std::string &region /*=""*/, const int is_file /*=0*/,
+                             HeaderCache *header_cache /*=nullptr*/, FilePool *file_pool /*=nullptr*/)
+{
+    Init(filename);
+    _owns_header = header_cache == nullptr;
+
+    if (!Open())
+        ggutils::die("problem opening " + filename);
+    const htsFormat *format = hts_get_format(_fp);
+    if (format->format != vcf && format->format != bcf)
+        ggutils::die(filename + " is not a VCF or BCF file");
+    _bgzf = format->compression == bgzf;
+    _vcf = format->format == vcf;
+    if (format->compression == bgzf && bgzf_check_EOF(hts_get_bgzfp(_fp)) == 0)
+        hts_log_warning("No BGZF EOF marker; file '%s' may be truncated", filename.c_str());
+    _header = bcf_hdr_read(_fp);
+    if (_header == nullptr)
+        ggutils::die("problem reading the header of " + filename);
+    for (int i = 0; i < bcf_hdr_nsamples(_header); i++)
+        _sample_names.push_back(_header->samples[i]);
+    if (header_cache != nullptr)
+        _header = header_cache->Intern(_header, &_parse_mutex);
+
+    if (!region.empty())
+    {
+        if (format->compression != bgzf)
+            ggutils::die(filename + " must be bgzipped and indexed to read a region");
+        if (format->format == vcf)
+            _tbx = tbx_index_load(filename.c_str());
+        else
+            _idx = bcf_index_load(filename.c_str());
+        if (_tbx == nullptr && _idx == nullptr)
+            ggutils::die("could not load the index of " + filename);
+        OpenRegions(region, is_file);
+    }
+
+    //only BGZF can be reopened at a virtual offset
+    if (file_pool != nullptr && _bgzf)
+    {
+        _pool = file_pool;
+        _last_use = _pool->Tick();
+        _pool->Opened(this, false);
+    }
+}
+
+IndexedReader::IndexedReader(const Manifest &manifest, size_t i, const std::string &region /*=""*/,
+                             const int is_file /*=0*/, FilePool *file_pool /*=nullptr*/,
+                             HeaderCache *header_cache /*=nullptr*/)
+{
+    Init(manifest.GetInput(i).filename);
+    _manifest_input = &manifest.GetInput(i);
+    _bin_size = manifest.GetBinSize();
+    _owns_header = false;
+    if (header_cache != nullptr)
+        _header = header_cache->Copy(manifest.GetHeader(_manifest_input->layout), &_parse_mutex);
+    else
+    {
+        _header = manifest.GetHeader(_manifest_input->layout);
+        _parse_mutex = manifest.GetParseMutex(_manifest_input->layout);
+    }
+    _bgzf = true;
+    _vcf = _manifest_input->vcf;
+    if (!_manifest_input->sample.empty())
+        _sample_names.push_back(_manifest_input->sample);
+
+    if (!Open())
+        ggutils::die("problem opening " + _filename);
+    if (region.empty())
+        Seek(_manifest_input->first_record);
+    else
+        OpenRegions(region, is_file);
+
+    if (file_pool != nullptr)
+    {
+        _pool = file_pool;
+        _last_use = _pool->Tick();
+        _pool->Opened(this, false);
+    }
+}
+
+void IndexedReader::Init(const std::string &filename)
+{
+    _filename = filename;
+    _fp = nullptr;
+    _fd = -1;
+    _header = nullptr;
+    _owns_header = true;
+    _parse_mutex = nullptr;
+    _tbx = nullptr;
+    _idx = nullptr;
+    _itr = nullptr;
+    _regions = nullptr;
+    _manifest_input = nullptr;
+    _bin_size = 0;
+    _region_rid = -1;
+    _region_start = _region_end = 0;
+    _line = {0, 0, nullptr};
+    _eof = false;
+    _pool = nullptr;
+    _last_use = 0;
+    _offset = 0;
+    _homref_parser = nullptr;
+    _homref_block = nullptr;
+    _is_homref = false;
+    _read_ahead = nullptr;
+    _read_ahead_id = -1;
+    _read_ahead_next = 0;
+}
+
+bool IndexedReader::Open()
+{
+    _fd = -1;
+    //as hts_open, which does not give the descriptor of a local file
+    if (_filename == "-" || _filename.find("://") != std::string::npos)
+    {
+        _fp = hts_open(_filename.c_str(), "r");
+        return (_fp != nullptr);
+    }
+    int fd = open(_filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return (false);
+    hFILE *hfile = hdopen(fd, "r");
+    if (hfile == nullptr)
+    {
+        close(fd);
+        return (false);
+    }
+    _fp = hts_hopen(hfile, _filename.c_str(), "r");
+    if (_fp == nullptr)
+    {
+        hclose_abruptly(hfile);
+        return (false);
+    }
+    _fd = fd;
+    return (true);
+}
+
+void IndexedReader::OpenRegions(const std::string &region, const int is_file)
+{
+    _regions = bcf_sr_regions_init(region.c_str(), is_file, 0, 1, -2);
+    if (_regions == nullptr)
+        ggutils::die("Cannot navigate to region " + region);
+}
+
+IndexedReader::~IndexedReader()
+{
+    Close();
+    hts_itr_destroy(_itr);
+    if (_regions != nullptr)
+        bcf_sr_regions_destroy(_regions);
+    if (_tbx != nullptr)
+        tbx_destroy(_tbx);
+    if (_idx != nullptr)
+        hts_idx_destroy(_idx);
+    if (_owns_header)
+        bcf_hdr_destroy(_header);
+    free(_line.s);
+}
+
+void IndexedReader::Close()
+{
+    if (_pool != nullptr)
+        _pool->Closed(this);
+    if (_fp != nullptr && _read_ahead != nullptr)
+        _read_ahead->Release(_read_ahead_id);
+    if (_fp != nullptr)
+        hts_close(_fp);
+    _fp = nullptr;
+    _fd = -1;
+}
+
+void IndexedReader::Park()
+{
+    if (_pool == nullptr || _fp == nullptr)
+        return;
+    _pool->Closed(this);
+    Release();
+}
+
+void IndexedReader::Release()
+{
+    _offset = bgzf_tell(hts_get_bgzfp(_fp));
+    if (_read_ahead != nullptr)
+        _read_ahead->Release(_read_ahead_id);
+    hts_close(_fp);
+    _fp = nullptr;
+    _fd = -1;
+}
+
+bool IndexedReader::SetReadAhead(ReadAhead *read_ahead)
+{
+    //a released file has no descriptor yet but is local if it had one
+    if (!_bgzf || _filename == "-" || _filename.find("://") != std::string::npos)
+        return (false);
+    _read_ahead_id = read_ahead->AddFile(_filename);
+    if (_read_ahead_id < 0)
+        return (false);
+    _read_ahead = read_ahead;
+    _read_ahead_next = 0;
+    return (true);
+}
+
+void IndexedReader::AdvanceReadAhead()
+{
+    if (_read_ahead == nullptr || _fp == nullptr)
+        return;
+    //the upper bits of a BGZF virtual offset are the compressed offset
+    uint64_t offset = bgzf_tell(hts_get_bgzfp(_fp)) >> 16;
+    if (offset >= _read_ahead_next)
+        _read_ahead_next = _read_ahead->Advance(_read_ahead_id, _fd, offset);
+}
+
+void IndexedReader::Reopen()
+{
+    if (!Open())
+        ggutils::die("problem reopening " + _filename);
+    Seek(_offset);
+    _pool->Opened(this, true);
+}
+
+void IndexedReader::Seek(uint64_t offset)
+{
+    if (bgzf_seek(hts_get_bgzfp(_fp), offset, SEEK_SET) < 0)
+        ggutils::die("problem seeking in " + _filename);
+}
+
+bool IndexedReader::NextRegion()
+{
+    hts_itr_destroy(_itr);
+    _itr = nullptr;
+    while (bcf_sr_regions_next(_regions) == 0)
+    {
+        const char *seq = _regions->seq_names[_regions->iseq];
+        if (_manifest_input != nullptr)
+        {
+            auto bins = _manifest_input->bins.find(bcf_hdr_name2id(_header, seq));
+            if (bins == _manifest_input->bins.end())
+                continue;
+            uint64_t offset = bins->second[std::min(bins->second.size() - 1, (size_t) (_regions->start / _bin_size))];
+            if (offset == UINT64_MAX)//nothing from here to the end of the contig
+                continue;
+            Seek(offset);
+            _region_rid = bins->first;
+            _region_start = _regions->start;
+            _region_end = _regions->end;
+            return (true);
+        }
+        //contigs missing from this file have no records
+        int tid = _tbx != nullptr ? tbx_name2id(_tbx, seq) : bcf_hdr_name2id(_header, seq);
+        if (tid < 0)
+            continue;
+        _itr = _tbx != nullptr ? tbx_itr_queryi(_tbx, tid, _regions->start, _regions->end + 1)
+                               : bcf_itr_queryi(_idx, tid, _regions->start, _regions->end + 1);
+        if (_itr == nullptr)
+            ggutils::die("could not seek to " + std::string(seq) + " in " + _filename);
+        return (true);
+    }
+    return (false);
+}
+
+//vcf_parse1 uses the header's scratch buffer, so readers sharing a header parse one at a time
+void IndexedReader::Parse(bcf1_t *record)
+{
+    _is_homref = _homref_parser != nullptr && _homref_parser->Parse(_line, *_homref_block);
+    if (_is_homref)
+        return;
+    int ret;
+    if (_parse_mutex != nullptr)
+    {
+        std::lock_guard<std::mutex> lock(*_parse_mutex);
+        ret = vcf_parse1(&_line, _header, record);
+    }
+    else
+        ret = vcf_parse1(&_line, _header, record);
+    if (ret < 0)
+        ggutils::die("problem parsing a record of " + _filename);
+}
+
+int IndexedReader::Read(bcf1_t *record)
+{
+    _is_homref = false;
+    if (!_vcf)
+        return (bcf_read(_fp, _header, record));
+    int ret = hts_getline(_fp, KS_SEP_LINE, &_line);
+    if (ret >= 0)
+        Parse(record);
+    return (ret);
+}
+
+bool IndexedReader::Next(bcf1_t *record)
+{
+    return (Next(record, nullptr, nullptr) == 1);
+}
+
+int IndexedReader::Next(bcf1_t *record, HomrefParser *homref_parser, DepthBlock *block)
+{
+    _homref_parser = homref_parser;
+    _homref_block = block;
+    if (_eof)
+        return (0);
+    if (_pool != nullptr)
+    {
+        _last_use = _pool->Tick();
+        if (_fp == nullptr)
+            Reopen();
+    }
+    if (_regions == nullptr)
+    {
+        int ret = Read(record);
+        if (ret < -1)
+            ggutils::die("problem reading " + _filename);
+        if (ret < 0)
+        {
+            _eof = true;
+            if (_pool != nullptr)
+                Close();
+            return (0);
+        }
+        if (_is_homref)
+            return (2);
+        bcf_unpack(record, BCF_UN_STR);
+        return (1);
+    }
+
+    while (_itr != nullptr || _region_rid >= 0 || NextRegion())
+    {
+        int ret;
+        if (_region_rid >= 0)
+        {
+            //the same overlap test as the index iterators, records are sorted so the first one past the end stops
+            ret = Read(record);
+            int rid = _is_homref ? block->rid() : record->rid;
+            int64_t pos = _is_homref ? block->start() : record->pos;
+            int64_t end = _is_homref ? block->end() + 1 : record->pos + record->rlen;
+            if (ret >= 0 && (rid != _region_rid || pos > _region_end))
+                ret = -1;
+            else if (ret >= 0 && end <= _region_start)
+                continue;
+        }
+        else if (_tbx != nullptr)
+        {
+            _is_homref = false;
+            ret = tbx_itr_next(_fp, _tbx, _itr, &_line);
+            if (ret >= 0)
+                Parse(record);
+        }
+        else
+        {
+            _is_homref = false;
+            ret = bcf_itr_next(_fp, _itr, record);
+            if (ret >= 0)
+                bcf_subset_format(_header, record);
+        }
+        if (ret < -1)
+            ggutils::die("problem reading " + _filename);
+        if (ret >= 0)
+        {
+            if (_is_homref)
+                return (2);
+            bcf_unpack(record, BCF_UN_STR);
+            return (1);
+        }
+        //done with this region
+        hts_itr_destroy(_itr);
+        _itr = nullptr;
+        _region_rid = -1;
+    }
+    _eof = true;
+    if (_pool != nullptr)
+        Close();
+    return (0);
+}
+
+size_t IndexedReader::GetMemoryUsage()
+{
+    return ((_owns_header ? ggutils::bcf_hdr_memory_usage(_header) : 0) + _line.m);
+}
@@ -0,0 +1,114 @@
+//
+// Reads the records of a single VCF/BCF, optionally restricted to regions through its index.
+//
+
+#ifndef GVCFGENOTYPER_INDEXEDREADER_HH
+#define GVCFGENOTYPER_INDEXEDREADER_HH
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+extern "C" {
+#include <htslib/hts.h>
+#include <htslib/vcf.h>
+#include <htslib/tbx.h>
+#include <htslib/kseq.h>
+#include <htslib/synced_bcf_reader.h>
+}
+
+#include "HeaderCache.hh"
+#include "FilePool.hh"
+#include "Manifest.hh"
+#include "HomrefParser.hh"
+#include "ReadAhead.hh"
+
+//A one-file replacement for bcf_srs_t. The synced reader keeps a sorting buffer of records per file
+//and pairs lines across readers, none of which is needed when every sample has its own reader.
+//Here records are parsed straight into the caller's bcf1_t. Without regions the file is streamed,
+//otherwise each region is queried from the .tbi/.csi index in turn, returning the records that
+//overlap it exactly as bcf_sr_set_regions() would (a record spanning two regions is read twice).
+class IndexedReader
+{
+public:
+    //region is a comma separated list of chr[:start[-end]] or a regions file when is_file is set,
+    //with a header_cache the header is shared with the other readers of files with the same layout,
+    //with a file_pool a bgzipped input may be closed while idle and is reopened at the same offset
+    IndexedReader(const std::string &filename, const std::string &region = "", const int is_file = 0,
+                  HeaderCache *header_cache = nullptr, FilePool *file_pool = nullptr);
+    //reads input i of a manifest with its layout's header, seeking to the offsets it stores instead of reading
+    //the header and index. Records of a region are read from the bin it starts in until past its end.
+    //With a header_cache the header is the cache's copy of the layout, else the manifest's own.
+    IndexedReader(const Manifest &manifest, size_t i, const std::string &region = "", const int is_file = 0,
+                  FilePool *file_pool = nullptr, HeaderCache *header_cache = nullptr);
+    ~IndexedReader();
+
+    //reads the next record into record, returns false at the end of the last region
+    bool Next(bcf1_t *record);
+    //as Next(record), but VCF lines that homref_parser recognises are read into block without parsing them.
+    //Returns 2 for such a line, 1 for a record and 0 at the end.
+    int Next(bcf1_t *record, HomrefParser *homref_parser, DepthBlock *block);
+    bool Eof() {return (_eof);};
+    bcf_hdr_t *GetHeader() {return (_header);};
+    //nullptr while the file is released to the pool or after the end of a pooled file
+    htsFile *GetFile() {return (_fp);};
+    bool IsBgzf() {return (_bgzf);};
+    //sample names of this file, which a shared header may not have
+    const std::vector<std::string> &GetSampleNames() {return (_sample_names);};
+    //bytes held by the header unless it is shared, the index is not counted
+    size_t GetMemoryUsage();
+
+    //closes a pooled file until the next record is needed, eg. once its reader has filled its buffer
+    void Park();
+    //used by FilePool: closes the file, keeping the offset to reopen it at
+    void Release();
+    //prefetches a bgzipped local file with read_ahead, false if it cannot be
+    bool SetReadAhead(ReadAhead *read_ahead);
+    //reports the offset reached to the read_ahead, if any
+    void AdvanceReadAhead();
+    uint64_t GetLastUse() {return (_last_use.load(std::memory_order_relaxed));};
+
+private:
+    //queries the index for the next region that is on a contig of this file, false if there is none left
+    bool NextRegion();
+    void Init(const std::string &filename);
+    //opens _filename into _fp, with a descriptor of our own for local files, false on failure
+    bool Open();
+    void OpenRegions(const std::string &region, const int is_file);
+    void Reopen();
+    void Seek(uint64_t offset);
+    //reads the record at the current offset, returns as bcf_read()
+    int Read(bcf1_t *record);
+    void Parse(bcf1_t *record);//parses _line, into _homref_block if _homref_parser recognises it
+    void Close();
+
+    std::string _filename;
+    htsFile *_fp;
+    int _fd;//descriptor of _fp for a local file, else -1
+    bool _bgzf, _vcf;
+    FilePool *_pool;//nullptr unless the file can be released
+    std::atomic<uint64_t> _last_use;
+    int64_t _offset;//BGZF virtual offset of a released file
+    bcf_hdr_t *_header;
+    bool _owns_header;
+    std::mutex *_parse_mutex;//of a shared header
+    std::vector<std::string> _sample_names;
+    tbx_t *_tbx;//.tbi/.csi of a bgzipped VCF
+    hts_idx_t *_idx;//.csi of a BCF
+    hts_itr_t *_itr;//iterator over the current region
+    bcf_sr_regions_t *_regions;
+    const Manifest::input_t *_manifest_input;
+    int _bin_size;
+    int _region_rid, _region_start, _region_end;//region being read from a manifest offset, _region_rid -1 if none
+    kstring_t _line;
+    bool _eof;
+    HomrefParser *_homref_parser;//of the current Next() call
+    DepthBlock *_homref_block;
+    bool _is_homref;//the last line read went to _homref_block
+    ReadAhead *_read_ahead;
+    int _read_ahead_id;
+    uint64_t _read_ahead_next;//compressed offset at which to report to _read_ahead again
+};
+
+#endif //GVCFGENOTYPER_INDEXEDREADER_HH
@@ -0,0 +1,71 @@
+#include "LogThrottle.hh"
+
+#include <mutex>
+#include <map>
+#include <set>
+
+namespace
+{
+    std::mutex throttle_mutex;
+    std::map<std::string, size_t> warning_counts;
+    size_t max_repeats = 20;
+    std::set<std::string> logged_once;
+}
+
+bool LogThrottle::Allow(const std::string &key)
+{
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(throttle_mutex);
+        count = ++warning_counts[key];
+    }
+    if (count == max_repeats + 1)
+    {
+        auto lg = spdlog::get("gg_logger");
+        if (lg != nullptr)
+            lg->warn("{} warnings like \"{}\", further ones are not logged", max_repeats, key);
+    }
+    return (count <= max_repeats);
+}
+
+bool LogThrottle::AllowOnce(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    return (logged_once.insert(key).second);
+}
+
+void LogThrottle::SetMaxRepeats(size_t num)
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    max_repeats = num;
+}
+
+size_t LogThrottle::GetMaxRepeats()
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    return (max_repeats);
+}
+
+size_t LogThrottle::GetCount(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    auto it = warning_counts.find(key);
+    return (it == warning_counts.end() ? 0 : it->second);
+}
+
+void LogThrottle::LogSuppressed(std::shared_ptr<spdlog::logger> lg)
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    for (auto &w : warning_counts)
+    {
+        if (w.second > max_repeats)
+            lg->warn("{} warnings like \"{}\" were not logged ({} in total)", w.second - max_repeats, w.first, w.second);
+    }
+}
+
+void LogThrottle::Reset()
+{
+    std::lock_guard<std::mutex> lock(throttle_mutex);
+    warning_counts.clear();
+    logged_once.clear();
+}
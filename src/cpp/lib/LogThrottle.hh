@@ -0,0 +1,47 @@
+//
+// Caps how often a repeated warning is written to the log.
+//
+
+#ifndef GVCFGENOTYPER_LOGTHROTTLE_HH
+#define GVCFGENOTYPER_LOGTHROTTLE_HH
+
+#include <string>
+#include <memory>
+
+#include "spdlog.h"
+
+//Warnings are keyed on their format string. The first GetMaxRepeats() of each key are logged, the
+//next one is replaced by a note that further ones are suppressed and the rest are only counted,
+//so a noisy input cannot flood the log. Check Allow() before formatting expensive arguments.
+//Warnings about an input as a whole go through WarnOnce() instead, which logs each of them once per
+//input (not once per reader of it, eg. with -@) and never suppresses them in favour of other inputs.
+class LogThrottle
+{
+public:
+    static bool Allow(const std::string &key);
+    //true the first time key is seen
+    static bool AllowOnce(const std::string &key);
+    static void SetMaxRepeats(size_t max_repeats);
+    static size_t GetMaxRepeats();
+    //total number of warnings with this key, logged or not
+    static size_t GetCount(const std::string &key);
+    //one line per key that hit the limit with the number of suppressed warnings
+    static void LogSuppressed(std::shared_ptr<spdlog::logger> lg);
+    static void Reset();
+
+    template<typename... Args>
+    static void Warn(const std::shared_ptr<spdlog::logger> &lg, const char *fmt, const Args &... args)
+    {
+        if (Allow(fmt))
+            lg->warn(fmt, args...);
+    }
+
+    template<typename... Args>
+    static void WarnOnce(const std::shared_ptr<spdlog::logger> &lg, const std::string &filename, const char *fmt, const Args &... args)
+    {
+        if (AllowOnce(fmt + ("\t" + filename)))
+            lg->warn(fmt, args...);
+    }
+};
+
+#endif //GVCFGENOTYPER_LOGTHROTTLE_HH
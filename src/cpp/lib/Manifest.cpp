@@ -0,0 +1,307 @@
+#include "Manifest.hh"
+#include "ggutils.hh"
+
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <sys/stat.h>
+
+extern "C" {
+#include <htslib/bgzf.h>
+#include <htslib/tbx.h>
+#include <htslib/synced_bcf_reader.h>
+}
+
+static const char MANIFEST_MAGIC[4] = {'G', 'G', 'M', 'F'};
+static const uint32_t MANIFEST_VERSION = 1;
+
+static void stat_file(const std::string &filename, int64_t &size, int64_t &mtime)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+    {
+        size = mtime = -1;
+        return;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+}
+
+//fixed-width little-endian fields, as in BCF
+static void write_bytes(BGZF *fp, const void *data, size_t length)
+{
+    if (bgzf_write(fp, data, length) != (ssize_t) length)
+        ggutils::die("problem writing the manifest");
+}
+
+template<class T>
+static void write_value(BGZF *fp, T value)
+{
+    write_bytes(fp, &value, sizeof(T));
+}
+
+static void write_string(BGZF *fp, const std::string &s)
+{
+    write_value<uint32_t>(fp, s.size());
+    write_bytes(fp, s.data(), s.size());
+}
+
+static void read_bytes(BGZF *fp, void *data, size_t length)
+{
+    if (bgzf_read(fp, data, length) != (ssize_t) length)
+        ggutils::die("truncated manifest");
+}
+
+template<class T>
+static T read_value(BGZF *fp)
+{
+    T value;
+    read_bytes(fp, &value, sizeof(T));
+    return (value);
+}
+
+static std::string read_string(BGZF *fp)
+{
+    std::string s(read_value<uint32_t>(fp), '\0');
+    if (!s.empty())
+        read_bytes(fp, &s[0], s.size());
+    return (s);
+}
+
+Manifest::Manifest()
+{
+    _bin_size = 0;
+}
+
+Manifest::~Manifest()
+{
+    for (auto hdr : _headers)
+        bcf_hdr_destroy(hdr);
+}
+
+Manifest::input_t Manifest::Scan(const std::string &filename, int bin_size, bcf_hdr_t **header)
+{
+    input_t input;
+    input.filename = filename;
+    stat_file(filename, input.size, input.mtime);
+    htsFile *fp = hts_open(filename.c_str(), "r");
+    if (fp == nullptr)
+        ggutils::die("problem opening " + filename);
+    const htsFormat *format = hts_get_format(fp);
+    if (format->format != vcf && format->format != bcf)
+        ggutils::die(filename + " is not a VCF or BCF file");
+    if (format->compression != bgzf)
+        ggutils::die(filename + " must be bgzipped to be added to a manifest");
+    input.vcf = format->format == vcf;
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    if (hdr == nullptr)
+        ggutils::die("problem reading the header of " + filename);
+    input.first_record = bgzf_tell(hts_get_bgzfp(fp));
+    if (bcf_hdr_nsamples(hdr) > 0)
+        input.sample = hdr->samples[0];
+    input.layout = 0;
+
+    tbx_t *tbx = input.vcf ? tbx_index_load(filename.c_str()) : nullptr;
+    hts_idx_t *idx = input.vcf ? nullptr : bcf_index_load(filename.c_str());
+    if (tbx == nullptr && idx == nullptr)
+        ggutils::die("could not load the index of " + filename);
+    for (int rid = 0; rid < hdr->n[BCF_DT_CTG]; rid++)
+    {
+        const char *name = bcf_hdr_id2name(hdr, rid);
+        int tid = tbx != nullptr ? tbx_name2id(tbx, name) : rid;
+        if (tid < 0)
+            continue;
+        //contigs without a length in the header get one bin, read from the start of the contig
+        int64_t length = hdr->id[BCF_DT_CTG][rid].val->info[0];
+        int num_bins = length > 0 ? (int) ((length - 1) / bin_size + 1) : 1;
+        std::vector<uint64_t> offsets(num_bins);
+        //records overlapping bin b or later start at or after the smaller of the first chunk overlapping bin b
+        //and the offset of bin b+1
+        uint64_t next = UINT64_MAX;
+        for (int b = num_bins - 1; b >= 0; b--)
+        {
+            int beg = (int) std::min<int64_t>((int64_t) b * bin_size, INT_MAX - 1);
+            int end = b == num_bins - 1 ? INT_MAX : (int) std::min<int64_t>((int64_t) (b + 1) * bin_size, INT_MAX);
+            hts_itr_t *itr = tbx != nullptr ? tbx_itr_queryi(tbx, tid, beg, end) : bcf_itr_queryi(idx, tid, beg, end);
+            if (itr != nullptr && itr->n_off > 0)
+                next = std::min(next, (uint64_t) itr->off[0].u);
+            hts_itr_destroy(itr);
+            offsets[b] = next;
+        }
+        if (next != UINT64_MAX)
+            input.bins[rid].swap(offsets);
+    }
+    if (tbx != nullptr)
+        tbx_destroy(tbx);
+    if (idx != nullptr)
+        hts_idx_destroy(idx);
+    hts_close(fp);
+    *header = hdr;
+    return (input);
+}
+
+void Manifest::Build(const std::vector<std::string> &filenames, int bin_size, int num_threads)
+{
+    if (bin_size < 1)
+        ggutils::die("the manifest bin size must be positive");
+    _bin_size = bin_size;
+    _inputs.resize(filenames.size());
+    std::vector<bcf_hdr_t *> headers(filenames.size(), nullptr);
+    std::atomic<size_t> next(0);
+    auto scan = [&]()
+    {
+        for (size_t i = next++; i < filenames.size(); i = next++)
+            _inputs[i] = Scan(filenames[i], bin_size, &headers[i]);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads && (size_t) t < filenames.size(); t++)
+        threads.emplace_back(scan);
+    scan();
+    for (auto &t : threads)
+        t.join();
+
+    //layouts are numbered in input order so that the manifest does not depend on num_threads
+    std::map<std::string, uint32_t> layouts;
+    for (size_t i = 0; i < _inputs.size(); i++)
+    {
+        auto inserted = layouts.emplace(HeaderCache::Layout(headers[i]), _headers.size());
+        if (inserted.second)
+            _headers.push_back(headers[i]);
+        else
+            bcf_hdr_destroy(headers[i]);
+        _inputs[i].layout = inserted.first->second;
+        _index.emplace(_inputs[i].filename, i);
+    }
+    for (size_t l = 0; l < _headers.size(); l++)
+        _parse_mutexes.emplace_back(new std::mutex);
+}
+
+void Manifest::Write(const std::string &filename)
+{
+    BGZF *fp = bgzf_open(filename.c_str(), "w");
+    if (fp == nullptr)
+        ggutils::die("problem opening " + filename);
+    write_bytes(fp, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    write_value<uint32_t>(fp, MANIFEST_VERSION);
+    write_value<int32_t>(fp, _bin_size);
+    write_value<uint32_t>(fp, _headers.size());
+    kstring_t text = {0, 0, nullptr};
+    for (auto hdr : _headers)
+    {
+        //with IDX= so that BCF dictionary ids are kept
+        text.l = 0;
+        if (bcf_hdr_format(hdr, 1, &text) < 0)
+            ggutils::die("problem formatting a header for the manifest");
+        write_string(fp, std::string(text.s, text.l));
+    }
+    free(text.s);
+    write_value<uint64_t>(fp, _inputs.size());
+    for (auto &input : _inputs)
+    {
+        write_string(fp, input.filename);
+        write_value<int64_t>(fp, input.size);
+        write_value<int64_t>(fp, input.mtime);
+        write_string(fp, input.sample);
+        write_value<uint32_t>(fp, input.layout);
+        write_value<uint8_t>(fp, input.vcf);
+        write_value<uint64_t>(fp, input.first_record);
+        write_value<uint32_t>(fp, input.bins.size());
+        for (auto &contig : input.bins)
+        {
+            write_value<int32_t>(fp, contig.first);
+            write_value<uint32_t>(fp, contig.second.size());
+            write_bytes(fp, contig.second.data(), contig.second.size() * sizeof(uint64_t));
+        }
+    }
+    if (bgzf_close(fp) != 0)
+        ggutils::die("problem writing " + filename);
+}
+
+void Manifest::Read(const std::string &filename, const std::string &region /*=""*/, int is_file /*=0*/,
+                    bool all_bins /*=false*/)
+{
+    BGZF *fp = bgzf_open(filename.c_str(), "r");
+    if (fp == nullptr)
+        ggutils::die("problem opening " + filename);
+    char magic[sizeof(MANIFEST_MAGIC)];
+    if (bgzf_read(fp, magic, sizeof(magic)) != sizeof(magic) || !std::equal(magic, magic + sizeof(magic), MANIFEST_MAGIC))
+        ggutils::die(filename + " is not a gvcfgenotyper manifest");
+    if (read_value<uint32_t>(fp) != MANIFEST_VERSION)
+        ggutils::die(filename + " was written by another version of gvcfgenotyper, rerun gvcfgenotyper manifest");
+    _bin_size = read_value<int32_t>(fp);
+    std::set<std::string> region_contigs;
+    if (!region.empty())
+    {
+        bcf_sr_regions_t *regions = bcf_sr_regions_init(region.c_str(), is_file, 0, 1, -2);
+        if (regions == nullptr)
+            ggutils::die("Cannot navigate to region " + region);
+        region_contigs.insert(regions->seq_names, regions->seq_names + regions->nseqs);
+        bcf_sr_regions_destroy(regions);
+    }
+    //contigs of each layout that are in the region
+    std::vector<std::vector<bool>> keep(read_value<uint32_t>(fp));
+    for (size_t l = 0; l < keep.size(); l++)
+    {
+        std::string text = read_string(fp);
+        bcf_hdr_t *hdr = bcf_hdr_init("r");
+        if (bcf_hdr_parse(hdr, &text[0]) < 0)
+            ggutils::die("problem parsing a header of " + filename);
+        _headers.push_back(hdr);
+        keep[l].resize(hdr->n[BCF_DT_CTG]);
+        for (int rid = 0; rid < hdr->n[BCF_DT_CTG]; rid++)
+            keep[l][rid] = (all_bins && region.empty()) || region_contigs.count(bcf_hdr_id2name(hdr, rid)) > 0;
+    }
+    for (size_t l = 0; l < _headers.size(); l++)
+        _parse_mutexes.emplace_back(new std::mutex);
+    _inputs.resize(read_value<uint64_t>(fp));
+    for (size_t i = 0; i < _inputs.size(); i++)
+    {
+        input_t &input = _inputs[i];
+        input.filename = read_string(fp);
+        input.size = read_value<int64_t>(fp);
+        input.mtime = read_value<int64_t>(fp);
+        input.sample = read_string(fp);
+        input.layout = read_value<uint32_t>(fp);
+        if (input.layout >= keep.size())
+            ggutils::die("bad header index in " + filename);
+        input.vcf = read_value<uint8_t>(fp) != 0;
+        input.first_record = read_value<uint64_t>(fp);
+        uint32_t num_contigs = read_value<uint32_t>(fp);
+        for (uint32_t c = 0; c < num_contigs; c++)
+        {
+            int rid = read_value<int32_t>(fp);
+            std::vector<uint64_t> offsets(read_value<uint32_t>(fp));
+            read_bytes(fp, offsets.data(), offsets.size() * sizeof(uint64_t));
+            if (rid >= 0 && (size_t) rid < keep[input.layout].size() && keep[input.layout][rid])
+                input.bins[rid].swap(offsets);
+        }
+        _index.emplace(input.filename, i);
+    }
+    bgzf_close(fp);
+}
+
+void Manifest::AddHeaderLine(const std::string &line)
+{
+    //the first caller adds the line while the others wait, so no reader parses with a header being changed
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_header_lines.insert(line).second)
+        return;
+    for (auto hdr : _headers)
+    {
+        bcf_hdr_append(hdr, line.c_str());
+        bcf_hdr_sync(hdr);
+    }
+}
+
+int Manifest::Find(const std::string &filename) const
+{
+    auto it = _index.find(filename);
+    return (it != _index.end() ? (int) it->second : -1);
+}
+
+bool Manifest::IsCurrent(size_t i) const
+{
+    int64_t size, mtime;
+    stat_file(_inputs[i].filename, size, mtime);
+    return (size == _inputs[i].size && mtime == _inputs[i].mtime);
+}
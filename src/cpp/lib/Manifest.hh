@@ -0,0 +1,79 @@
+//
+// Cohort manifest: what gvcfgenotyper needs from every input's header and index, in one file.
+//
+
+#ifndef GVCFGENOTYPER_MANIFEST_HH
+#define GVCFGENOTYPER_MANIFEST_HH
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+#include "HeaderCache.hh"
+
+//Built once per cohort by 'gvcfgenotyper manifest', then read by every shard with --manifest. Distinct
+//header layouts (see HeaderCache::Layout) are stored once and each input keeps its path, size, mtime,
+//sample name, layout and the BGZF virtual offsets of its first record and of the first record overlapping
+//each bin of each contig, taken from its .tbi/.csi. Readers then seek straight to their data without
+//reading the header or loading the index. Only bgzipped inputs can be added.
+class Manifest
+{
+public:
+    struct input_t
+    {
+        std::string filename;
+        int64_t size, mtime;//-1 if the file could not be stat'ed
+        std::string sample;
+        uint32_t layout;//index of the header
+        bool vcf;//else BCF
+        uint64_t first_record;
+        //header contig id -> offset to read from to find every record overlapping the bin or later ones,
+        //UINT64_MAX once there are none. Contigs without records are left out.
+        std::map<int, std::vector<uint64_t>> bins;
+    };
+
+    Manifest();
+    ~Manifest();
+
+    //reads the header and index of each file, num_threads at a time
+    void Build(const std::vector<std::string> &filenames, int bin_size, int num_threads);
+    void Write(const std::string &filename);
+    //with a region only the bins of its contigs are kept, without one none are needed unless all_bins is set
+    void Read(const std::string &filename, const std::string &region = "", int is_file = 0, bool all_bins = false);
+
+    //header line the readers need, added to every layout once. Safe to call from several threads before their readers parse.
+    void AddHeaderLine(const std::string &line);
+
+    size_t GetNumInputs() const {return (_inputs.size());};
+    const input_t &GetInput(size_t i) const {return (_inputs[i]);};
+    //index of the input with this path, -1 if there is none
+    int Find(const std::string &filename) const;
+    //the input's size and mtime are those it was added with
+    bool IsCurrent(size_t i) const;
+    size_t GetNumHeaders() const {return (_headers.size());};
+    bcf_hdr_t *GetHeader(uint32_t layout) const {return (_headers[layout]);};
+    //lock to hold while parsing VCF text with GetHeader(layout), which readers without a HeaderCache share
+    std::mutex *GetParseMutex(uint32_t layout) const {return (_parse_mutexes[layout].get());};
+    int GetBinSize() const {return (_bin_size);};
+
+private:
+    static input_t Scan(const std::string &filename, int bin_size, bcf_hdr_t **header);
+
+    int _bin_size;
+    std::vector<input_t> _inputs;
+    std::map<std::string, size_t> _index;//filename -> input
+    std::vector<bcf_hdr_t *> _headers;
+    std::vector<std::unique_ptr<std::mutex>> _parse_mutexes;
+    std::set<std::string> _header_lines;//added by AddHeaderLine
+    std::mutex _mutex;
+};
+
+#endif //GVCFGENOTYPER_MANIFEST_HH
@@ -25,6 +25,8 @@ extern "C" {
 
 #include "spdlog.h"
 
+#include <mutex>
+
 int mnp_decompose(bcf1_t *record_to_split, bcf_hdr_t *header, vector<bcf1_t *> &output);
 
 // This class is problematic, with several members that are pointers to other
@@ -37,21 +39,25 @@ public:
     Normaliser(const std::string &ref_fname, bool ignore_non_matching_ref=false);
     ~Normaliser();
     //breaks multi-allelics into pseudo-unary representation (primitive alleles and one-variant-per-row)
-    void Unarise(bcf1_t *rec, std::vector<bcf1_t *> &atomised_variants, bcf_hdr_t *hdr);
+    //sample names the input in warnings, the header's own sample when null (headers can be shared between inputs)
+    void Unarise(bcf1_t *rec, std::vector<bcf1_t *> &atomised_variants, bcf_hdr_t *hdr, const char *sample = nullptr);
     //splits N multi-allelics into N separate records
-    void MultiSplit(bcf1_t *bcf_record_to_split, vector<bcf1_t *> &split_variants, bcf_hdr_t *hdr);
+    void MultiSplit(bcf1_t *bcf_record_to_split, vector<bcf1_t *> &split_variants, bcf_hdr_t *hdr, const char *sample = nullptr);
 
 //Performs left-alignment and trimming using code from bcftools' vcfnorm.c
-    bool Realign(bcf1_t *record, bcf_hdr_t *header);
+//Serialised, since readers may be filled from several threads and bcftools' buffers and fasta handle are shared
+    bool Realign(bcf1_t *record, bcf_hdr_t *header, const char *sample = nullptr);
 
 private:
     char _symbolic_allele[2];
     args_t *_norm_args;
+    std::mutex _mutex;//guards _norm_args
     bool _ignore_non_matching_ref;
     std::shared_ptr<spdlog::logger> _lg;
 };
 
 bcf1_t *CollapseRecords(bcf_hdr_t *sample_header,
-                        pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> & sample_variants);
+                        pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> & sample_variants,
+                        const char *sample = nullptr);
 
 #endif //GVCFGENOTYPER_NORMALISER_HH
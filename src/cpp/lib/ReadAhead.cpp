@@ -0,0 +1,151 @@
+#include "ReadAhead.hh"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+ReadAhead::ReadAhead(int num_threads, size_t window_bytes)
+{
+    _num_threads = num_threads;
+    _window_bytes = window_bytes;
+    _window = 0;
+    _chunk = 0;
+    _stop = false;
+    _num_requests = 0;
+    _bytes_requested = 0;
+    for (int i = 0; i < _num_threads; i++)
+        _threads.emplace_back(&ReadAhead::Worker, this);
+}
+
+ReadAhead::~ReadAhead()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &t : _threads)
+        t.join();
+}
+
+int ReadAhead::AddFile(const std::string &filename)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return (-1);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _files.push_back({-1, (uint64_t) st.st_size, 0, 0, false});
+    //128kB is a handful of BGZF blocks, beyond 8MB there is nothing left to hide
+    _window = std::min((size_t) 8 << 20, std::max((size_t) 128 << 10, _window_bytes / _files.size()));
+    _chunk = _window / 2;
+    return (_files.size() - 1);
+}
+
+//Queues the next chunk of a file if less than a window is prefetched ahead of its reader.
+void ReadAhead::Schedule(int id)
+{
+    file_t &f = _files[id];
+    if (f.fd < 0 || f.in_flight || f.horizon >= f.size || f.horizon - f.offset >= _window)
+        return;
+    uint64_t length = std::min((uint64_t) _chunk, f.size - f.horizon);
+    _queue.push_back({id, f.horizon, length});
+    f.horizon += length;
+    f.in_flight = true;
+    _cv.notify_one();
+}
+
+uint64_t ReadAhead::Advance(int id, int fd, uint64_t offset)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    file_t &f = _files[id];
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (f.fd != fd)//opened or reopened since the last call
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    f.fd = fd;
+    f.offset = offset;
+    if (f.horizon < offset)//the reader jumped ahead (eg. to the next region)
+        f.horizon = offset;
+    Schedule(id);
+    return (f.in_flight ? offset + _chunk / 4 : std::max(offset + 1, f.horizon - _window + 1));
+}
+
+void ReadAhead::Release(int id)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    file_t &f = _files[id];
+    f.fd = -1;
+    //a queued request is dropped, one being served is waited for
+    for (size_t i = 0; i < _queue.size(); i++)
+    {
+        if (_queue[i].id == id)
+        {
+            f.horizon = _queue[i].start;
+            _queue[i] = _queue.back();
+            _queue.pop_back();
+            f.in_flight = false;
+            break;
+        }
+    }
+    _done.wait(lock, [&f] { return !f.in_flight; });
+}
+
+void ReadAhead::Worker()
+{
+    while (true)
+    {
+        request_t request;
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [this] { return _stop || !_queue.empty(); });
+            if (_stop)
+                return;
+            //the file with the least prefetched data ahead of its reader goes first
+            auto next = std::min_element(_queue.begin(), _queue.end(), [this](const request_t &a, const request_t &b)
+            {
+                return (a.start - std::min(a.start, _files[a.id].offset) < b.start - std::min(b.start, _files[b.id].offset));
+            });
+            request = *next;
+            *next = _queue.back();
+            _queue.pop_back();
+            //Release() drops the queued requests of a file before its descriptor is closed
+            fd = _files[request.id].fd;
+        }
+
+#ifdef POSIX_FADV_WILLNEED
+        //the kernel reads the range into the page cache in the background
+        posix_fadvise(fd, request.start, request.length, POSIX_FADV_WILLNEED);
+#else
+        //pread does not move the reader's file offset
+        std::vector<char> buffer(request.length);
+        for (uint64_t num_read = 0; num_read < request.length;)
+        {
+            ssize_t n = pread(fd, buffer.data(), request.length - num_read, request.start + num_read);
+            if (n <= 0)
+                break;
+            num_read += n;
+        }
+#endif
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _num_requests++;
+        _bytes_requested += request.length;
+        _files[request.id].in_flight = false;
+        _done.notify_all();
+        Schedule(request.id);
+    }
+}
+
+uint64_t ReadAhead::GetNumRequests()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_num_requests);
+}
+
+uint64_t ReadAhead::GetBytesRequested()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_bytes_requested);
+}
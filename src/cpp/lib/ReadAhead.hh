@@ -0,0 +1,70 @@
+//
+// Background read-ahead of the compressed input GVCFs.
+//
+
+#ifndef GVCFGENOTYPER_READAHEAD_HH
+#define GVCFGENOTYPER_READAHEAD_HH
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+//Keeps the next few hundred kB of every input in the page cache so htslib's BGZF reads do not block
+//on storage. Readers report the compressed offset they have reached with Advance(), and a pool of
+//threads asks the kernel to read the range ahead of it in large coalesced chunks (POSIX_FADV_WILLNEED
+//on the reader's own descriptor). Each file has at most one chunk in flight and the threads always
+//serve the file whose prefetched data is closest to running out.
+class ReadAhead
+{
+public:
+    //window_bytes is shared by all files, each one gets an equal part of it
+    ReadAhead(int num_threads, size_t window_bytes = (size_t) 1 << 30);
+    ~ReadAhead();
+
+    //must be called before the first Advance(), returns the id for Advance() or -1 if the file is not a regular file
+    int AddFile(const std::string &filename);
+    //file id, open as fd, has been read up to offset, returns the offset at which it is worth calling again.
+    //fd must stay open until Release(id).
+    uint64_t Advance(int id, int fd, uint64_t offset);
+    //the descriptor of file id is about to be closed, waits until no thread is using it
+    void Release(int id);
+
+    size_t GetNumFiles() {return (_files.size());};
+    size_t GetWindow() {return (_window);};
+    uint64_t GetNumRequests();
+    uint64_t GetBytesRequested();
+
+private:
+    struct file_t
+    {
+        int fd;//-1 while the reader has no open descriptor
+        uint64_t size;
+        uint64_t offset;//reported by the reader
+        uint64_t horizon;//prefetched or requested up to here
+        bool in_flight;
+    };
+    struct request_t
+    {
+        int id;
+        uint64_t start, length;
+    };
+
+    void Worker();
+    void Schedule(int id);//with _mutex held
+
+    int _num_threads;
+    size_t _window_bytes, _window, _chunk;
+    std::vector<file_t> _files;
+    std::vector<request_t> _queue;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::condition_variable _done;//a request has been served
+    bool _stop;
+    uint64_t _num_requests, _bytes_requested;
+};
+
+#endif //GVCFGENOTYPER_READAHEAD_HH
@@ -0,0 +1,227 @@
+#include "RefBlockExpander.hh"
+
+RefBlockExpander::RefBlockExpander(const std::string &input_file, const std::string &output_file, const std::string &output_mode)
+{
+    _input_file = hts_open(input_file.c_str(), "r");
+    if (!_input_file)
+    {
+        ggutils::die("problem opening input file: " + input_file);
+    }
+    _input_header = bcf_hdr_read(_input_file);
+    if (!_input_header)
+    {
+        ggutils::die("problem reading header from: " + input_file);
+    }
+    if (!IsSparse(_input_header))
+    {
+        ggutils::die(input_file + " was not written with --sparse-ref-blocks");
+    }
+
+    _output_header = bcf_hdr_dup(_input_header);
+    bcf_hdr_remove(_output_header, BCF_HL_GEN, "gvcfgenotyper_reference_blocks");
+    bcf_hdr_remove(_output_header, BCF_HL_GEN, "gvcfgenotyper_reference_blocks_description");
+    bcf_hdr_sync(_output_header);
+
+    _output_file = hts_open(!output_file.empty() ? output_file.c_str() : "-", ("w" + output_mode).c_str());
+    if (!_output_file)
+    {
+        ggutils::die("problem opening output file: " + output_file);
+    }
+
+    _num_sample = bcf_hdr_nsamples(_output_header);
+    _rid = -1;
+    ref_block_t missing_block = {bcf_gt_missing, bcf_int32_vector_end, bcf_int32_missing, bcf_int32_missing,
+                                 bcf_int32_missing, bcf_int32_missing, 2, false};
+    _last_ref_block.assign(_num_sample, missing_block);
+    _gt = _dp = _dpf = _gq = _gqx = _ad = _adf = _adr = _pl = nullptr;
+    _num_gt = _num_dp = _num_dpf = _num_gq = _num_gqx = _num_ad = _num_adf = _num_adr = _num_pl = 0;
+}
+
+RefBlockExpander::~RefBlockExpander()
+{
+    hts_close(_input_file);
+    hts_close(_output_file);
+    bcf_hdr_destroy(_input_header);
+    bcf_hdr_destroy(_output_header);
+    free(_gt);
+    free(_dp);
+    free(_dpf);
+    free(_gq);
+    free(_gqx);
+    free(_ad);
+    free(_adf);
+    free(_adr);
+    free(_pl);
+}
+
+bool RefBlockExpander::IsSparse(const bcf_hdr_t *hdr)
+{
+    bcf_hrec_t *hrec = bcf_hdr_get_hrec(hdr, BCF_HL_GEN, "gvcfgenotyper_reference_blocks", nullptr, nullptr);
+    return (hrec != nullptr && hrec->value != nullptr && strcmp(hrec->value, "sparse") == 0);
+}
+
+//returns the number of values per sample, or -1 if the tag is absent
+int RefBlockExpander::GetFormatInt(bcf1_t *record, const char *tag, int32_t **dst, int *ndst)
+{
+    int ret = bcf_get_format_int32(_output_header, record, tag, dst, ndst);
+    if (ret <= 0)
+    {
+        return (-1);
+    }
+    return (ret / (int) _num_sample);
+}
+
+//pads a per-sample array with bcf_int32_vector_end so every sample has new_per_sample values
+int RefBlockExpander::Reshape(int32_t **values, int *num_values, int per_sample, int new_per_sample)
+{
+    if (per_sample <= 0 || per_sample >= new_per_sample)
+    {
+        return (per_sample);
+    }
+    *num_values = new_per_sample * _num_sample;
+    *values = (int32_t *) realloc(*values, *num_values * sizeof(int32_t));
+    for (int i = _num_sample - 1; i >= 0; i--)
+    {
+        int32_t *dst = *values + i * new_per_sample;
+        std::copy_backward(*values + i * per_sample, *values + (i + 1) * per_sample, dst + per_sample);
+        std::fill(dst + per_sample, dst + new_per_sample, bcf_int32_vector_end);
+    }
+    return (new_per_sample);
+}
+
+//a single missing value followed by vector ends, which is how MaskUnchangedRefBlocks writes a Number=R/G field.
+//Samples written explicitly always have a value, possibly missing, for every allele or genotype
+bool RefBlockExpander::IsMasked(const int32_t *values, int num_values)
+{
+    if (values[0] != bcf_int32_missing)
+        return (false);
+    for (int j = 1; j < num_values; j++)
+        if (values[j] != bcf_int32_vector_end)
+            return (false);
+    return (true);
+}
+
+void RefBlockExpander::ExpandRecord(bcf1_t *record)
+{
+    bcf_unpack(record, BCF_UN_ALL);
+    if (record->rid != _rid)
+    {
+        for (auto it = _last_ref_block.begin(); it != _last_ref_block.end(); it++)
+            it->valid = false;
+        _rid = record->rid;
+    }
+
+    int num_allele = record->n_allele;
+    int gt_per_sample = bcf_get_genotypes(_output_header, record, &_gt, &_num_gt) / (int) _num_sample;
+    int dp_per_sample = GetFormatInt(record, "DP", &_dp, &_num_dp);
+    int ad_per_sample = GetFormatInt(record, "AD", &_ad, &_num_ad);
+    if (gt_per_sample < 1 || gt_per_sample > 2 || dp_per_sample != 1 || ad_per_sample != num_allele)
+    {
+        ggutils::die("RefBlockExpander: unexpected FORMAT/GT, FORMAT/DP or FORMAT/AD at " +
+                     ggutils::record2string(_output_header, record));
+    }
+    //htslib returns fewer values per sample if every written sample is haploid, we always work with diploid sized arrays
+    Reshape(&_gt, &_num_gt, gt_per_sample, 2);
+    if (GetFormatInt(record, "DPF", &_dpf, &_num_dpf) != 1 || GetFormatInt(record, "GQ", &_gq, &_num_gq) != 1 ||
+        GetFormatInt(record, "GQX", &_gqx, &_num_gqx) != 1)
+    {
+        ggutils::die("RefBlockExpander: unexpected FORMAT/DPF, FORMAT/GQ or FORMAT/GQX at " +
+                     ggutils::record2string(_output_header, record));
+    }
+    int adf_per_sample = GetFormatInt(record, "ADF", &_adf, &_num_adf);
+    int adr_per_sample = GetFormatInt(record, "ADR", &_adr, &_num_adr);
+    int pl_per_sample = GetFormatInt(record, "PL", &_pl, &_num_pl);
+    adf_per_sample = Reshape(&_adf, &_num_adf, adf_per_sample, num_allele);
+    adr_per_sample = Reshape(&_adr, &_num_adr, adr_per_sample, num_allele);
+    pl_per_sample = Reshape(&_pl, &_num_pl, pl_per_sample, ggutils::get_number_of_gt_combinations(2, num_allele));
+
+    for (size_t i = 0; i < _num_sample; i++)
+    {
+        ref_block_t &block = _last_ref_block[i];
+        bool is_sparse = bcf_gt_is_missing(_gt[2 * i]) && _gt[2 * i + 1] == bcf_int32_vector_end &&
+                         _dp[i] == bcf_int32_missing && _dpf[i] == bcf_int32_missing &&
+                         _gq[i] == bcf_int32_missing && _gqx[i] == bcf_int32_missing &&
+                         IsMasked(_ad + i * num_allele, num_allele) &&
+                         (adf_per_sample <= 0 || IsMasked(_adf + i * adf_per_sample, adf_per_sample)) &&
+                         (adr_per_sample <= 0 || IsMasked(_adr + i * adr_per_sample, adr_per_sample)) &&
+                         (pl_per_sample <= 0 || IsMasked(_pl + i * pl_per_sample, pl_per_sample));
+        if (!is_sparse)
+        {
+            //this sample was written explicitly, remember its values
+            block.gt0 = _gt[2 * i];
+            block.gt1 = _gt[2 * i + 1];
+            block.dp = _dp[i];
+            block.dpf = _dpf[i];
+            block.gq = _gq[i];
+            block.gqx = _gqx[i];
+            block.ploidy = _gt[2 * i + 1] == bcf_int32_vector_end ? 1 : 2;
+            if (pl_per_sample > 0)
+            {
+                int num_pl = 0;
+                while (num_pl < pl_per_sample && _pl[i * pl_per_sample + num_pl] != bcf_int32_vector_end)
+                    num_pl++;
+                block.ploidy = num_pl == num_allele ? 1 : 2;
+            }
+            block.valid = true;
+        }
+        else if (block.valid)
+        {
+            _gt[2 * i] = block.gt0;
+            _gt[2 * i + 1] = block.gt1;
+            _dp[i] = block.dp;
+            _dpf[i] = block.dpf;
+            _gq[i] = block.gq;
+            _gqx[i] = block.gqx;
+            _ad[i * num_allele] = block.dp;
+            for (int j = 1; j < num_allele; j++)
+                _ad[i * num_allele + j] = 0;
+            for (int j = 0; j < adf_per_sample; j++)
+                _adf[i * adf_per_sample + j] = 0;
+            for (int j = 0; j < adr_per_sample; j++)
+                _adr[i * adr_per_sample + j] = 0;
+            if (pl_per_sample > 0)
+            {
+                int32_t *pl_ptr = _pl + i * pl_per_sample;
+                int num_pl_in_this_sample = ggutils::get_number_of_gt_combinations(block.ploidy, num_allele);
+                std::fill(pl_ptr, pl_ptr + pl_per_sample, bcf_int32_vector_end);
+                std::fill(pl_ptr, pl_ptr + num_pl_in_this_sample, 255);
+                pl_ptr[0] = 0;
+            }
+        }
+    }
+
+    //FORMAT order is preserved since all tags are already present in the record
+    bcf_update_genotypes(_output_header, record, _gt, _num_sample * 2);
+    bcf_update_format_int32(_output_header, record, "GQ", _gq, _num_sample);
+    bcf_update_format_int32(_output_header, record, "GQX", _gqx, _num_sample);
+    bcf_update_format_int32(_output_header, record, "DP", _dp, _num_sample);
+    bcf_update_format_int32(_output_header, record, "DPF", _dpf, _num_sample);
+    bcf_update_format_int32(_output_header, record, "AD", _ad, _num_sample * num_allele);
+    if (adf_per_sample > 0)
+        bcf_update_format_int32(_output_header, record, "ADF", _adf, _num_sample * adf_per_sample);
+    if (adr_per_sample > 0)
+        bcf_update_format_int32(_output_header, record, "ADR", _adr, _num_sample * adr_per_sample);
+    if (pl_per_sample > 0)
+        bcf_update_format_int32(_output_header, record, "PL", _pl, _num_sample * pl_per_sample);
+}
+
+int RefBlockExpander::Expand()
+{
+    if (bcf_hdr_write(_output_file, _output_header) != 0)
+    {
+        ggutils::die("RefBlockExpander: problem writing header");
+    }
+    bcf1_t *record = bcf_init1();
+    int num_written = 0;
+    while (bcf_read(_input_file, _input_header, record) == 0)
+    {
+        ExpandRecord(record);
+        if (bcf_write1(_output_file, _output_header, record) != 0)
+        {
+            ggutils::die("RefBlockExpander: problem writing record");
+        }
+        num_written++;
+    }
+    bcf_destroy(record);
+    return (num_written);
+}
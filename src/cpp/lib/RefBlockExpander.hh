@@ -0,0 +1,56 @@
+//
+// Restores dense FORMAT values from output written with --sparse-ref-blocks.
+//
+
+#ifndef GVCFGENOTYPER_REFBLOCKEXPANDER_HH
+#define GVCFGENOTYPER_REFBLOCKEXPANDER_HH
+
+extern "C" {
+#include <htslib/hts.h>
+#include <htslib/vcf.h>
+}
+
+#include "ggutils.hh"
+
+//Reads a sparse multi-sample file and writes the equivalent dense file.
+//Samples whose FORMAT fields are all missing, with a haploid GT and a single value for AD, ADF, ADR and PL,
+//take the homref values that were last written for that sample on the same contig. Samples written
+//explicitly, including ones without coverage, always have a value for every allele in AD.
+class RefBlockExpander
+{
+public:
+    RefBlockExpander(const std::string &input_file, const std::string &output_file, const std::string &output_mode);
+    ~RefBlockExpander();
+
+    //expands every record in the input, returns the number of records written
+    int Expand();
+    //expands a single record in place (record must use GetHeader())
+    void ExpandRecord(bcf1_t *record);
+    bcf_hdr_t *GetHeader() {return _output_header;};
+
+    //true if hdr was written by gvcfgenotyper --sparse-ref-blocks
+    static bool IsSparse(const bcf_hdr_t *hdr);
+
+private:
+    //homref values last written for a sample
+    struct ref_block_t
+    {
+        int32_t gt0, gt1, dp, dpf, gq, gqx;
+        int ploidy;
+        bool valid;
+    };
+
+    int GetFormatInt(bcf1_t *record, const char *tag, int32_t **dst, int *ndst);
+    static bool IsMasked(const int32_t *values, int num_values);
+    int Reshape(int32_t **values, int *num_values, int per_sample, int new_per_sample);
+
+    htsFile *_input_file, *_output_file;
+    bcf_hdr_t *_input_header, *_output_header;
+    size_t _num_sample;
+    int _rid;
+    std::vector<ref_block_t> _last_ref_block;
+    int32_t *_gt, *_dp, *_dpf, *_gq, *_gqx, *_ad, *_adf, *_adr, *_pl;
+    int _num_gt, _num_dp, _num_dpf, _num_gq, _num_gqx, _num_ad, _num_adf, _num_adr, _num_pl;
+};
+
+#endif //GVCFGENOTYPER_REFBLOCKEXPANDER_HH
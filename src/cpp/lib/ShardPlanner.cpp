@@ -0,0 +1,226 @@
+#include "ShardPlanner.hh"
+#include "IndexedReader.hh"
+#include "ggutils.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <fstream>
+
+//the compressed bytes from BGZF virtual offset a to b, the part within a block estimated with its compression
+static double compressed_bytes(uint64_t a, uint64_t b, double compression)
+{
+    double ret = (double) (b >> 16) - (a >> 16) + ((double) (b & 0xffff) - (a & 0xffff)) * compression;
+    return (std::max(0.0, ret));
+}
+
+//compressed over uncompressed size of the BGZF block at offset, from its BSIZE and ISIZE fields
+static double block_compression(const std::string &filename, uint64_t offset)
+{
+    std::ifstream file(filename, std::ios::binary);
+    unsigned char header[18], footer[4];
+    file.seekg(offset >> 16);
+    if (!file.read((char *) header, sizeof(header)))
+        return (0.25);
+    size_t compressed = (header[16] | header[17] << 8) + 1;
+    file.seekg((offset >> 16) + compressed - sizeof(footer));
+    if (!file.read((char *) footer, sizeof(footer)))
+        return (0.25);
+    size_t uncompressed = footer[0] | footer[1] << 8 | footer[2] << 16 | (size_t) footer[3] << 24;
+    return (uncompressed > 0 ? (double) compressed / uncompressed : 0.25);
+}
+
+ShardPlanner::ShardPlanner(const Manifest &manifest) : _manifest(manifest)
+{
+    if (_manifest.GetNumInputs() == 0)
+        ggutils::die("no inputs to plan shards with");
+    _header = _manifest.GetHeader(_manifest.GetInput(0).layout);
+    _bin_size = _manifest.GetBinSize();
+    _total_bytes = 0;
+    //contigs are stored one after the other, so each ends where the next one in the file starts
+    _contig_ends.resize(_manifest.GetNumInputs());
+    for (size_t i = 0; i < _manifest.GetNumInputs(); i++)
+    {
+        const Manifest::input_t &input = _manifest.GetInput(i);
+        _compression.push_back(block_compression(input.filename, input.first_record));
+        std::vector<std::pair<uint64_t, int>> starts;
+        for (auto &contig : input.bins)
+            starts.push_back({contig.second[0], contig.first});
+        std::sort(starts.begin(), starts.end());
+        for (size_t c = 0; c < starts.size(); c++)
+        {
+            uint64_t end = c + 1 < starts.size() ? starts[c + 1].first : std::max((int64_t) 0, input.size) << 16;
+            _contig_ends[i][starts[c].second] = std::max(end, starts[c].first);
+        }
+    }
+}
+
+const char *ShardPlanner::GetContigName(int rid)
+{
+    return (bcf_hdr_id2name(_header, rid));
+}
+
+std::vector<double> ShardPlanner::GetBinBytes(int rid)
+{
+    int64_t length = _header->id[BCF_DT_CTG][rid].val->info[0];
+    std::vector<double> bytes(length > 0 ? (length - 1) / _bin_size + 1 : 1, 0);
+    for (size_t i = 0; i < _manifest.GetNumInputs(); i++)
+    {
+        const Manifest::input_t &input = _manifest.GetInput(i);
+        //inputs with another layout may number their contigs differently
+        int input_rid = bcf_hdr_name2id(_manifest.GetHeader(input.layout), GetContigName(rid));
+        auto contig = input.bins.find(input_rid);
+        if (contig == input.bins.end())
+            continue;
+        const std::vector<uint64_t> &offsets = contig->second;
+        uint64_t contig_end = _contig_ends[i][input_rid];
+        for (size_t b = 0; b < offsets.size() && offsets[b] != UINT64_MAX; b++)
+        {
+            uint64_t next = b + 1 < offsets.size() && offsets[b + 1] != UINT64_MAX ? offsets[b + 1] : contig_end;
+            bytes[std::min(b, bytes.size() - 1)] += compressed_bytes(offsets[b], next, _compression[i]);
+        }
+    }
+    return (bytes);
+}
+
+int64_t ShardPlanner::FindGap(int rid, int64_t cut, int gap_window)
+{
+    if (gap_window <= 0)
+        return (cut);
+    int64_t lo = std::max((int64_t) 1, cut - gap_window), hi = cut + gap_window;
+    std::string region = std::string(GetContigName(rid)) + ":" + std::to_string(lo + 1) + "-" + std::to_string(hi);
+    std::vector<std::pair<int64_t, int64_t>> variants;
+    bcf1_t *record = bcf_init();
+    for (size_t i = 0; i < _manifest.GetNumInputs(); i++)
+    {
+        IndexedReader reader(_manifest, i, region);
+        while (reader.Next(record))
+        {
+            //homref blocks have no alleles or only symbolic ones
+            bool is_variant = false;
+            for (int a = 1; a < record->n_allele; a++)
+                is_variant |= record->d.allele[a][0] != '<' && strcmp(record->d.allele[a], ".") != 0;
+            if (is_variant)
+                variants.push_back({record->pos, record->pos + std::max(1, record->rlen)});
+        }
+    }
+    bcf_destroy(record);
+    if (variants.empty())
+        return (cut);
+    std::sort(variants.begin(), variants.end());
+
+    //the longest stretch of [lo, hi) that no variant overlaps, the one nearest to cut on ties
+    int64_t best = cut, best_length = -1, gap_start = lo;
+    auto consider = [&](int64_t gap_end)
+    {
+        gap_end = std::min(gap_end, hi);
+        int64_t length = gap_end - gap_start;
+        int64_t middle = gap_start + length / 2;
+        if (length > best_length || (length == best_length && std::abs(middle - cut) < std::abs(best - cut)))
+        {
+            best = middle;
+            best_length = length;
+        }
+    };
+    for (auto &v : variants)
+    {
+        if (v.first > gap_start)
+            consider(v.first);
+        gap_start = std::max(gap_start, v.second);
+        if (gap_start >= hi)
+            break;
+    }
+    if (gap_start < hi)
+        consider(hi);
+    return (best);
+}
+
+void ShardPlanner::Plan(int num_shards, int gap_window)
+{
+    if (num_shards < 1)
+        ggutils::die("the number of shards must be positive");
+    _shards.clear();
+    int num_contigs = _header->n[BCF_DT_CTG];
+    std::vector<std::vector<double>> bin_bytes(num_contigs);
+    _total_bytes = 0;
+    for (int rid = 0; rid < num_contigs; rid++)
+    {
+        bin_bytes[rid] = GetBinBytes(rid);
+        for (auto b : bin_bytes[rid])
+            _total_bytes += b;
+    }
+
+    //shard k ends once the running total reaches (k+1)/num_shards of the total
+    int k = 0;
+    auto threshold = [&]()
+    {
+        return ((double) _total_bytes * (k + 1) / num_shards);
+    };
+    double cumulative = 0;
+    shard_t shard = {{}, 0};
+    for (int rid = 0; rid < num_contigs; rid++)
+    {
+        int64_t length = _header->id[BCF_DT_CTG][rid].val->info[0];
+        int64_t beg = 0;
+        const std::vector<double> &bytes = bin_bytes[rid];
+        for (size_t b = 0; b < bytes.size(); b++)
+        {
+            cumulative += bytes[b];
+            shard.bytes += bytes[b];
+            if (k == num_shards - 1 || cumulative == 0 || cumulative < threshold())
+                continue;
+            int64_t cut = (int64_t) (b + 1) * _bin_size;
+            if (length > 0 && cut < length)
+                cut = FindGap(rid, cut, gap_window);
+            if (length <= 0 || cut >= length)
+            {
+                //the shard ends with the contig
+                shard.regions.push_back({rid, beg, length > 0 ? length : 0});
+                beg = -1;
+            }
+            else if (cut > beg)
+            {
+                shard.regions.push_back({rid, beg, cut});
+                beg = cut;
+            }
+            else
+                continue;
+            if (beg < 0)
+            {
+                //the rest of the contig's bins are in the shard that ends with it
+                for (b++; b < bytes.size(); b++)
+                {
+                    cumulative += bytes[b];
+                    shard.bytes += bytes[b];
+                }
+            }
+            _shards.push_back(shard);
+            shard = {{}, 0};
+            //a bin larger than a shard's share leaves fewer shards
+            while (k < num_shards - 1 && cumulative >= threshold())
+                k++;
+            if (beg < 0)
+                break;
+        }
+        if (beg >= 0)
+            shard.regions.push_back({rid, beg, length > 0 ? length : 0});
+    }
+    if (!shard.regions.empty())
+        _shards.push_back(shard);
+}
+
+std::string ShardPlanner::GetRegionList(size_t shard)
+{
+    std::string ret;
+    for (auto &r : _shards[shard].regions)
+    {
+        if (!ret.empty())
+            ret += ',';
+        ret += GetContigName(r.rid);
+        int64_t length = _header->id[BCF_DT_CTG][r.rid].val->info[0];
+        if (r.beg > 0 || (length > 0 && r.end < length))
+            ret += ":" + std::to_string(r.beg + 1) + "-" + std::to_string(r.end);
+    }
+    return (ret);
+}
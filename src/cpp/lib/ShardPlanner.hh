@@ -0,0 +1,62 @@
+//
+// Splits the genome into regions of about equal merge work, predicted from the inputs' indices.
+//
+
+#ifndef GVCFGENOTYPER_SHARDPLANNER_HH
+#define GVCFGENOTYPER_SHARDPLANNER_HH
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Manifest.hh"
+
+//The merge reads every input in full, so a shard's run time follows the compressed bytes of its
+//region summed over the inputs. These are read off the bin offsets of a manifest built from some or
+//all of the inputs. Offsets within a BGZF block (64kb of text) are weighted by the input's compression. Bins are
+//walked in header order and a shard ends once it holds its share of the total. Cuts are then moved to
+//the middle of the longest stretch within gap_window bp without a variant in any of the inputs, so
+//that no record is left-aligned or overlapping across a shard boundary.
+class ShardPlanner
+{
+public:
+    struct region_t
+    {
+        int rid;
+        int64_t beg, end;//0-based, end exclusive
+    };
+    struct shard_t
+    {
+        std::vector<region_t> regions;
+        double bytes;//predicted compressed bytes over the planned inputs
+    };
+
+    //manifest must keep its bins, ie. be built rather than read without a region
+    explicit ShardPlanner(const Manifest &manifest);
+
+    //at most num_shards shards cover every contig of the header, fewer if there are not enough bins
+    void Plan(int num_shards, int gap_window);
+    const std::vector<shard_t> &GetShards() {return (_shards);};
+    //-r argument for the shard: its regions, 1-based and comma separated
+    std::string GetRegionList(size_t shard);
+    const char *GetContigName(int rid);
+    double GetTotalBytes() {return (_total_bytes);};
+
+private:
+    //compressed bytes of each bin of contig rid (of the first input's header) over all inputs
+    std::vector<double> GetBinBytes(int rid);
+    //position in [cut - gap_window, cut + gap_window] furthest from the variants of the inputs
+    int64_t FindGap(int rid, int64_t cut, int gap_window);
+
+    const Manifest &_manifest;
+    bcf_hdr_t *_header;//contig order and names
+    int _bin_size;
+    //per input, header contig id -> offset at which the contig's records end
+    std::vector<std::map<int, uint64_t>> _contig_ends;
+    //per input, compressed over uncompressed size of its first block of records
+    std::vector<double> _compression;
+    std::vector<shard_t> _shards;
+    double _total_bytes;
+};
+
+#endif //GVCFGENOTYPER_SHARDPLANNER_HH
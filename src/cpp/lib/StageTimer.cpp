@@ -0,0 +1,174 @@
+#include "StageTimer.hh"
+#include "ggutils.hh"
+#include "spdlog.h"
+
+#include <mutex>
+
+#ifndef GG_NO_TIMERS
+namespace
+{
+    struct ThreadTotals;
+
+    std::mutex registry_mutex;
+    std::vector<ThreadTotals *> registry;
+    //totals of threads that have exited
+    std::vector<StageTotals> retired((size_t) Stage::NumStages);
+    int num_threads = 0;
+
+    struct ThreadTotals
+    {
+        ThreadTotals() : stages((size_t) Stage::NumStages), current(nullptr)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry.push_back(this);
+            num_threads++;
+        }
+
+        ~ThreadTotals()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (size_t i = 0; i < stages.size(); i++)
+            {
+                retired[i].calls += stages[i].calls;
+                retired[i].total_ns += stages[i].total_ns;
+                retired[i].self_ns += stages[i].self_ns;
+            }
+            registry.erase(std::find(registry.begin(), registry.end(), this));
+        }
+
+        std::vector<StageTotals> stages;
+        StageTimer *current; //innermost running timer of this thread
+    };
+
+    thread_local ThreadTotals thread_totals;
+}
+
+StageTimer::StageTimer(Stage stage)
+{
+    _stage = stage;
+    _parent = thread_totals.current;
+    _child_ns = 0;
+    thread_totals.current = this;
+    _start = std::chrono::steady_clock::now();
+}
+
+StageTimer::~StageTimer()
+{
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+    StageTotals &totals = thread_totals.stages[(size_t) _stage];
+    totals.calls++;
+    totals.total_ns += ns;
+    totals.self_ns += ns - _child_ns;
+    if (_parent != nullptr)
+        _parent->_child_ns += ns;
+    thread_totals.current = _parent;
+}
+#endif
+
+const char *StageTimer::StageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::Read: return "read";
+        case Stage::ConvertDragen: return "convert_dragen";
+        case Stage::Normalise: return "normalise";
+        case Stage::VariantBuffer: return "variant_buffer";
+        case Stage::GetNextVariant: return "get_next_variant";
+        case Stage::GenotypeSample: return "genotype_sample";
+        case Stage::UpdateFormatAndInfo: return "update_format_and_info";
+        case Stage::Write: return "write";
+        default: return "unknown";
+    }
+}
+
+bool StageTimer::Enabled()
+{
+#ifdef GG_NO_TIMERS
+    return false;
+#else
+    return true;
+#endif
+}
+
+//Only consistent once the threads using timers are idle, the totals are not synchronised.
+std::vector<StageTotals> StageTimer::GetTotals()
+{
+#ifdef GG_NO_TIMERS
+    return std::vector<StageTotals>((size_t) Stage::NumStages);
+#else
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::vector<StageTotals> ret = retired;
+    for (auto t : registry)
+    {
+        for (size_t i = 0; i < ret.size(); i++)
+        {
+            ret[i].calls += t->stages[i].calls;
+            ret[i].total_ns += t->stages[i].total_ns;
+            ret[i].self_ns += t->stages[i].self_ns;
+        }
+    }
+    return ret;
+#endif
+}
+
+int StageTimer::GetNumThreads()
+{
+#ifdef GG_NO_TIMERS
+    return 0;
+#else
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return num_threads;
+#endif
+}
+
+void StageTimer::Reset()
+{
+#ifndef GG_NO_TIMERS
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::fill(retired.begin(), retired.end(), StageTotals());
+    for (auto t : registry)
+        std::fill(t->stages.begin(), t->stages.end(), StageTotals());
+#endif
+}
+
+void StageTimer::LogTotals(std::shared_ptr<spdlog::logger> lg, double wall_seconds)
+{
+    if (!Enabled())
+    {
+        lg->info("Stage timers were disabled at compile time (GG_NO_TIMERS)");
+        return;
+    }
+    std::vector<StageTotals> totals = GetTotals();
+    lg->info("Stage timings over {} thread(s), self time excludes nested stages:", GetNumThreads());
+    for (size_t i = 0; i < totals.size(); i++)
+    {
+        double self = 1e-9 * totals[i].self_ns;
+        lg->info("  {:<24} calls={} total_seconds={:.3f} self_seconds={:.3f} self_percent={:.1f}",
+                 StageName((Stage) i), totals[i].calls, 1e-9 * totals[i].total_ns, self,
+                 wall_seconds > 0 ? 100. * self / wall_seconds : 0.);
+    }
+}
+
+void StageTimer::WriteJson(const std::string &filename, double wall_seconds)
+{
+    std::ofstream out(filename.c_str());
+    if (!out)
+        ggutils::die("problem opening " + filename);
+    std::vector<StageTotals> totals = GetTotals();
+    out << "{\n";
+    out << "  \"timers_enabled\": " << (Enabled() ? "true" : "false") << ",\n";
+    out << "  \"wall_seconds\": " << wall_seconds << ",\n";
+    out << "  \"threads\": " << GetNumThreads() << ",\n";
+    out << "  \"stages\": [\n";
+    for (size_t i = 0; i < totals.size(); i++)
+    {
+        out << "    {\"name\": \"" << StageName((Stage) i) << "\", \"calls\": " << totals[i].calls
+            << ", \"total_seconds\": " << 1e-9 * totals[i].total_ns
+            << ", \"self_seconds\": " << 1e-9 * totals[i].self_ns << "}"
+            << (i + 1 < totals.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+    if (!out)
+        ggutils::die("problem writing " + filename);
+}
@@ -0,0 +1,74 @@
+//
+// Scoped wall-clock timers for the stages of a merge, reported at the end of a run.
+//
+
+#ifndef GVCFGENOTYPER_STAGETIMER_HH
+#define GVCFGENOTYPER_STAGETIMER_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#ifndef GG_NO_TIMERS
+#include <chrono>
+#endif
+
+namespace spdlog { class logger; }
+
+//Stages of the per-site pipeline. Timers nest (GetNextVariant fills the reader buffers, which
+//reads, converts and normalises records), so every stage has an inclusive total and a self time
+//that excludes the nested stages. The self times add up to the time spent inside any timer.
+enum class Stage
+{
+    Read,                   //IndexedReader::Next: BGZF decompression and vcf_parse/bcf_read
+    ConvertDragen,          //ggutils::convert_dragen_gvcf_record
+    Normalise,              //Normaliser::Unarise
+    VariantBuffer,          //VariantBuffer::PushBack
+    GetNextVariant,         //GVCFMerger::GetNextVariant (GetNextSite with --sites)
+    GenotypeSample,         //GVCFMerger::GenotypeSample
+    UpdateFormatAndInfo,    //GVCFMerger::UpdateFormatAndInfo
+    Write,                  //bcf_write1 (ZarrWriter::AddSite with --zarr)
+    NumStages
+};
+
+struct StageTotals
+{
+    StageTotals() : calls(0), total_ns(0), self_ns(0) {};
+    uint64_t calls, total_ns, self_ns;
+};
+
+//Adds the time between construction and destruction to the calling thread's totals for a stage.
+//Totals live in thread-local storage so timers never contend, GetTotals() sums all threads.
+//Building with -DGG_NO_TIMERS turns the class into an empty object the compiler removes.
+class StageTimer
+{
+public:
+#ifdef GG_NO_TIMERS
+    explicit StageTimer(Stage) {};
+#else
+    explicit StageTimer(Stage stage);
+    ~StageTimer();
+#endif
+
+    static const char *StageName(Stage stage);
+    static bool Enabled();
+    //totals of every thread that has used a timer, indexed by Stage
+    static std::vector<StageTotals> GetTotals();
+    //number of threads that have used a timer
+    static int GetNumThreads();
+    static void Reset();
+    //one line per stage with calls, total and self seconds and the share of wall_seconds
+    static void LogTotals(std::shared_ptr<spdlog::logger> lg, double wall_seconds);
+    static void WriteJson(const std::string &filename, double wall_seconds);
+
+#ifndef GG_NO_TIMERS
+private:
+    Stage _stage;
+    StageTimer *_parent;
+    uint64_t _child_ns;
+    std::chrono::steady_clock::time_point _start;
+#endif
+};
+
+#endif //GVCFGENOTYPER_STAGETIMER_HH
@@ -67,6 +67,27 @@ int VariantBuffer::FlushBuffer(bcf1_t *record)
     return (num_flushed);
 }
 
+int VariantBuffer::RemoveIf(bcf1_t *record, const std::function<bool(bcf1_t *)> &remove)
+{
+    assert(record!=nullptr);
+    int num_removed = 0;
+    auto it = _buffer.begin();
+    while (it != _buffer.end() && ggutils::bcf1_leq(*it, record))
+    {
+        if (remove(*it))
+        {
+            bcf_destroy(*it);
+            it = _buffer.erase(it);
+            num_removed++;
+        }
+        else
+        {
+            it++;
+        }
+    }
+    return (num_removed);
+}
+
 int VariantBuffer::FlushBuffer(int chrom, int pos)
 {
     int num_flushed = 0;
@@ -102,6 +123,14 @@ size_t VariantBuffer::Size()
     return (_buffer.size());
 }
 
+size_t VariantBuffer::GetMemoryUsage()
+{
+    size_t ret = _buffer.size() * sizeof(bcf1_t *);
+    for (auto v : _buffer)
+        ret += ggutils::bcf1_memory_usage(v);
+    return (ret);
+}
+
 bool VariantBuffer::IsEmpty()
 {
     return (_buffer.empty());
@@ -6,6 +6,7 @@
 #define GVCFGENOTYPER_VARIANTBUFFER_HH
 
 #include <deque>
+#include <functional>
 
 extern "C" {
 #include <htslib/vcf.h>
@@ -26,6 +27,8 @@ public:
     int FlushBuffer(int rid, int pos);//flush variants up to and including rid/pos
     int FlushBuffer();//empty the buffer
     int FlushBuffer(bcf1_t *record);
+    //removes variants up to and including record for which remove(variant) is true
+    int RemoveIf(bcf1_t *record, const std::function<bool(bcf1_t *)> &remove);
     pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> GetAllVariantsInInterval(int chrom, int stop);//gets all variants in interval start<=x<=stop
     pair<std::deque<bcf1_t *>::iterator,std::deque<bcf1_t *>::iterator> GetAllVariantsUpTo(bcf1_t *record);//gets all variants in interval start<=x<=stop
 
@@ -36,6 +39,7 @@ public:
     bool IsEmpty();
 
     size_t Size();
+    size_t GetMemoryUsage();//approximate bytes held by the buffered records
     size_t GetNumDuplicatedRecords() const { return _num_duplicated_records;};
 
 private:
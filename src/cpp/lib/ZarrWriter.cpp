@@ -0,0 +1,311 @@
+#include "ZarrWriter.hh"
+
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <sys/stat.h>
+#include <zlib.h>
+
+static void make_directory(const std::string &path)
+{
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        ggutils::die("ZarrWriter: could not create directory " + path);
+    }
+}
+
+static std::string json_string(const std::string &s)
+{
+    std::string ret = "\"";
+    for (auto c = s.begin(); c != s.end(); c++)
+    {
+        if (*c == '"' || *c == '\\')
+            ret += '\\';
+        ret += *c;
+    }
+    return (ret + "\"");
+}
+
+static std::string json_list(const std::vector<std::string> &values)
+{
+    return (values.empty() ? "[]" : "[" + ggutils::join(values, ", ") + "]");
+}
+
+static void write_text_file(const std::string &path, const std::string &text)
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+    {
+        ggutils::die("ZarrWriter: could not write " + path);
+    }
+    out << text;
+}
+
+//the variants of a chunk are buffered for every sample, so large cohorts get fewer variants per chunk
+static const size_t MAX_CHUNK_BUFFER_BYTES = (size_t) 256 << 20;
+
+//bcf_int32_missing -> -1, bcf_int32_vector_end -> -2
+static inline int32_t zarr_int(int32_t value)
+{
+    if (value == bcf_int32_missing) return (-1);
+    if (value == bcf_int32_vector_end) return (-2);
+    return (value);
+}
+
+ZarrWriter::ZarrWriter(const std::string &directory, bcf_hdr_t *hdr, int max_alleles,
+                       int variant_chunk_size, int sample_chunk_size)
+{
+    if (max_alleles < 2 || variant_chunk_size < 1 || sample_chunk_size < 1)
+    {
+        ggutils::die("ZarrWriter: bad max_alleles or chunk size");
+    }
+    _directory = directory;
+    _num_sample = bcf_hdr_nsamples(hdr);
+    _num_variants = _num_buffered = _num_chunks = 0;
+    _max_alleles = max_alleles;
+    _num_pl = ggutils::get_number_of_gt_combinations(2, _max_alleles);
+    _sample_chunk_size = std::min(sample_chunk_size, std::max(1, (int) _num_sample));
+    _closed = false;
+    size_t call_bytes = 2 * sizeof(int8_t) + (2 + _max_alleles + _num_pl) * sizeof(int32_t);
+    size_t max_variants = MAX_CHUNK_BUFFER_BYTES / (call_bytes * std::max((size_t) 1, _num_sample));
+    _variant_chunk_size = (int) std::max((size_t) 1, std::min((size_t) variant_chunk_size, max_variants));
+
+    size_t num_calls = _variant_chunk_size * _num_sample;
+    _gt.resize(num_calls * 2);
+    _gq.resize(num_calls);
+    _dp.resize(num_calls);
+    _ad.resize(num_calls * _max_alleles);
+    _pl.resize(num_calls * _num_pl);
+    _contig.resize(_variant_chunk_size);
+    _position.resize(_variant_chunk_size);
+    _alleles.resize(_variant_chunk_size);
+
+    make_directory(_directory);
+    const char *arrays[] = {"call_GT", "call_GQ", "call_DP", "call_AD", "call_PL",
+                            "variant_contig", "variant_position", "variant_allele"};
+    for (auto name : arrays)
+    {
+        make_directory(_directory + "/" + name);
+    }
+    WriteGroupMetadata(hdr);
+}
+
+ZarrWriter::~ZarrWriter()
+{
+    if (!_closed)
+    {
+        Close();
+    }
+}
+
+void ZarrWriter::WriteGroupMetadata(bcf_hdr_t *hdr)
+{
+    std::vector<std::string> samples, contigs;
+    for (size_t i = 0; i < _num_sample; i++)
+    {
+        samples.push_back(json_string(hdr->samples[i]));
+    }
+    int num_contigs = 0;
+    const char **names = bcf_hdr_seqnames(hdr, &num_contigs);
+    for (int i = 0; i < num_contigs; i++)
+    {
+        contigs.push_back(json_string(names[i]));
+    }
+    free(names);
+
+    write_text_file(_directory + "/.zgroup", "{\n    \"zarr_format\": 2\n}\n");
+    std::stringstream attrs;
+    attrs << "{\n";
+    attrs << "    \"source\": " << json_string("gvcfgenotyper " + (std::string) GG_VERSION) << ",\n";
+    attrs << "    \"max_alleles\": " << _max_alleles << ",\n";
+    attrs << "    \"contigs\": " << json_list(contigs) << ",\n";
+    attrs << "    \"samples\": " << json_list(samples) << "\n";
+    attrs << "}\n";
+    write_text_file(_directory + "/.zattrs", attrs.str());
+}
+
+void ZarrWriter::AddSite(bcf1_t *record, const ggutils::vcf_data_t *format)
+{
+    assert(!_closed);
+    assert(format->num_sample == _num_sample);
+    assert(format->ploidy == 2);
+    bcf_unpack(record, BCF_UN_STR);
+    const int num_allele = record->n_allele;
+    const int num_pl_per_sample = ggutils::get_number_of_gt_combinations(2, num_allele);
+    const int num_pl_to_copy = std::min(num_pl_per_sample, _num_pl);
+    const size_t row = _num_buffered * _num_sample;
+
+    for (size_t i = 0; i < _num_sample; i++)
+    {
+        for (int j = 0; j < 2; j++)
+        {
+            int32_t gt = format->gt[2 * i + j];
+            int32_t value = gt == bcf_int32_vector_end ? -2 : (bcf_gt_is_missing(gt) ? -1 : bcf_gt_allele(gt));
+            if (value > INT8_MAX)
+            {
+                ggutils::die("ZarrWriter: too many alleles at " + std::to_string(record->pos + 1));
+            }
+            _gt[(row + i) * 2 + j] = (int8_t) value;
+        }
+        _gq[row + i] = zarr_int(format->gq[i]);
+        _dp[row + i] = zarr_int(format->dp[i]);
+
+        int32_t *ad = _ad.data() + (row + i) * _max_alleles;
+        for (int j = 0; j < _max_alleles; j++)
+        {
+            ad[j] = j < num_allele ? zarr_int(format->ad[i * num_allele + j]) : -2;
+        }
+        //the first G(2,max_alleles) likelihoods are exactly the genotypes made of the first max_alleles alleles
+        int32_t *pl = _pl.data() + (row + i) * _num_pl;
+        std::fill(pl, pl + _num_pl, -2);
+        for (int j = 0; j < num_pl_to_copy; j++)
+        {
+            pl[j] = zarr_int(format->pl[i * num_pl_per_sample + j]);
+        }
+    }
+
+    _contig[_num_buffered] = record->rid;
+    _position[_num_buffered] = record->pos + 1;
+    std::string alleles = record->d.allele[0];
+    for (int i = 1; i < num_allele; i++)
+    {
+        alleles += ",";
+        alleles += record->d.allele[i];
+    }
+    _alleles[_num_buffered] = alleles;
+
+    _num_buffered++;
+    _num_variants++;
+    if (_num_buffered == (size_t) _variant_chunk_size)
+    {
+        FlushChunk();
+    }
+}
+
+void ZarrWriter::WriteChunkFile(const std::string &path, const void *data, size_t num_bytes)
+{
+    uLongf compressed_size = compressBound(num_bytes);
+    std::vector<Bytef> compressed(compressed_size);
+    if (compress2(compressed.data(), &compressed_size, (const Bytef *) data, num_bytes, 1) != Z_OK)
+    {
+        ggutils::die("ZarrWriter: zlib compression failed for " + path);
+    }
+    std::ofstream out(path.c_str(), std::ios::binary);
+    if (!out)
+    {
+        ggutils::die("ZarrWriter: could not write " + path);
+    }
+    out.write((const char *) compressed.data(), compressed_size);
+}
+
+//chunks are always full sized, rows beyond the last variant and columns beyond the last sample are padding
+template<typename T>
+void ZarrWriter::WriteCallChunks(const std::string &name, const std::vector<T> &buffer, int width, T fill)
+{
+    std::vector<T> chunk(_variant_chunk_size * _sample_chunk_size * width);
+    for (size_t start = 0, j = 0; start < _num_sample; start += _sample_chunk_size, j++)
+    {
+        size_t stop = std::min(_num_sample, start + _sample_chunk_size);
+        std::fill(chunk.begin(), chunk.end(), fill);
+        for (size_t v = 0; v < _num_buffered; v++)
+        {
+            std::copy(buffer.begin() + (v * _num_sample + start) * width,
+                      buffer.begin() + (v * _num_sample + stop) * width,
+                      chunk.begin() + v * _sample_chunk_size * width);
+        }
+        std::string key = std::to_string(_num_chunks) + "." + std::to_string(j) + (width > 1 ? ".0" : "");
+        WriteChunkFile(_directory + "/" + name + "/" + key, chunk.data(), chunk.size() * sizeof(T));
+    }
+}
+
+template<typename T>
+void ZarrWriter::WriteVariantChunk(const std::string &name, const std::vector<T> &buffer, T fill)
+{
+    std::vector<T> chunk(buffer.begin(), buffer.begin() + _num_buffered);
+    chunk.resize(_variant_chunk_size, fill);
+    WriteChunkFile(_directory + "/" + name + "/" + std::to_string(_num_chunks), chunk.data(), chunk.size() * sizeof(T));
+}
+
+//numcodecs vlen-utf8 encoding: item count, then length + bytes for every item (all little endian uint32)
+void ZarrWriter::WriteAlleleChunk()
+{
+    std::string encoded;
+    uint32_t num_items = _variant_chunk_size;
+    encoded.append((const char *) &num_items, sizeof(uint32_t));
+    for (int v = 0; v < _variant_chunk_size; v++)
+    {
+        uint32_t length = (size_t) v < _num_buffered ? _alleles[v].size() : 0;
+        encoded.append((const char *) &length, sizeof(uint32_t));
+        if (length > 0)
+            encoded.append(_alleles[v]);
+    }
+    WriteChunkFile(_directory + "/variant_allele/" + std::to_string(_num_chunks), encoded.data(), encoded.size());
+}
+
+void ZarrWriter::FlushChunk()
+{
+    if (_num_buffered == 0)
+    {
+        return;
+    }
+    WriteCallChunks<int8_t>("call_GT", _gt, 2, -1);
+    WriteCallChunks<int32_t>("call_GQ", _gq, 1, -1);
+    WriteCallChunks<int32_t>("call_DP", _dp, 1, -1);
+    WriteCallChunks<int32_t>("call_AD", _ad, _max_alleles, -1);
+    WriteCallChunks<int32_t>("call_PL", _pl, _num_pl, -1);
+    WriteVariantChunk<int32_t>("variant_contig", _contig, -1);
+    WriteVariantChunk<int32_t>("variant_position", _position, -1);
+    WriteAlleleChunk();
+    _num_chunks++;
+    _num_buffered = 0;
+}
+
+void ZarrWriter::WriteArrayMetadata(const std::string &name, const std::string &dtype, int width,
+                                    const std::string &fill_value, const std::string &filters)
+{
+    bool is_call_array = name.compare(0, 5, "call_") == 0;
+    std::vector<std::string> shape = {std::to_string(_num_variants)};
+    std::vector<std::string> chunks = {std::to_string(_variant_chunk_size)};
+    std::vector<std::string> dimensions = {"\"variants\""};
+    if (is_call_array)
+    {
+        shape.push_back(std::to_string(_num_sample));
+        chunks.push_back(std::to_string(_sample_chunk_size));
+        dimensions.push_back("\"samples\"");
+    }
+    if (width > 1)
+    {
+        shape.push_back(std::to_string(width));
+        chunks.push_back(std::to_string(width));
+        dimensions.push_back(name == "call_GT" ? "\"ploidy\"" : (name == "call_AD" ? "\"alleles\"" : "\"genotypes\""));
+    }
+
+    std::stringstream zarray;
+    zarray << "{\n";
+    zarray << "    \"chunks\": " << json_list(chunks) << ",\n";
+    zarray << "    \"compressor\": {\"id\": \"zlib\", \"level\": 1},\n";
+    zarray << "    \"dtype\": \"" << dtype << "\",\n";
+    zarray << "    \"fill_value\": " << fill_value << ",\n";
+    zarray << "    \"filters\": " << filters << ",\n";
+    zarray << "    \"order\": \"C\",\n";
+    zarray << "    \"shape\": " << json_list(shape) << ",\n";
+    zarray << "    \"zarr_format\": 2\n";
+    zarray << "}\n";
+    write_text_file(_directory + "/" + name + "/.zarray", zarray.str());
+    //xarray dimension names
+    write_text_file(_directory + "/" + name + "/.zattrs", "{\n    \"_ARRAY_DIMENSIONS\": " + json_list(dimensions) + "\n}\n");
+}
+
+void ZarrWriter::Close()
+{
+    FlushChunk();
+    WriteArrayMetadata("call_GT", "|i1", 2, "-1", "null");
+    WriteArrayMetadata("call_GQ", "<i4", 1, "-1", "null");
+    WriteArrayMetadata("call_DP", "<i4", 1, "-1", "null");
+    WriteArrayMetadata("call_AD", "<i4", _max_alleles, "-1", "null");
+    WriteArrayMetadata("call_PL", "<i4", _num_pl, "-1", "null");
+    WriteArrayMetadata("variant_contig", "<i4", 1, "-1", "null");
+    WriteArrayMetadata("variant_position", "<i4", 1, "-1", "null");
+    WriteArrayMetadata("variant_allele", "|O", 1, "null", "[{\"id\": \"vlen-utf8\"}]");
+    _closed = true;
+}
@@ -0,0 +1,56 @@
+//
+// Writes merged genotypes as chunked variant x sample arrays in a Zarr v2 directory store.
+//
+
+#ifndef GVCFGENOTYPER_ZARRWRITER_HH
+#define GVCFGENOTYPER_ZARRWRITER_HH
+
+extern "C" {
+#include <htslib/vcf.h>
+}
+
+#include "ggutils.hh"
+
+//Arrays written (missing values are -1, padding beyond the number of alleles/ploidy is -2):
+//  call_GT [variant,sample,2] int8, call_GQ/call_DP [variant,sample] int32,
+//  call_AD [variant,sample,max_alleles] int32, call_PL [variant,sample,G(2,max_alleles)] int32,
+//  variant_contig/variant_position [variant] int32, variant_allele [variant] comma separated alleles.
+//AD/PL values for alleles beyond max_alleles are not stored, GT and variant_allele are always complete.
+//A chunk of variants is buffered for all samples before it is written, so the variants per chunk are lowered
+//to keep that buffer within 256MB, eg. to about 400 for 10000 samples with the default max_alleles.
+class ZarrWriter
+{
+public:
+    ZarrWriter(const std::string &directory, bcf_hdr_t *hdr, int max_alleles = 4,
+               int variant_chunk_size = 1000, int sample_chunk_size = 1000);
+    ~ZarrWriter();
+
+    //appends a site, format must hold the FORMAT values of record for every sample in hdr
+    void AddSite(bcf1_t *record, const ggutils::vcf_data_t *format);
+    //writes any buffered variants and the array metadata, called by the destructor if needed
+    void Close();
+    size_t GetNumVariants() { return (_num_variants); };
+    int GetVariantChunkSize() { return (_variant_chunk_size); };
+
+private:
+    template<typename T>
+    void WriteCallChunks(const std::string &name, const std::vector<T> &buffer, int width, T fill);
+    template<typename T>
+    void WriteVariantChunk(const std::string &name, const std::vector<T> &buffer, T fill);
+    void WriteAlleleChunk();
+    void WriteChunkFile(const std::string &path, const void *data, size_t num_bytes);
+    void WriteArrayMetadata(const std::string &name, const std::string &dtype, int width,
+                            const std::string &fill_value, const std::string &filters);
+    void WriteGroupMetadata(bcf_hdr_t *hdr);
+    void FlushChunk();
+
+    std::string _directory;
+    size_t _num_sample, _num_variants, _num_buffered, _num_chunks;
+    int _max_alleles, _num_pl, _variant_chunk_size, _sample_chunk_size;
+    bool _closed;
+    std::vector<int8_t> _gt;
+    std::vector<int32_t> _gq, _dp, _ad, _pl, _contig, _position;
+    std::vector<std::string> _alleles;
+};
+
+#endif //GVCFGENOTYPER_ZARRWRITER_HH
@@ -536,7 +536,7 @@ namespace ggutils
         return(ret);
     }
 
-    int bcf1_allele_swap(bcf_hdr_t *header, bcf1_t *record, int a,int b)
+    int bcf1_allele_swap(bcf_hdr_t *header, bcf1_t *record, int a,int b, const char *sample)
     {
         assert(a>0 && b>0);
         assert(a<record->n_allele && b<record->n_allele);
@@ -604,7 +604,7 @@ namespace ggutils
             if(status!=(int)ggutils::get_number_of_gt_combinations(ploidy,record->n_allele))
 	    {
 		ggutils::print_variant(header,record);
-		ggutils::die("problem with sample "+(string)header->samples[0]);
+		ggutils::die("problem with sample "+(string)(sample != nullptr ? sample : header->samples[0]));
 	    }
             vector<int> tmp_pl(format_pl,format_pl+num_pl);
             for(int i=0;i<record->n_allele;i++)
@@ -683,6 +683,15 @@ namespace ggutils
         std::fill(adr,adr+num_ad,bcf_int32_missing);
     }
 
+    size_t vcf_data_t::memory_usage() const
+    {
+        size_t ret = sizeof(vcf_data_t) + num_sample * sizeof(char *);
+        for (size_t i = 0; i < num_sample; i++)
+            if (ft[i] != nullptr) ret += strlen(ft[i]) + 1;
+        ret += (5 * num_sample + 3 * num_ad + num_pl + ploidy * num_sample) * sizeof(int32_t);
+        return (ret);
+    }
+
     vcf_data_t::~vcf_data_t()
     {
         free(ad);
@@ -868,6 +877,60 @@ namespace ggutils
         return((std::string)buffer);
     }
 
+    std::string string_duration(double seconds)
+    {
+        long s = seconds > 0 ? (long) (seconds + 0.5) : 0;
+        char buffer[64];
+        if (s >= 3600)
+            snprintf(buffer, sizeof(buffer), "%ldh%02ldm%02lds", s / 3600, (s / 60) % 60, s % 60);
+        else if (s >= 60)
+            snprintf(buffer, sizeof(buffer), "%ldm%02lds", s / 60, s % 60);
+        else
+            snprintf(buffer, sizeof(buffer), "%lds", s);
+        return ((std::string) buffer);
+    }
+
+    size_t bcf1_memory_usage(const bcf1_t *record)
+    {
+        size_t ret = sizeof(bcf1_t) + record->shared.m + record->indiv.m;
+        const bcf_dec_t &d = record->d;
+        ret += d.m_id + d.m_als + d.m_allele * sizeof(char *) + d.m_flt * sizeof(int);
+        ret += d.m_info * sizeof(bcf_info_t) + d.m_fmt * sizeof(bcf_fmt_t) + d.n_var * sizeof(variant_t);
+        for (int i = 0; i < record->n_fmt && i < d.m_fmt; i++)
+            if (d.fmt[i].p_free) ret += d.fmt[i].p_len;
+        for (int i = 0; i < record->n_info && i < d.m_info; i++)
+            if (d.info[i].vptr_free) ret += d.info[i].vptr_len;
+        return (ret);
+    }
+
+    size_t bcf_hdr_memory_usage(const bcf_hdr_t *header)
+    {
+        size_t ret = sizeof(bcf_hdr_t) + header->mem.m;
+        for (int i = 0; i < header->nhrec; i++)
+        {
+            const bcf_hrec_t *hrec = header->hrec[i];
+            ret += sizeof(bcf_hrec_t) + strlen(hrec->key) + 1 + (hrec->value ? strlen(hrec->value) + 1 : 0);
+            for (int j = 0; j < hrec->nkeys; j++)
+                ret += 2 * sizeof(char *) + strlen(hrec->keys[j]) + strlen(hrec->vals[j]) + 2;
+        }
+        //dictionaries: id blocks, hash entries and the key strings they own
+        for (int i = 0; i < 3; i++)
+        {
+            ret += header->m[i] * sizeof(bcf_idpair_t);
+            for (int j = 0; j < header->n[i]; j++)
+                if (header->id[i][j].key)
+                    ret += strlen(header->id[i][j].key) + 1 + sizeof(bcf_idinfo_t) + 2 * sizeof(void *);
+        }
+        return (ret);
+    }
+
+    int64_t get_contig_length(const bcf_hdr_t *header, int rid)
+    {
+        bcf_hrec_t *hrec = bcf_hdr_get_hrec(header, BCF_HL_CTG, "ID", bcf_hdr_id2name(header, rid), NULL);
+        int i = hrec ? bcf_hrec_find_key(hrec, "length") : -1;
+        return (i >= 0 ? atoll(hrec->vals[i]) : 0);
+    }
+
 
     float median(int *x, int n)
     {
@@ -910,6 +973,53 @@ namespace ggutils
         }
     }
     
+    void hwe_exact(int num_het, int num_hom_alt, int num_hom_ref, double &p_hwe, double &p_exc_het)
+    {
+        assert(num_het>=0 && num_hom_alt>=0 && num_hom_ref>=0);
+        p_hwe = p_exc_het = 1.;
+        int num_hom_rare = min(num_hom_alt,num_hom_ref);
+        int num_hom_common = max(num_hom_alt,num_hom_ref);
+        int num_rare = 2*num_hom_rare + num_het;
+        int num_genotypes = num_het + num_hom_rare + num_hom_common;
+        if(num_genotypes==0) return;
+
+        //probabilities of every possible number of hets given the allele counts, starting from the mode
+        std::vector<double> het_probs(num_rare+1,0.);
+        int mid = (int)((int64_t)num_rare * (2*num_genotypes - num_rare) / (2*num_genotypes));
+        if((num_rare & 1) ^ (mid & 1)) mid++;
+        het_probs[mid] = 1.;
+        double sum = 1.;
+        int hom_rare = (num_rare - mid) / 2;
+        int hom_common = num_genotypes - mid - hom_rare;
+        for(int het=mid;het>1;het-=2)
+        {
+            het_probs[het-2] = het_probs[het] * het * (het-1.) / (4. * (hom_rare+1.) * (hom_common+1.));
+            sum += het_probs[het-2];
+            hom_rare++;
+            hom_common++;
+        }
+        hom_rare = (num_rare - mid) / 2;
+        hom_common = num_genotypes - mid - hom_rare;
+        for(int het=mid;het<=num_rare-2;het+=2)
+        {
+            het_probs[het+2] = het_probs[het] * 4. * hom_rare * hom_common / ((het+2.) * (het+1.));
+            sum += het_probs[het+2];
+            hom_rare--;
+            hom_common--;
+        }
+
+        for(int het=0;het<=num_rare;het++)
+            het_probs[het] /= sum;
+        p_hwe = p_exc_het = 0.;
+        for(int het=0;het<=num_rare;het++)
+        {
+            if(het_probs[het] <= het_probs[num_het]) p_hwe += het_probs[het];
+            if(het >= num_het) p_exc_het += het_probs[het];
+        }
+        p_hwe = min(1.,p_hwe);
+        p_exc_het = min(1.,p_exc_het);
+    }
+
     bool is_valid_strelka_record(bcf_hdr_t const *header, bcf1_t *record)
     {
 	    int32_t *int_ptr=nullptr;
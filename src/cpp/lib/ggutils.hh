@@ -42,6 +42,7 @@ namespace ggutils
         vcf_data_t(size_t ploidy,size_t num_allele,size_t num_sample);
         void resize(size_t num_alleles);
         void set_missing();
+        size_t memory_usage() const;//bytes allocated for the buffers
         ~vcf_data_t();
     };
 
@@ -141,8 +142,8 @@ namespace ggutils
     //gets the index of a genotype likelihood for ploidy == 2
     int get_gl_index(int g0, int g1);
 
-    //swaps the ath alle with the bth allele, rearranges PL/AD accordingly
-    int bcf1_allele_swap(bcf_hdr_t *header, bcf1_t *record, int a,int b);
+    //swaps the ath alle with the bth allele, rearranges PL/AD accordingly. sample names the record's sample in errors (the header's first by default).
+    int bcf1_allele_swap(bcf_hdr_t *header, bcf1_t *record, int a,int b, const char *sample = nullptr);
 
     //returns the string length of the right trimmed ref/alt (see https://academic.oup.com/bioinformatics/article/31/13/2202/196142)
     void right_trim(const char *ref,const char *alt,size_t &reflen,size_t &altlen);
@@ -166,7 +167,18 @@ namespace ggutils
     //Fisher's exact test for per allele strand bias
     void fisher_sb_test(int *adf,int *adr,int num_allele,std::vector<float> & output,float maxret=1000.);
 
+    //Exact test for Hardy-Weinberg equilibrium (Wigginton et al. 2005, PMID:15789306).
+    //p_hwe is the two-sided p-value, p_exc_het the one-sided p-value for excess heterozygosity.
+    void hwe_exact(int num_het, int num_hom_alt, int num_hom_ref, double &p_hwe, double &p_exc_het);
+
     std::string string_time();
+    //formats a number of seconds as eg. 1h02m03s
+    std::string string_duration(double seconds);
+    //##contig=<length=...> of the contig with index rid, 0 if the header has no length
+    int64_t get_contig_length(const bcf_hdr_t *header, int rid);
+    //approximate heap bytes held by a record/header (allocated sizes, not the lengths in use)
+    size_t bcf1_memory_usage(const bcf1_t *record);
+    size_t bcf_hdr_memory_usage(const bcf_hdr_t *header);
     std::string generateUUID();
     int bcf1_get_one_format_string(const bcf_hdr_t *header, bcf1_t *record, const char *tag,std::string & output);
 }
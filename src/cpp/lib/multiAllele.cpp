@@ -46,9 +46,23 @@ void multiAllele::SetPosition(int rid, int pos)
     _pos = pos;
 }
 
+//only the contig and ID dictionaries are used, so the sample names of the output header are not copied
 void multiAllele::Init(bcf_hdr_t *hdr)
 {
-    _hdr = bcf_hdr_dup(hdr);
+    _hdr = bcf_hdr_subset(hdr, 0, nullptr, nullptr);
+}
+
+size_t multiAllele::GetHeaderMemoryUsage()
+{
+    return (_hdr != nullptr ? ggutils::bcf_hdr_memory_usage(_hdr) : 0);
+}
+
+size_t multiAllele::GetMemoryUsage()
+{
+    size_t ret = 0;
+    for (auto rec : _records)
+        ret += ggutils::bcf1_memory_usage(rec) + 3 * sizeof(void *);//list node
+    return (ret);
 }
 
 int multiAllele::Clear()
@@ -123,6 +137,16 @@ int multiAllele::AlleleIndex(bcf1_t *record,int index)
     }
 }
 
+bool multiAllele::HasAllele(bcf1_t *record,int index)
+{
+    if(record->rid!=_rid || record->pos!=_pos) return(false);
+    for(auto location=_records.begin();location!=_records.end();location++)
+    {
+        if(ggutils::find_allele(*location,record,index)==1) return(true);
+    }
+    return(false);
+}
+
 bcf1_t *multiAllele::GetMax()
 {
     bcf1_t *ret = nullptr;
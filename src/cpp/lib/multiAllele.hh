@@ -26,8 +26,11 @@ public:
     void SetPosition(int rid, int pos);
     int Allele(bcf1_t *record,int index=1);
     int AlleleIndex(bcf1_t *record,int index);
+    bool HasAllele(bcf1_t *record,int index);//like AlleleIndex but returns false rather than dying
     void Collapse(bcf1_t *output);
     int GetNumAlleles() {return _records.size();};
+    size_t GetMemoryUsage();//approximate bytes held by the allele records
+    size_t GetHeaderMemoryUsage();
     bcf1_t *GetMax();//returns the maximum allele (as defined by bcf1_t_less_than)
     int Clear();//wipes the _records
 
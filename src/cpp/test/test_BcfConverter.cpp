@@ -0,0 +1,56 @@
+#include "test_helpers.hh"
+#include "IndexedReader.hh"
+#include "BcfConverter.hh"
+
+#include <unistd.h>
+
+TEST(BcfConverter, outputNames)
+{
+    BcfConverter converter("out/", -1);
+    ASSERT_EQ(converter.GetOutput("/data/NA12877.genome.vcf.gz"), "out/NA12877.genome.bcf");
+    ASSERT_EQ(converter.GetOutput("NA12877.gvcf"), "out/NA12877.bcf");
+    ASSERT_EQ(converter.GetOutput("batch1/NA12877.bcf"), "out/NA12877.bcf");
+}
+
+//the BCFs and their indices give the records of the GVCFs
+TEST(BcfConverter, matchesInputs)
+{
+    std::vector<std::string> files;
+    for (auto name : {"NA12877", "NA12889", "NA12890"})
+        files.push_back(g_testenv->getBasePath() + "/../test/" + name + ".tiny.vcf.gz");
+    char dir[] = "/tmp/bcf-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    BcfConverter converter(dir, 1);
+    converter.Convert(files, 2);
+    ASSERT_EQ(converter.GetOutputs().size(), files.size());
+
+    uint64_t num_read = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const std::string &output = converter.GetOutputs()[i];
+        ASSERT_EQ(output, std::string(dir) + "/" + std::string(files[i], files[i].find_last_of('/') + 1, 7) + ".tiny.bcf");
+        for (std::string region : {"", "chr3:2000-3000,chr1:1-100", "chr3:9000"})
+        {
+            IndexedReader from_bcf(output, region), from_vcf(files[i], region);
+            ASSERT_EQ(from_bcf.GetSampleNames(), from_vcf.GetSampleNames());
+            bcf1_t *a = bcf_init(), *b = bcf_init();
+            while (from_vcf.Next(b))
+            {
+                ASSERT_TRUE(from_bcf.Next(a));
+                ASSERT_EQ(a->rid, b->rid);
+                ASSERT_EQ(a->pos, b->pos);
+                ASSERT_EQ(a->rlen, b->rlen);
+                ASSERT_EQ(a->n_allele, b->n_allele);
+                if (region.empty())
+                    num_read++;
+            }
+            ASSERT_FALSE(from_bcf.Next(a));
+            bcf_destroy(a);
+            bcf_destroy(b);
+        }
+        unlink(output.c_str());
+        unlink((output + ".csi").c_str());
+    }
+    ASSERT_EQ(converter.GetNumRecords(), num_read);
+    rmdir(dir);
+}
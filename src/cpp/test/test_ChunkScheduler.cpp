@@ -0,0 +1,49 @@
+#include "test_helpers.hh"
+#include "ChunkScheduler.hh"
+
+static bcf_hdr_t *test_header()
+{
+    bcf_hdr_t *hdr = bcf_hdr_init("w");
+    bcf_hdr_append(hdr, "##contig=<ID=chrA,length=1000000>");
+    bcf_hdr_append(hdr, "##contig=<ID=chrB,length=200000>");
+    bcf_hdr_append(hdr, "##contig=<ID=chrC>");
+    bcf_hdr_sync(hdr);
+    return (hdr);
+}
+
+TEST(ChunkScheduler, queuedChunksCoverTheGenome)
+{
+    bcf_hdr_t *hdr = test_header();
+    ChunkScheduler scheduler(hdr, "", 0, 2, 1000);
+    size_t a, b, c;
+    ASSERT_TRUE(scheduler.Next(a));
+    ASSERT_TRUE(scheduler.Next(b));
+    ASSERT_EQ(a, 0u);
+    ASSERT_EQ(scheduler.GetRegion(a), "chrA:1-1000000");
+    //the second half runs to the end of the last contig, which has no length
+    ASSERT_EQ(scheduler.GetRegion(b), "chrA:600001-1000000,chrB:1-200000,chrC");
+
+    //the chunk with the most left is split halfway between its last record and its end
+    ASSERT_TRUE(scheduler.Continue(a, 0, 599000));
+    ASSERT_TRUE(scheduler.Continue(b, 0, 899999));
+    ASSERT_TRUE(scheduler.Next(c));
+    ASSERT_EQ(scheduler.GetNumSteals(), 1u);
+    ASSERT_EQ(scheduler.GetRegion(c), "chrB:50001-200000,chrC");
+    ASSERT_TRUE(scheduler.Continue(b, 1, 49999));
+    ASSERT_FALSE(scheduler.Continue(b, 1, 50000));
+    ASSERT_TRUE(scheduler.Continue(c, 1, 50000));
+
+    //finished chunks come back in genomic order
+    scheduler.Finish(c);
+    scheduler.Finish(b);
+    scheduler.Finish(a);
+    size_t finished;
+    for (size_t expected : {a, b, c})
+    {
+        ASSERT_TRUE(scheduler.NextFinished(finished));
+        ASSERT_EQ(finished, expected);
+    }
+    ASSERT_FALSE(scheduler.NextFinished(finished));
+    ASSERT_EQ(scheduler.GetNumChunks(), 3u);
+    bcf_hdr_destroy(hdr);
+}
@@ -0,0 +1,59 @@
+#include "test_helpers.hh"
+#include "IndexedReader.hh"
+#include "FilePool.hh"
+
+#include <memory>
+
+//reading the inputs in turn through a pool of two open files gives the same records as reading them unpooled
+TEST(FilePool, reopen)
+{
+    std::vector<std::string> files;
+    for (auto name : {"NA12877", "NA12889", "NA12890"})
+        files.push_back(g_testenv->getBasePath() + "/../test/" + name + ".tiny.vcf.gz");
+
+    for (std::string region : {"", "chr3:2000-3000,chr3:5000-9000"})
+    {
+        FilePool pool(2);
+        std::vector<std::unique_ptr<IndexedReader>> pooled, unpooled;
+        for (auto &f : files)
+        {
+            pooled.emplace_back(new IndexedReader(f, region, 0, nullptr, &pool));
+            unpooled.emplace_back(new IndexedReader(f, region));
+            ASSERT_LE(pool.GetNumOpen(), 2u);
+        }
+        //the first input was read least recently
+        ASSERT_EQ(pooled[0]->GetFile(), nullptr);
+        ASSERT_NE(pooled[2]->GetFile(), nullptr);
+
+        bcf1_t *a = bcf_init(), *b = bcf_init();
+        size_t num_read = 0;
+        bool more = true;
+        while (more)
+        {
+            more = false;
+            //a few records at a time from each input, as GVCFReader does
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                for (int j = 0; j < 7; j++)
+                {
+                    bool has_a = pooled[i]->Next(a), has_b = unpooled[i]->Next(b);
+                    ASSERT_EQ(has_a, has_b);
+                    if (!has_a)
+                        break;
+                    ASSERT_EQ(a->rid, b->rid);
+                    ASSERT_EQ(a->pos, b->pos);
+                    ASSERT_EQ(a->rlen, b->rlen);
+                    more = true;
+                    num_read++;
+                }
+                ASSERT_LE(pool.GetNumOpen(), 2u);
+            }
+        }
+        ASSERT_GT(num_read, 0u);
+        ASSERT_GT(pool.GetNumReopens(), 0u);
+        //inputs that are done give up their file
+        ASSERT_EQ(pool.GetNumOpen(), 0u);
+        bcf_destroy(a);
+        bcf_destroy(b);
+    }
+}
@@ -0,0 +1,85 @@
+#include "test_helpers.hh"
+#include "FormatFields.hh"
+#include "ggutils.hh"
+
+static const char *INT_TAGS[] = {"GT", "AD", "ADF", "ADR", "DP", "DPF", "GQ", "GQX", "PL"};
+
+//every integer field read through FormatFields matches htslib, values and status
+static void expect_same_ints(bcf_hdr_t *hdr, bcf1_t *record)
+{
+    FormatFields fields(hdr, record);
+    for (int f = FormatFields::GT; f <= FormatFields::PL; f++)
+    {
+        int32_t *expected = nullptr, *observed = nullptr;
+        int num_expected = 0, num_observed = 0;
+        int status = f == FormatFields::GT ? bcf_get_genotypes(hdr, record, &expected, &num_expected)
+                                           : bcf_get_format_int32(hdr, record, INT_TAGS[f], &expected, &num_expected);
+        ASSERT_EQ(fields.GetInt((FormatFields::Field) f, &observed, &num_observed), status) << INT_TAGS[f];
+        for (int i = 0; i < status; i++)
+            ASSERT_EQ(observed[i], expected[i]) << INT_TAGS[f];
+        free(expected);
+        free(observed);
+    }
+    ASSERT_EQ(fields.GetPloidy(), ggutils::get_ploidy(hdr, record));
+}
+
+TEST(FormatFields, matchesHtslibOnStrelka)
+{
+    htsFile *fp = hts_open((g_testenv->getBasePath() + "/../test/NA12877.tiny.vcf.gz").c_str(), "r");
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf1_t *record = bcf_init1();
+    int num_records = 0;
+    while (bcf_read(fp, hdr, record) == 0)
+    {
+        expect_same_ints(hdr, record);
+        int32_t expected, observed;
+        FormatFields fields(hdr, record);
+        ASSERT_EQ(fields.GetOneInt(FormatFields::DP, observed), ggutils::bcf1_get_one_format_int(hdr, record, "DP", expected));
+        ASSERT_EQ(observed, expected);
+        std::string expected_filter, observed_filter;
+        ASSERT_EQ(fields.GetOneString(FormatFields::FT, observed_filter),
+                  ggutils::bcf1_get_one_format_string(hdr, record, "FT", expected_filter));
+        ASSERT_EQ(observed_filter, expected_filter);
+        num_records++;
+    }
+    ASSERT_GT(num_records, 0);
+    bcf_destroy1(record);
+    bcf_hdr_destroy(hdr);
+    hts_close(fp);
+}
+
+TEST(FormatFields, typesAndVectorEnds)
+{
+    bcf_hdr_t *hdr = bcf_hdr_init("w");
+    bcf_hdr_append(hdr, "##contig=<ID=chr1,length=1000>");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"GT\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=AD,Number=R,Type=Integer,Description=\"AD\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"DP\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GQ,Number=1,Type=Float,Description=\"GQ\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=PL,Number=G,Type=Integer,Description=\"PL\">");
+    bcf_hdr_add_sample(hdr, "S1");
+    bcf_hdr_add_sample(hdr, "S2");
+    bcf_hdr_sync(hdr);
+
+    //int8 AD with a vector end, int16 DP, int32 PL and a haploid second sample
+    bcf1_t *record = generate_record(hdr, "chr1\t5\t.\tA\tC,G\t.\tPASS\t.\tGT:AD:DP:GQ:PL\t"
+                                          "0/1:1,2,3:40000:12.5:0,100000,.,1,2,3\t1:4:.:.:0,30,60");
+    expect_same_ints(hdr, record);
+    FormatFields fields(hdr, record);
+    float *gq = nullptr;
+    int num_gq = 0;
+    ASSERT_EQ(fields.GetFloat(FormatFields::GQ, &gq, &num_gq), 2);
+    ASSERT_FLOAT_EQ(gq[0], 12.5);
+    ASSERT_TRUE(bcf_float_is_missing(gq[1]));
+    int32_t value;
+    //not in the header, of another type, not in the record
+    ASSERT_EQ(fields.GetOneInt(FormatFields::GQX, value), -1);
+    ASSERT_EQ(value, bcf_int32_missing);
+    ASSERT_EQ(fields.GetOneInt(FormatFields::GQ, value), -2);
+    bcf_hdr_append(hdr, "##FORMAT=<ID=DPF,Number=1,Type=Integer,Description=\"DPF\">");
+    bcf_hdr_sync(hdr);
+    ASSERT_EQ(FormatFields(hdr, record).GetOneInt(FormatFields::DPF, value), -3);
+    free(gq);
+    bcf_destroy1(record);
+    bcf_hdr_destroy(hdr);
+}
@@ -1,10 +1,15 @@
 #include "test_helpers.hh"
 
 #include "GVCFMerger.hh"
+#include "RefBlockExpander.hh"
+#include "BatchCombiner.hh"
 #include "StringUtil.hh"
 
 #include "spdlog.h"
 
+#include <map>
+#include <unistd.h>
+
 
 TEST(multiAllele,test1)
 {
@@ -106,3 +111,566 @@ TEST(GVCFMerger, likelihood)
     ASSERT_EQ(d.pl[4],0);
     ASSERT_EQ(d.pl[5],257);
 }
+
+//returns the non-header lines of a text vcf
+static std::vector<std::string> read_vcf_body(const std::string &fname)
+{
+    std::vector<std::string> lines,body;
+    ggutils::read_text_file(fname, lines);
+    for(auto it=lines.begin();it!=lines.end();it++)
+        if(!it->empty() && (*it)[0]!='#')
+            body.push_back(*it);
+    return body;
+}
+
+TEST(GVCFMerger, sparseRefBlocks)
+{
+    char dir[] = "/tmp/sparse-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),1u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    int buffer_size = 200;
+
+    {
+        GVCFMerger g(files, base + "/dense.vcf", "v", ref_file_name, buffer_size);
+        g.write_vcf();
+    }
+    {
+        GVCFMerger g(files, base + "/sparse.vcf", "v", ref_file_name, buffer_size);
+        g.SetSparseRefBlocks(true);
+        g.write_vcf();
+    }
+    {
+        RefBlockExpander e(base + "/sparse.vcf", base + "/expanded.vcf", "v");
+        ASSERT_GT(e.Expand(),0);
+    }
+
+    std::vector<std::string> dense = read_vcf_body(base + "/dense.vcf");
+    std::vector<std::string> sparse = read_vcf_body(base + "/sparse.vcf");
+    std::vector<std::string> expanded = read_vcf_body(base + "/expanded.vcf");
+    ASSERT_EQ(dense.size(),sparse.size());
+    ASSERT_EQ(dense.size(),expanded.size());
+    size_t dense_bytes=0,sparse_bytes=0;
+    for(size_t i=0;i<dense.size();i++)
+    {
+        ASSERT_EQ(dense[i],expanded[i]);
+        dense_bytes += dense[i].size();
+        sparse_bytes += sparse[i].size();
+    }
+    ASSERT_LT(sparse_bytes,dense_bytes);
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+//writes a single sample GVCF on chr3 of tiny.ref.fa
+static void write_gvcf(const std::string &fname, const std::string &sample, const std::vector<std::string> &body)
+{
+    FILE *fp = fopen(fname.c_str(), "w");
+    fputs("##fileformat=VCFv4.1\n"
+          "##contig=<ID=chr3,length=10015>\n"
+          "##INFO=<ID=END,Number=1,Type=Integer,Description=\"End position of the region described in this record\">\n"
+          "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n"
+          "##FORMAT=<ID=GQ,Number=1,Type=Integer,Description=\"Genotype Quality\">\n"
+          "##FORMAT=<ID=GQX,Number=1,Type=Integer,Description=\"Empirically calibrated genotype quality score\">\n"
+          "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"Filtered basecall depth\">\n"
+          "##FORMAT=<ID=DPF,Number=1,Type=Integer,Description=\"Basecalls filtered from input\">\n"
+          "##FORMAT=<ID=AD,Number=.,Type=Integer,Description=\"Allelic depths\">\n"
+          "##FORMAT=<ID=PL,Number=G,Type=Integer,Description=\"Phred-scaled genotype likelihoods\">\n", fp);
+    fprintf(fp, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\t%s\n", sample.c_str());
+    for (auto &line : body)
+        fprintf(fp, "%s\n", line.c_str());
+    fclose(fp);
+}
+
+//a sample without coverage is written explicitly and must not be expanded to its previous reference block
+TEST(GVCFMerger, sparseRefBlocksNoCoverage)
+{
+    char dir[] = "/tmp/sparse-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    const std::string hom = "GT:GQX:DP:DPF\t0/0:50:30:0", het = "GT:GQ:GQX:DP:DPF:AD:PL\t0/1:100:100:30:0:15,15:100,0,100";
+    write_gvcf(base + "/carrier.vcf", "carrier",
+               {"chr3\t1\t.\tC\t.\t.\tPASS\tEND=99\t" + hom, "chr3\t100\t.\tA\tC\t100\tPASS\t.\t" + het,
+                "chr3\t101\t.\tT\t.\t.\tPASS\tEND=199\t" + hom, "chr3\t200\t.\tA\tC\t100\tPASS\t.\t" + het,
+                "chr3\t201\t.\tA\t.\t.\tPASS\tEND=299\t" + hom, "chr3\t300\t.\tA\tC\t100\tPASS\t.\t" + het,
+                "chr3\t301\t.\tA\t.\t.\tPASS\tEND=400\t" + hom});
+    //covered at the first site, without coverage at the other two
+    write_gvcf(base + "/uncovered.vcf", "uncovered",
+               {"chr3\t1\t.\tC\t.\t.\tPASS\tEND=150\t" + hom,
+                "chr3\t151\t.\tT\t.\t.\tPASS\tEND=400\tGT:GQX:DP:DPF\t./.:.:.:."});
+    std::vector<std::string> files = {base + "/carrier.vcf", base + "/uncovered.vcf"};
+    std::string ref_file_name = g_testenv->getBasePath() + "/../test/tiny.ref.fa";
+    std::string dense_file = base + "/dense.vcf", sparse_file = base + "/sparse.vcf", expanded_file = base + "/expanded.vcf";
+
+    {
+        GVCFMerger g(files, dense_file, "v", ref_file_name, 200);
+        g.write_vcf();
+    }
+    {
+        GVCFMerger g(files, sparse_file, "v", ref_file_name, 200);
+        g.SetSparseRefBlocks(true);
+        g.write_vcf();
+    }
+    {
+        RefBlockExpander e(sparse_file, expanded_file, "v");
+        ASSERT_EQ(e.Expand(), 3);
+    }
+
+    std::vector<std::string> dense = read_vcf_body(dense_file);
+    std::vector<std::string> sparse = read_vcf_body(sparse_file);
+    std::vector<std::string> expanded = read_vcf_body(expanded_file);
+    ASSERT_EQ(dense.size(), 3u);
+    //the last site has the no coverage block masked
+    ASSERT_NE(dense[2], sparse[2]);
+    ASSERT_EQ(dense, expanded);
+    for (auto &f : {dense_file, sparse_file, expanded_file, files[0], files[1]})
+        unlink(f.c_str());
+    rmdir(dir);
+}
+
+//with --zarr no VCF is opened, so there is no empty file (or header on stdout)
+TEST(GVCFMerger, zarrWritesNoVcf)
+{
+    char dir[] = "/tmp/zarr-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    std::vector<std::string> files = {test_base + "NA12877_S1.vcf.gz", test_base + "NA12878_S1.vcf.gz"};
+    std::string output_file = std::string(dir) + "/unused.vcf.gz", zarr_directory = std::string(dir) + "/cohort.zarr";
+    {
+        GVCFMerger g(files, output_file, "z", test_base + "test2.ref.fa", 200);
+        g.SetZarrOutput(zarr_directory, 4);
+        g.write_vcf();
+    }
+    ASSERT_FALSE(ggutils::fileexists(output_file));
+    ASSERT_TRUE(ggutils::fileexists(zarr_directory + "/call_GT/.zarray"));
+    ASSERT_EQ(system(("rm -r " + std::string(dir)).c_str()), 0);
+}
+
+TEST(GVCFMerger, sitesOnly)
+{
+    char dir[] = "/tmp/sites-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),1u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    int buffer_size = 200;
+
+    {
+        GVCFMerger g(files, base + "/dense.vcf", "v", ref_file_name, buffer_size);
+        g.write_vcf();
+    }
+    {
+        GVCFMerger g(files, base + "/sites.vcf", "v", ref_file_name, buffer_size);
+        g.SetSitesOnly(true);
+        g.write_vcf();
+    }
+
+    htsFile *dense_fp = hts_open((base + "/dense.vcf").c_str(), "r");
+    htsFile *sites_fp = hts_open((base + "/sites.vcf").c_str(), "r");
+    bcf_hdr_t *dense_hdr = bcf_hdr_read(dense_fp);
+    bcf_hdr_t *sites_hdr = bcf_hdr_read(sites_fp);
+    ASSERT_EQ(bcf_hdr_nsamples(sites_hdr),0);
+    bcf1_t *dense_rec = bcf_init1();
+    bcf1_t *sites_rec = bcf_init1();
+    int32_t *dense_ac = nullptr, *sites_ac = nullptr, *sites_nc = nullptr;
+    int num_dense_ac = 0, num_sites_ac = 0, num_sites_nc = 0;
+    int num_sites = 0;
+    while(bcf_read(dense_fp, dense_hdr, dense_rec) == 0)
+    {
+        ASSERT_EQ(bcf_read(sites_fp, sites_hdr, sites_rec), 0);
+        bcf_unpack(dense_rec, BCF_UN_ALL);
+        bcf_unpack(sites_rec, BCF_UN_ALL);
+        ASSERT_EQ(dense_rec->pos, sites_rec->pos);
+        ASSERT_EQ(dense_rec->n_allele, sites_rec->n_allele);
+        for(int i=0;i<dense_rec->n_allele;i++)
+            ASSERT_STREQ(dense_rec->d.allele[i], sites_rec->d.allele[i]);
+        int num_alt = dense_rec->n_allele - 1;
+        ASSERT_EQ(bcf_get_info_int32(dense_hdr, dense_rec, "AC", &dense_ac, &num_dense_ac), num_alt);
+        ASSERT_EQ(bcf_get_info_int32(sites_hdr, sites_rec, "AC", &sites_ac, &num_sites_ac), num_alt);
+        ASSERT_EQ(bcf_get_info_int32(sites_hdr, sites_rec, "NC", &sites_nc, &num_sites_nc), num_alt);
+        for(int i=0;i<num_alt;i++)
+        {
+            ASSERT_EQ(dense_ac[i], sites_ac[i]);
+            ASSERT_LE(sites_nc[i], sites_ac[i]);
+        }
+        num_sites++;
+    }
+    ASSERT_NE(bcf_read(sites_fp, sites_hdr, sites_rec), 0);
+    ASSERT_GT(num_sites, 0);
+    free(dense_ac);
+    free(sites_ac);
+    free(sites_nc);
+    bcf_destroy(dense_rec);
+    bcf_destroy(sites_rec);
+    bcf_hdr_destroy(dense_hdr);
+    bcf_hdr_destroy(sites_hdr);
+    hts_close(dense_fp);
+    hts_close(sites_fp);
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+//splits a vcf line on tabs
+static std::vector<std::string> split_vcf_line(const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while(std::getline(ss, field, '\t'))
+        fields.push_back(field);
+    return fields;
+}
+
+TEST(GVCFMerger, twoPass)
+{
+    char dir[] = "/tmp/two-pass-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),2u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    int buffer_size = 200;
+
+    {
+        GVCFMerger g(files, base + "/dense.vcf", "v", ref_file_name, buffer_size);
+        g.write_vcf();
+    }
+    {
+        GVCFMerger g(files, base + "/sites.vcf", "v", ref_file_name, buffer_size);
+        g.SetSitesOnly(true);
+        g.write_vcf();
+    }
+    //genotype the first few samples against the full catalogue
+    size_t num_batch = 3;
+    std::vector<std::string> batch(files.begin(), files.begin() + num_batch);
+    {
+        GVCFMerger g(batch, base + "/batch.vcf", "v", ref_file_name, buffer_size);
+        g.SetSites(base + "/sites.vcf");
+        g.write_vcf();
+    }
+
+    std::vector<std::string> dense = read_vcf_body(base + "/dense.vcf");
+    std::vector<std::string> batch_body = read_vcf_body(base + "/batch.vcf");
+    ASSERT_EQ(dense.size(), batch_body.size());
+    for(size_t i=0;i<dense.size();i++)
+    {
+        std::vector<std::string> dense_fields = split_vcf_line(dense[i]);
+        std::vector<std::string> batch_fields = split_vcf_line(batch_body[i]);
+        ASSERT_EQ(batch_fields.size(), 9 + num_batch);
+        //CHROM POS ID REF ALT
+        for(size_t j=0;j<5;j++)
+            ASSERT_EQ(dense_fields[j], batch_fields[j]);
+        //FORMAT and the batch samples only depend on the site and the sample
+        for(size_t j=8;j<batch_fields.size();j++)
+            ASSERT_EQ(dense_fields[j], batch_fields[j]);
+    }
+
+    //combining the batch with a batch of the remaining samples gives the single run, INFO and QUAL included
+    std::vector<std::string> rest(files.begin() + num_batch, files.end());
+    {
+        GVCFMerger g(rest, base + "/rest.bcf", "b", ref_file_name, buffer_size);
+        g.SetSites(base + "/sites.vcf");
+        g.write_vcf();
+        GVCFMerger b(batch, base + "/batch.bcf", "b", ref_file_name, buffer_size);
+        b.SetSites(base + "/sites.vcf");
+        b.write_vcf();
+    }
+    {
+        BatchCombiner combiner({base + "/batch.bcf", base + "/rest.bcf"}, base + "/combined.vcf", "v");
+        ASSERT_EQ(combiner.Combine(), (int) dense.size());
+    }
+    ASSERT_EQ(read_vcf_body(base + "/combined.vcf"), dense);
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+//a catalogue with the GVCFs' contigs in another order would have its later contigs skipped by the readers
+TEST(GVCFMerger, sitesContigOrder)
+{
+    char sites_file[] = "/tmp/sites-XXXXXX";
+    int fd = mkstemp(sites_file);
+    ASSERT_GE(fd, 0);
+    std::string text = "##fileformat=VCFv4.2\n##contig=<ID=chr3>\n##contig=<ID=chr2>\n##contig=<ID=chr1>\n"
+                       "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\nchr1\t477\t.\tT\tC\t.\t.\t.\n";
+    ASSERT_EQ(write(fd, text.c_str(), text.size()), (ssize_t) text.size());
+    close(fd);
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    std::vector<std::string> files = {test_base + "NA12877_S1.vcf.gz"};
+    char dir[] = "/tmp/sites-out-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string output_file = std::string(dir) + "/batch.vcf";
+    ASSERT_EXIT({
+        GVCFMerger g(files, output_file, "v", test_base + "test2.ref.fa", 200);
+        g.SetSites(sites_file);
+    }, ::testing::ExitedWithCode(1), "has contig chr2 after chr3");
+    unlink(sites_file);
+    rmdir(dir);
+}
+
+TEST(GVCFMerger, hail)
+{
+    char dir[] = "/tmp/hail-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    {
+        GVCFMerger g(files, base + "/hail.vcf.gz", "z", ref_file_name, 200);
+        g.SetHail(true);
+        g.write_vcf();
+    }
+
+    htsFile *fp = hts_open((base + "/hail.vcf.gz").c_str(), "r");
+    ASSERT_EQ(hts_get_format(fp)->compression, bgzf);
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf1_t *rec = bcf_init1();
+    int32_t *gt = nullptr, *pl = nullptr, *adf = nullptr;
+    int num_gt = 0, num_pl = 0, num_adf = 0;
+    int num_sample = bcf_hdr_nsamples(hdr);
+    int num_records = 0;
+    while(bcf_read(fp, hdr, rec) == 0)
+    {
+        //every sample is diploid with a full set of PL
+        int num_pl_per_sample = ggutils::get_number_of_gt_combinations(2, rec->n_allele);
+        ASSERT_EQ(bcf_get_genotypes(hdr, rec, &gt, &num_gt), 2 * num_sample);
+        ASSERT_EQ(bcf_get_format_int32(hdr, rec, "PL", &pl, &num_pl), num_pl_per_sample * num_sample);
+        for(int i=0;i<2*num_sample;i++)
+            ASSERT_NE(gt[i], bcf_int32_vector_end);
+        for(int i=0;i<num_pl_per_sample*num_sample;i++)
+            ASSERT_TRUE(pl[i] != bcf_int32_missing && pl[i] != bcf_int32_vector_end);
+        //FORMAT/ADF is either complete or missing
+        int num_adf_per_sample = bcf_get_format_int32(hdr, rec, "ADF", &adf, &num_adf) / num_sample;
+        for(int i=0;i<num_sample;i++)
+        {
+            int32_t *ptr = adf + i * num_adf_per_sample;
+            if(ptr[0] == bcf_int32_missing)
+                continue;
+            for(int j=0;j<rec->n_allele;j++)
+                ASSERT_NE(ptr[j], bcf_int32_missing);
+        }
+        num_records++;
+    }
+    ASSERT_GT(num_records, 0);
+    free(gt);
+    free(pl);
+    free(adf);
+    bcf_destroy(rec);
+    bcf_hdr_destroy(hdr);
+    hts_close(fp);
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+TEST(GVCFMerger, infoTags)
+{
+    char dir[] = "/tmp/tags-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),2u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    {
+        std::ofstream groups(base + "/groups.txt");
+        //repeated samples and groups are only counted once
+        groups << "NA12877_S1 A\nNA12878_S1 A,B,A\nNA12879_S1 B\nNOT_A_SAMPLE B\nNA12879_S1 B\n";
+    }
+    {
+        GVCFMerger g(files, base + "/tags.vcf", "v", ref_file_name, 200);
+        g.SetInfoTags("HWE,MAF,ExcHet,F_MISSING");
+        g.SetSampleGroups(base + "/groups.txt");
+        g.write_vcf();
+    }
+
+    htsFile *fp = hts_open((base + "/tags.vcf").c_str(), "r");
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf1_t *rec = bcf_init1();
+    int32_t *gt = nullptr, *ac = nullptr, *ac_a = nullptr, *an_b = nullptr;
+    float *maf = nullptr, *hwe = nullptr, *exc_het = nullptr, *f_missing = nullptr;
+    int num_gt = 0, num_ac = 0, num_ac_a = 0, num_an_b = 0, num_maf = 0, num_hwe = 0, num_exc_het = 0, num_f_missing = 0;
+    int sample_a0 = bcf_hdr_id2int(hdr, BCF_DT_SAMPLE, "NA12877_S1");
+    int sample_a1 = bcf_hdr_id2int(hdr, BCF_DT_SAMPLE, "NA12878_S1");
+    int sample_b1 = bcf_hdr_id2int(hdr, BCF_DT_SAMPLE, "NA12879_S1");
+    int num_sample = bcf_hdr_nsamples(hdr);
+    while(bcf_read(fp, hdr, rec) == 0)
+    {
+        int num_alt = rec->n_allele - 1;
+        ASSERT_EQ(bcf_get_info_float(hdr, rec, "MAF", &maf, &num_maf), num_alt);
+        ASSERT_EQ(bcf_get_info_float(hdr, rec, "HWE", &hwe, &num_hwe), num_alt);
+        ASSERT_EQ(bcf_get_info_float(hdr, rec, "ExcHet", &exc_het, &num_exc_het), num_alt);
+        ASSERT_EQ(bcf_get_info_float(hdr, rec, "F_MISSING", &f_missing, &num_f_missing), 1);
+        ASSERT_EQ(bcf_get_info_int32(hdr, rec, "AC", &ac, &num_ac), num_alt);
+        ASSERT_EQ(bcf_get_info_int32(hdr, rec, "AC_A", &ac_a, &num_ac_a), num_alt);
+        ASSERT_EQ(bcf_get_info_int32(hdr, rec, "AN_B", &an_b, &num_an_b), 1);
+        for(int i=0;i<num_alt;i++)
+        {
+            ASSERT_LE(maf[i], 0.5);
+            ASSERT_TRUE(hwe[i] >= 0 && hwe[i] <= 1);
+            ASSERT_TRUE(exc_het[i] >= 0 && exc_het[i] <= 1);
+        }
+
+        //recount the groups from the genotypes
+        int ploidy = bcf_get_genotypes(hdr, rec, &gt, &num_gt) / num_sample;
+        int expected_ac_a = 0, expected_an_b = 0, num_missing = 0;
+        for(int i=0;i<num_sample;i++)
+            num_missing += bcf_gt_is_missing(gt[i * ploidy]);
+        for(int s : {sample_a0, sample_a1})
+            for(int j=0;j<ploidy;j++)
+                if(gt[s * ploidy + j] != bcf_int32_vector_end && !bcf_gt_is_missing(gt[s * ploidy + j]))
+                    expected_ac_a += bcf_gt_allele(gt[s * ploidy + j]) == 1;
+        for(int s : {sample_a1, sample_b1})
+            for(int j=0;j<ploidy;j++)
+                if(gt[s * ploidy + j] != bcf_int32_vector_end && !bcf_gt_is_missing(gt[s * ploidy + j]))
+                    expected_an_b++;
+        ASSERT_EQ(ac_a[0], expected_ac_a);
+        ASSERT_EQ(an_b[0], expected_an_b);
+        //text VCF only keeps a few decimal places
+        ASSERT_NEAR(f_missing[0], (float) num_missing / num_sample, 1e-5);
+    }
+    free(gt);
+    free(ac);
+    free(ac_a);
+    free(an_b);
+    free(maf);
+    free(hwe);
+    free(exc_het);
+    free(f_missing);
+    bcf_destroy(rec);
+    bcf_hdr_destroy(hdr);
+    hts_close(fp);
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+//a group that cannot be an INFO ID would only fail once its AC_ is written
+TEST(GVCFMerger, sampleGroupNames)
+{
+    char dir[] = "/tmp/groups-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    std::vector<std::string> files = {test_base + "NA12877_S1.vcf.gz"};
+    {
+        std::ofstream groups(base + "/groups.txt");
+        groups << "NA12877_S1 EUR,AFR-1\n";
+    }
+    ASSERT_EXIT({
+        GVCFMerger g(files, base + "/groups.vcf", "v", test_base + "test2.ref.fa", 200);
+        g.SetSampleGroups(base + "/groups.txt");
+    }, ::testing::ExitedWithCode(1), "AFR-1");
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+TEST(GVCFMerger, writeIndex)
+{
+    char dir[] = "/tmp/index-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string base = dir;
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),1u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    int buffer_size = 200;
+
+    for(std::string output_type : {"b", "z"})
+    {
+        std::string output_file = output_type == "b" ? base + "/indexed.bcf" : base + "/indexed.vcf.gz";
+        std::string index_file = output_file + (output_type == "b" ? ".csi" : ".tbi");
+        {
+            GVCFMerger g(files, output_file, output_type, ref_file_name, buffer_size);
+            g.SetWriteIndex(true);
+            g.write_vcf();
+        }
+        ASSERT_TRUE(ggutils::fileexists(index_file));
+
+        //every record found by a linear scan of each contig must be returned by the index
+        htsFile *fp = hts_open(output_file.c_str(), "r");
+        bcf_hdr_t *hdr = bcf_hdr_read(fp);
+        bcf1_t *rec = bcf_init1();
+        std::map<std::string, int> records_per_contig;
+        while(bcf_read(fp, hdr, rec) == 0)
+            records_per_contig[bcf_seqname(hdr, rec)]++;
+        ASSERT_FALSE(records_per_contig.empty());
+
+        for(auto it = records_per_contig.begin(); it != records_per_contig.end(); it++)
+        {
+            bcf_srs_t *sr = bcf_sr_init();
+            bcf_sr_set_opt(sr, BCF_SR_REQUIRE_IDX);
+            ASSERT_EQ(bcf_sr_set_regions(sr, it->first.c_str(), 0), 0);
+            ASSERT_EQ(bcf_sr_add_reader(sr, output_file.c_str()), 1);
+            int num_records = 0;
+            while(bcf_sr_next_line(sr))
+                num_records++;
+            ASSERT_EQ(num_records, it->second);
+            bcf_sr_destroy(sr);
+        }
+        bcf_destroy(rec);
+        bcf_hdr_destroy(hdr);
+        hts_close(fp);
+    }
+    ASSERT_EQ(system(("rm -r " + base).c_str()), 0);
+}
+
+TEST(GVCFMerger, memoryUsage)
+{
+    std::vector<std::string> files;
+    std::string test_base = g_testenv->getBasePath() + "/../test/test2/";
+    for(int i=77;i<=93;i++)
+    {
+        std::string fname = test_base + "NA128" + std::to_string(i) + "_S1.vcf.gz";
+        if(ggutils::fileexists(fname)) files.push_back(fname);
+    }
+    ASSERT_GT(files.size(),1u);
+    std::string ref_file_name = test_base + "test2.ref.fa";
+    GVCFMerger g(files, "/dev/null", "b", ref_file_name, 200);
+
+    //the readers fill their buffers on construction
+    merge_memory_t memory = g.GetMemoryUsage();
+    //the inputs come from one pipeline and share a single header, plus the output header and the collapser's copy
+    ASSERT_EQ(memory.num_headers, 3u);
+    ASSERT_GT(memory.variant_buffer_records, 0u);
+    ASSERT_GT(memory.variant_buffer_bytes, memory.variant_buffer_records * sizeof(bcf1_t));
+    ASSERT_GT(memory.depth_buffer_blocks, 0u);
+    ASSERT_EQ(memory.depth_buffer_bytes, memory.depth_buffer_blocks * sizeof(DepthBlock));
+    ASSERT_GT(memory.header_bytes, 0u);
+    ASSERT_GT(memory.format_bytes, 0u);
+    ASSERT_NE(std::find(files.begin(), files.end(), memory.worst_reader), files.end());
+    ASSERT_LE(memory.worst_reader_bytes, memory.variant_buffer_bytes + memory.depth_buffer_bytes);
+
+    g.write_vcf();
+    const merge_memory_t &peak = g.GetPeakMemoryUsage();
+    ASSERT_GT(peak.TotalBytes(), 0u);
+    ASSERT_GE(peak.TotalBytes(), g.GetMemoryUsage().TotalBytes());
+}
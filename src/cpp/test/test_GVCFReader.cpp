@@ -192,3 +192,34 @@ TEST(GVCFReader, readAGVCF)
 }
 
 
+
+//a tight read-ahead budget shortens the window but must not change the records or their order
+TEST(GVCFReader, adaptiveWindow)
+{
+    std::string gvcf_file_name = g_testenv->getBasePath() + "/../test/NA12877.tiny.vcf.gz";
+    std::string ref_file_name = g_testenv->getBasePath() + "/../test/tiny.ref.fa";
+    Normaliser normaliser(ref_file_name);
+    std::vector<std::string> records[2];
+    size_t max_buffered[2] = {0, 0};
+    int min_window = 100000;
+    for (int budget = 0; budget < 2; budget++)
+    {
+        GVCFReader reader(gvcf_file_name, &normaliser, 5000);
+        reader.SetMaxBufferedVariants(budget ? 2 : 0);
+        bcf1_t *line = reader.Pop();
+        while (line != nullptr)
+        {
+            records[budget].push_back(ggutils::record2string(reader.GetHeader(), line));
+            max_buffered[budget] = std::max(max_buffered[budget], reader.GetNumVariants());
+            if (budget) min_window = std::min(min_window, reader.GetWindow());
+            else ASSERT_EQ(reader.GetWindow(), 5000);
+            bcf_destroy(line);
+            line = reader.Pop();
+        }
+    }
+    ASSERT_GT(records[0].size(), 10u);
+    ASSERT_EQ(records[0], records[1]);
+    ASSERT_LT(min_window, 5000);
+    ASSERT_GE(min_window, 1000);
+    ASSERT_LE(max_buffered[1], max_buffered[0]);
+}
@@ -0,0 +1,56 @@
+#include "test_helpers.hh"
+#include "HeaderCache.hh"
+
+static bcf_hdr_t *make_header(const std::string &sample, const std::string &contig_length, const std::string &extra)
+{
+    bcf_hdr_t *hdr = bcf_hdr_init("r");
+    bcf_hdr_append(hdr, ("##contig=<ID=chr1,length=" + contig_length + ">").c_str());
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"Depth\">");
+    if (!extra.empty())
+        bcf_hdr_append(hdr, extra.c_str());
+    bcf_hdr_add_sample(hdr, sample.c_str());
+    bcf_hdr_add_sample(hdr, nullptr);
+    bcf_hdr_sync(hdr);
+    return (hdr);
+}
+
+TEST(HeaderCache, sharesIdenticalLayouts)
+{
+    HeaderCache cache;
+    bcf_hdr_t *first = cache.Intern(make_header("S1", "1000", "##cmdline=run S1"));
+    //sample names and free-text lines do not matter
+    ASSERT_EQ(cache.Intern(make_header("S2", "1000", "##cmdline=run S2")), first);
+    ASSERT_EQ(cache.Intern(make_header("S3", "1000", "")), first);
+    ASSERT_EQ(cache.GetNumHeaders(), 1u);
+
+    //a different contig length or FORMAT dictionary is a new layout
+    ASSERT_NE(cache.Intern(make_header("S4", "2000", "")), first);
+    bcf_hdr_t *other = cache.Intern(make_header("S5", "1000", "##FORMAT=<ID=GQ,Number=1,Type=Integer,Description=\"GQ\">"));
+    ASSERT_NE(other, first);
+    ASSERT_EQ(cache.Intern(make_header("S6", "1000", "##FORMAT=<ID=GQ,Number=1,Type=Float,Description=\"GQ\">")) == other, false);
+    ASSERT_EQ(cache.GetNumHeaders(), 4u);
+    ASSERT_EQ(cache.GetNumLookups(), 6u);
+    ASSERT_GT(cache.GetMemoryUsage(), 0u);
+}
+
+//each cache parses with a copy of its own, which has the dictionary of the header copied
+TEST(HeaderCache, copiesPerCache)
+{
+    bcf_hdr_t *shared = bcf_hdr_init("w");
+    bcf_hdr_append(shared, "##contig=<ID=chr1,length=1000>");
+    bcf_hdr_append(shared, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">");
+    bcf_hdr_add_sample(shared, "S1");
+    bcf_hdr_sync(shared);
+    HeaderCache a, b;
+    std::mutex *mutex_a = nullptr, *mutex_b = nullptr;
+    bcf_hdr_t *copy_a = a.Copy(shared, &mutex_a);
+    bcf_hdr_t *copy_b = b.Copy(shared, &mutex_b);
+    ASSERT_NE(copy_a, shared);
+    ASSERT_NE(copy_a, copy_b);
+    ASSERT_NE(mutex_a, mutex_b);
+    ASSERT_EQ(a.Copy(shared), copy_a);
+    ASSERT_EQ(a.GetNumHeaders(), 1u);
+    ASSERT_EQ(HeaderCache::Layout(copy_a), HeaderCache::Layout(shared));
+    bcf_hdr_destroy(shared);
+}
@@ -0,0 +1,122 @@
+#include "test_helpers.hh"
+#include "HomrefParser.hh"
+#include "ggutils.hh"
+
+//the block GVCFReader builds from the record vcf_parse1 gives
+static DepthBlock parsed_block(bcf_hdr_t *hdr, bcf1_t *record)
+{
+    int32_t dp, dpf = bcf_int32_missing, gq;
+    assert(ggutils::bcf1_get_one_format_int(hdr, record, "DP", dp) == 1);
+    if (ggutils::bcf1_get_one_format_int(hdr, record, "GQ", gq) != 1)
+    {
+        float tmp;
+        if (ggutils::bcf1_get_one_format_float(hdr, record, "GQ", tmp) == 1)
+            gq = bcf_float_is_missing(tmp) ? 0 : (int32_t) tmp;
+        else
+            assert(ggutils::bcf1_get_one_format_int(hdr, record, "GQX", gq) == 1);
+    }
+    ggutils::bcf1_get_one_format_int(hdr, record, "DPF", dpf);
+    return (DepthBlock(record->rid, record->pos, ggutils::get_end_of_gvcf_block_or_variant(hdr, record), dp, dpf,
+                       gq == bcf_int32_missing ? 0 : gq, ggutils::get_ploidy(hdr, record)));
+}
+
+static kstring_t line_of(const std::string &text)
+{
+    kstring_t line = {0, 0, nullptr};
+    kputs(text.c_str(), &line);
+    return (line);
+}
+
+TEST(HomrefParser, matchesVcfParse)
+{
+    htsFile *fp = hts_open((g_testenv->getBasePath() + "/../test/NA12877.tiny.vcf.gz").c_str(), "r");
+    ASSERT_TRUE(fp != nullptr);
+    bcf_hdr_t *hdr = bcf_hdr_read(fp);
+    bcf1_t *record = bcf_init1();
+    HomrefParser parser(hdr);
+    kstring_t line = {0, 0, nullptr}, copy = {0, 0, nullptr};
+    int num_blocks = 0, num_other = 0;
+    while (hts_getline(fp, '\n', &line) >= 0)
+    {
+        copy.l = 0;
+        kputsn(line.s, line.l, &copy);
+        DepthBlock block;
+        bool is_block = parser.Parse(line, block);
+        //the parser leaves the line as it was
+        ASSERT_EQ(std::string(line.s, line.l), std::string(copy.s, copy.l));
+        ASSERT_EQ(vcf_parse1(&copy, hdr, record), 0);
+        bcf_unpack(record, BCF_UN_ALL);
+        if (is_block)
+        {
+            DepthBlock expected = parsed_block(hdr, record);
+            ASSERT_EQ(block, expected);
+            ASSERT_EQ(block.ploidy(), expected.ploidy());
+            num_blocks++;
+        }
+        else
+        {
+            //only variants are left to vcf_parse1 in this file
+            ASSERT_GT(record->n_allele, 1u);
+            num_other++;
+        }
+    }
+    ASSERT_GT(num_blocks, 0);
+    ASSERT_GT(num_other, 0);
+    free(line.s);
+    free(copy.s);
+    bcf_destroy1(record);
+    bcf_hdr_destroy(hdr);
+    hts_close(fp);
+}
+
+TEST(HomrefParser, fieldsAndFallbacks)
+{
+    bcf_hdr_t *hdr = bcf_hdr_init("w");
+    bcf_hdr_append(hdr, "##contig=<ID=chr1,length=1000>");
+    bcf_hdr_append(hdr, "##INFO=<ID=END,Number=1,Type=Integer,Description=\"End\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"GT\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"DP\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=DPF,Number=1,Type=Integer,Description=\"DPF\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GQ,Number=1,Type=Float,Description=\"GQ\">");
+    bcf_hdr_append(hdr, "##FORMAT=<ID=GQX,Number=1,Type=Integer,Description=\"GQX\">");
+    bcf_hdr_add_sample(hdr, "S1");
+    bcf_hdr_sync(hdr);
+    HomrefParser parser(hdr);
+    DepthBlock block;
+
+    kstring_t line = line_of("chr1\t10\t.\tA\t.\t.\tPASS\tEND=20\tGT:GQ:DP:DPF\t0/0:35.7:12:3");
+    ASSERT_TRUE(parser.Parse(line, block));
+    ASSERT_EQ(block, DepthBlock(0, 9, 19, 12, 3, 35, 2));
+    free(line.s);
+
+    //GQX stands in for GQ, values dropped from the end of the sample are missing
+    line = line_of("chr1\t30\t.\tA\t.\t.\tPASS\tBLOCKAVG;END=40\tGT:GQX:DP:DPF\t0:7:.");
+    ASSERT_TRUE(parser.Parse(line, block));
+    ASSERT_EQ(block, DepthBlock(0, 29, 39, bcf_int32_missing, bcf_int32_missing, 7, 1));
+    ASSERT_EQ(block.ploidy(), 1);
+    free(line.s);
+
+    line = line_of("chr1\t50\t.\tA\t.\t.\tPASS\tEND=50\tGT:GQ:DP\t./.:.:0");
+    ASSERT_TRUE(parser.Parse(line, block));
+    ASSERT_EQ(block, DepthBlock(0, 49, 49, 0, bcf_int32_missing, 0, 2));
+    free(line.s);
+
+    //a site without INFO/END
+    line = line_of("chr1\t55\t.\tAC\t.\t.\tPASS\t.\tGT:GQX:DP\t0/0:20:8");
+    ASSERT_TRUE(parser.Parse(line, block));
+    ASSERT_EQ(block, DepthBlock(0, 54, 55, 8, bcf_int32_missing, 20, 2));
+    free(line.s);
+
+    //left to vcf_parse1: a variant, a block without DP, an unknown contig and malformed values
+    for (const char *text : {"chr1\t60\t.\tA\tG\t.\tPASS\tEND=60\tGT:GQ:DP\t0/1:30:10",
+                             "chr1\t60\t.\tA\t.\t.\tPASS\tEND=70\tGT:GQ\t0/0:30",
+                             "chr1\t60\t.\tA\t.\t.\tPASS\tEND=x\tGT:GQ:DP\t0/0:30:10",
+                             "chr2\t60\t.\tA\t.\t.\tPASS\tEND=70\tGT:GQ:DP\t0/0:30:10",
+                             "chr1\t60\t.\tA\t.\t.\tPASS\tEND=70\tGT:GQ:DP\t0/0:30:1,2"})
+    {
+        line = line_of(text);
+        ASSERT_FALSE(parser.Parse(line, block)) << text;
+        free(line.s);
+    }
+    bcf_hdr_destroy(hdr);
+}
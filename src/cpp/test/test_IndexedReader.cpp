@@ -0,0 +1,51 @@
+#include "test_helpers.hh"
+#include "IndexedReader.hh"
+
+#include <vector>
+
+//positions of the records bcf_srs_t returns for the same file and regions
+static std::vector<int> synced_reader_positions(const std::string &file_name, const std::string &region)
+{
+    std::vector<int> positions;
+    bcf_srs_t *sr = bcf_sr_init();
+    if (!region.empty())
+        bcf_sr_set_regions(sr, region.c_str(), 0);
+    bcf_sr_add_reader(sr, file_name.c_str());
+    while (bcf_sr_next_line(sr))
+        positions.push_back(bcf_sr_get_line(sr, 0)->pos);
+    bcf_sr_destroy(sr);
+    return (positions);
+}
+
+static std::vector<int> indexed_reader_positions(const std::string &file_name, const std::string &region)
+{
+    std::vector<int> positions;
+    IndexedReader reader(file_name, region);
+    bcf1_t *record = bcf_init();
+    while (reader.Next(record))
+    {
+        EXPECT_STREQ(bcf_seqname(reader.GetHeader(), record), "chr3");
+        positions.push_back(record->pos);
+    }
+    EXPECT_TRUE(reader.Eof());
+    EXPECT_FALSE(reader.Next(record));
+    bcf_destroy(record);
+    return (positions);
+}
+
+TEST(IndexedReader, matchesSyncedReader)
+{
+    std::string file_name = g_testenv->getBasePath() + "/../test/NA12877.tiny.vcf.gz";
+    std::vector<int> all = indexed_reader_positions(file_name, "");
+    ASSERT_EQ(all.size(), 1516u);
+    ASSERT_EQ(all, synced_reader_positions(file_name, ""));
+
+    //blocks overlapping a region start are returned, contigs missing from the file are skipped
+    std::string regions = "chr3:2000-3000,chr1:1-100,chr3:5000-5200,chr3:9000";
+    std::vector<int> subset = indexed_reader_positions(file_name, regions);
+    ASSERT_GT(subset.size(), 0u);
+    ASSERT_LT(subset.size(), all.size());
+    ASSERT_EQ(subset, synced_reader_positions(file_name, regions));
+
+    ASSERT_TRUE(indexed_reader_positions(file_name, "chr1").empty());
+}
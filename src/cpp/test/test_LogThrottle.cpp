@@ -0,0 +1,39 @@
+#include "test_helpers.hh"
+#include "LogThrottle.hh"
+
+TEST(LogThrottle, maxRepeats)
+{
+    LogThrottle::Reset();
+    size_t max_repeats = LogThrottle::GetMaxRepeats();
+    LogThrottle::SetMaxRepeats(3);
+    int num_logged = 0;
+    for (int i = 0; i < 10; i++)
+        num_logged += LogThrottle::Allow("warning {}");
+    ASSERT_EQ(num_logged, 3);
+    ASSERT_EQ(LogThrottle::GetCount("warning {}"), 10u);
+    //keys are counted separately
+    ASSERT_TRUE(LogThrottle::Allow("another warning {}"));
+    ASSERT_EQ(LogThrottle::GetCount("another warning {}"), 1u);
+    ASSERT_EQ(LogThrottle::GetCount("unseen"), 0u);
+    LogThrottle::SetMaxRepeats(max_repeats);
+    LogThrottle::Reset();
+}
+
+//warnings about an input are logged once for each input, past the limit of Allow()
+TEST(LogThrottle, oncePerInput)
+{
+    LogThrottle::Reset();
+    size_t max_repeats = LogThrottle::GetMaxRepeats();
+    LogThrottle::SetMaxRepeats(3);
+    int num_logged = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        std::string key = std::string("WARNING: {} has no FORMAT/ADF tag\t") + "sample" + std::to_string(i) + ".vcf.gz";
+        num_logged += LogThrottle::AllowOnce(key);
+        num_logged += LogThrottle::AllowOnce(key);
+    }
+    ASSERT_EQ(num_logged, 10);
+    ASSERT_EQ(LogThrottle::GetCount("WARNING: {} has no FORMAT/ADF tag"), 0u);
+    LogThrottle::SetMaxRepeats(max_repeats);
+    LogThrottle::Reset();
+}
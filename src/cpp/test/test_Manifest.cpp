@@ -0,0 +1,58 @@
+#include "test_helpers.hh"
+#include "IndexedReader.hh"
+#include "Manifest.hh"
+
+#include <unistd.h>
+
+//inputs read through a manifest give the same records as reading their headers and indices
+TEST(Manifest, matchesIndexedReader)
+{
+    std::vector<std::string> files;
+    for (auto name : {"NA12877", "NA12889", "NA12890"})
+        files.push_back(g_testenv->getBasePath() + "/../test/" + name + ".tiny.vcf.gz");
+    char manifest_file[] = "/tmp/manifest-XXXXXX";
+    int fd = mkstemp(manifest_file);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    {
+        Manifest built;
+        built.Build(files, 1000, 2);
+        ASSERT_EQ(built.GetNumInputs(), 3u);
+        ASSERT_EQ(built.GetNumHeaders(), 1u);
+        built.Write(manifest_file);
+    }
+
+    for (std::string region : {"", "chr3:2000-3000,chr1:1-100,chr3:5000-5200,chr3:9000", "chr3:1500-1500"})
+    {
+        Manifest manifest;
+        manifest.Read(manifest_file, region);
+        ASSERT_EQ(manifest.GetNumInputs(), files.size());
+        ASSERT_EQ(manifest.GetBinSize(), 1000);
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            ASSERT_EQ(manifest.Find(files[i]), (int) i);
+            ASSERT_TRUE(manifest.IsCurrent(i));
+            //bins are only kept for the contigs of the region
+            ASSERT_EQ(manifest.GetInput(i).bins.size(), region.empty() ? 0u : 1u);
+
+            IndexedReader from_manifest(manifest, i, region), from_index(files[i], region);
+            ASSERT_EQ(from_manifest.GetSampleNames(), from_index.GetSampleNames());
+            bcf1_t *a = bcf_init(), *b = bcf_init();
+            size_t num_read = 0;
+            while (from_index.Next(b))
+            {
+                ASSERT_TRUE(from_manifest.Next(a));
+                ASSERT_EQ(a->rid, b->rid);
+                ASSERT_EQ(a->pos, b->pos);
+                ASSERT_EQ(a->rlen, b->rlen);
+                num_read++;
+            }
+            ASSERT_FALSE(from_manifest.Next(a));
+            ASSERT_GT(num_read, 0u);
+            bcf_destroy(a);
+            bcf_destroy(b);
+        }
+        ASSERT_EQ(manifest.Find("missing.vcf.gz"), -1);
+    }
+    unlink(manifest_file);
+}
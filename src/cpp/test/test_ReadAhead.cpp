@@ -0,0 +1,53 @@
+#include "test_helpers.hh"
+#include "ReadAhead.hh"
+
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+//waits for the prefetch threads to request num_bytes
+static bool wait_for_bytes(ReadAhead &read_ahead, uint64_t num_bytes)
+{
+    for (int i = 0; i < 1000 && read_ahead.GetBytesRequested() < num_bytes; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return (read_ahead.GetBytesRequested() == num_bytes);
+}
+
+TEST(ReadAhead, prefetch)
+{
+    char file_name[] = "/tmp/readahead-XXXXXX";
+    int fd = mkstemp(file_name);
+    ASSERT_GE(fd, 0);
+    uint64_t size = 600 << 10;
+    std::string data(size, 'x');
+    ASSERT_EQ(write(fd, data.c_str(), size), (ssize_t) size);
+
+    //the smallest window: only the start is requested until the reader advances
+    ReadAhead read_ahead(2, 1);
+    ASSERT_EQ(read_ahead.AddFile("no.such.file.vcf.gz"), -1);
+    int id = read_ahead.AddFile(file_name);
+    ASSERT_EQ(id, 0);
+    uint64_t window = read_ahead.GetWindow();
+    ASSERT_GT(size, 2 * window);
+    uint64_t next = read_ahead.Advance(id, fd, 0);
+    ASSERT_GT(next, 0u);
+    ASSERT_TRUE(wait_for_bytes(read_ahead, window));
+    ASSERT_EQ(read_ahead.GetNumRequests(), 2u);
+
+    //prefetching follows the reader
+    read_ahead.Advance(id, fd, window / 2);
+    ASSERT_TRUE(wait_for_bytes(read_ahead, window + window / 2));
+
+    //nothing is requested for a released file until it is reopened
+    read_ahead.Release(id);
+    close(fd);
+    fd = open(file_name, O_RDONLY);
+    ASSERT_GE(fd, 0);
+
+    //a jump (eg. to the next region) skips the data in between, the rest of the file is requested once
+    read_ahead.Advance(id, fd, size - 100);
+    ASSERT_TRUE(wait_for_bytes(read_ahead, window + window / 2 + 100));
+    read_ahead.Release(id);
+    close(fd);
+    unlink(file_name);
+}
@@ -0,0 +1,113 @@
+#include "test_helpers.hh"
+#include "ShardPlanner.hh"
+
+extern "C" {
+#include <htslib/tbx.h>
+}
+#include <unistd.h>
+
+//a variant every kb of chrA (4Mb) except between 1990kb and 2030kb, and a few on chrB. Random INFO
+//keeps the text from compressing so that the index has a chunk per Mb.
+static std::string write_test_vcf()
+{
+    char name[] = "/tmp/shards-XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    std::string file_name = std::string(name) + ".vcf.gz";
+    unlink(name);
+    htsFile *fp = hts_open(file_name.c_str(), "wz");
+    bcf_hdr_t *hdr = bcf_hdr_init("w");
+    bcf_hdr_append(hdr, "##contig=<ID=chrA,length=4000000>");
+    bcf_hdr_append(hdr, "##contig=<ID=chrB,length=100000>");
+    bcf_hdr_append(hdr, "##INFO=<ID=R,Number=1,Type=String,Description=\"Random\">");
+    bcf_hdr_add_sample(hdr, nullptr);
+    bcf_hdr_write(fp, hdr);
+    bcf1_t *record = bcf_init();
+    uint32_t seed = 1;
+    std::string random(100, ' ');
+    for (int rid = 0; rid < 2; rid++)
+    {
+        for (int pos = 500; pos < (rid == 0 ? 4000000 : 100000); pos += rid == 0 ? 1000 : 20000)
+        {
+            if (rid == 0 && pos >= 1990000 && pos < 2030000)
+                continue;
+            bcf_clear(record);
+            record->rid = rid;
+            record->pos = pos;
+            bcf_update_alleles_str(hdr, record, "A,C");
+            for (auto &c : random)
+            {
+                seed = seed * 1103515245 + 12345;
+                c = 'a' + (seed >> 16) % 26;
+            }
+            bcf_update_info_string(hdr, record, "R", random.c_str());
+            bcf_write(fp, hdr, record);
+        }
+    }
+    bcf_destroy(record);
+    bcf_hdr_destroy(hdr);
+    hts_close(fp);
+    tbx_index_build(file_name.c_str(), 0, &tbx_conf_vcf);
+    return (file_name);
+}
+
+TEST(ShardPlanner, balancedCutsInGaps)
+{
+    std::string file_name = write_test_vcf();
+    Manifest manifest;
+    manifest.Build({file_name}, 100000, 1);
+    ShardPlanner planner(manifest);
+
+    planner.Plan(1, 50000);
+    ASSERT_EQ(planner.GetShards().size(), 1u);
+    ASSERT_EQ(planner.GetRegionList(0), "chrA,chrB");
+    ASSERT_GT(planner.GetTotalBytes(), 0);
+
+    //half of chrA is about half the work, the cut moves to the middle of the gap without variants
+    planner.Plan(2, 50000);
+    auto &shards = planner.GetShards();
+    ASSERT_EQ(shards.size(), 2u);
+    ASSERT_EQ(shards[0].regions.size(), 1u);
+    int64_t cut = shards[0].regions[0].end;
+    ASSERT_GT(cut, 1990000);
+    ASSERT_LT(cut, 2030000);
+    ASSERT_EQ(planner.GetRegionList(0), "chrA:1-" + std::to_string(cut));
+    ASSERT_EQ(planner.GetRegionList(1), "chrA:" + std::to_string(cut + 1) + "-4000000,chrB");
+    ASSERT_NEAR(shards[0].bytes / planner.GetTotalBytes(), 0.5, 0.1);
+
+    //the shards cover the genome in order whatever their number
+    planner.Plan(100, 0);
+    ASSERT_GT(planner.GetShards().size(), 2u);
+    ASSERT_LE(planner.GetShards().size(), 100u);
+    int rid = 0;
+    int64_t end = 0;
+    for (auto &shard : planner.GetShards())
+    {
+        for (auto &r : shard.regions)
+        {
+            if (r.rid != rid)
+            {
+                ASSERT_EQ(r.rid, rid + 1);
+                ASSERT_EQ(end, 4000000);
+                rid = r.rid;
+                end = 0;
+            }
+            ASSERT_EQ(r.beg, end);
+            end = r.end;
+        }
+    }
+    ASSERT_EQ(rid, 1);
+    ASSERT_EQ(end, 100000);
+
+    //every bin is counted in some shard, also when a cut moves past the end of chrA
+    for (int num_shards : {2, 10, 40, 100})
+    {
+        planner.Plan(num_shards, 150000);
+        double bytes = 0;
+        for (auto &shard : planner.GetShards())
+            bytes += shard.bytes;
+        ASSERT_NEAR(bytes, planner.GetTotalBytes(), 1e-6 * planner.GetTotalBytes()) << num_shards;
+    }
+    unlink(file_name.c_str());
+    unlink((file_name + ".tbi").c_str());
+}
@@ -0,0 +1,57 @@
+#include "test_helpers.hh"
+#include "StageTimer.hh"
+
+#include <thread>
+#include <chrono>
+
+#ifndef GG_NO_TIMERS
+//a nested stage's time counts towards its parent's total but not its parent's self time
+TEST(StageTimer, nested)
+{
+    StageTimer::Reset();
+    {
+        StageTimer outer(Stage::GetNextVariant);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        for (int i = 0; i < 3; i++)
+        {
+            StageTimer inner(Stage::Read);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+    std::vector<StageTotals> totals = StageTimer::GetTotals();
+    const StageTotals &outer = totals[(size_t) Stage::GetNextVariant];
+    const StageTotals &inner = totals[(size_t) Stage::Read];
+    ASSERT_EQ(outer.calls, 1u);
+    ASSERT_EQ(inner.calls, 3u);
+    ASSERT_EQ(inner.total_ns, inner.self_ns);
+    ASSERT_GE(inner.total_ns, 15000000u);
+    ASSERT_EQ(outer.total_ns, outer.self_ns + inner.total_ns);
+    ASSERT_GE(outer.self_ns, 5000000u);
+    ASSERT_EQ(totals[(size_t) Stage::Write].calls, 0u);
+}
+
+//totals of threads that have exited are kept
+TEST(StageTimer, threads)
+{
+    StageTimer::Reset();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([]()
+                             {
+                                 for (int j = 0; j < 10; j++)
+                                     StageTimer timer(Stage::GenotypeSample);
+                             });
+    }
+    for (auto &t : threads)
+        t.join();
+    ASSERT_EQ(StageTimer::GetTotals()[(size_t) Stage::GenotypeSample].calls, 40u);
+    ASSERT_GE(StageTimer::GetNumThreads(), 4);
+}
+#endif
+
+TEST(StageTimer, names)
+{
+    for (size_t i = 0; i < (size_t) Stage::NumStages; i++)
+        ASSERT_STRNE(StageTimer::StageName((Stage) i), "unknown");
+}
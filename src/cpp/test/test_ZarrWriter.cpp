@@ -0,0 +1,102 @@
+#include "test_helpers.hh"
+#include "ZarrWriter.hh"
+
+#include <fstream>
+#include <sstream>
+#include <zlib.h>
+#include <unistd.h>
+
+//reads and inflates a zlib compressed chunk
+static std::vector<char> read_chunk(const std::string &fname, size_t num_bytes)
+{
+    std::ifstream in(fname.c_str(), std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string compressed = ss.str();
+    std::vector<char> ret(num_bytes);
+    uLongf dest_len = num_bytes;
+    EXPECT_EQ(uncompress((Bytef *) ret.data(), &dest_len, (const Bytef *) compressed.data(), compressed.size()), Z_OK);
+    EXPECT_EQ(dest_len, num_bytes);
+    return ret;
+}
+
+TEST(ZarrWriter, chunks)
+{
+    bcf_hdr_t *hdr = get_header();
+    bcf_hdr_add_sample(hdr, "S2");
+    bcf_hdr_add_sample(hdr, "S3");
+    bcf_hdr_sync(hdr);
+    ASSERT_EQ(bcf_hdr_nsamples(hdr), 3);
+
+    char dir[] = "/tmp/zarr-XXXXXX";
+    ASSERT_TRUE(mkdtemp(dir) != nullptr);
+    std::string directory = std::string(dir) + "/test.zarr";
+    int max_alleles = 2, variant_chunk_size = 2, sample_chunk_size = 2;
+    {
+        ZarrWriter writer(directory, hdr, max_alleles, variant_chunk_size, sample_chunk_size);
+        ggutils::vcf_data_t format(2, 2, 3);
+        for (int i = 0; i < 3; i++)
+        {
+            std::string alleles = i < 2 ? "G,C" : "G,C,T";
+            bcf1_t *record = generate_record(hdr, 2, 100 + i, alleles);
+            format.resize(record->n_allele);
+            format.set_missing();
+            //sample 0 het, sample 1 haploid alt, sample 2 missing
+            format.gt[0] = bcf_gt_unphased(0);
+            format.gt[1] = bcf_gt_unphased(record->n_allele - 1);
+            format.gt[2] = bcf_gt_unphased(1);
+            format.gt[3] = bcf_int32_vector_end;
+            format.dp[0] = 10 + i;
+            format.gq[1] = 20 + i;
+            for (size_t j = 0; j < format.num_ad; j++)
+                format.ad[j] = j;
+            writer.AddSite(record, &format);
+            bcf_destroy(record);
+        }
+        ASSERT_EQ(writer.GetNumVariants(), 3u);
+    }
+
+    //two variant chunks x two sample chunks
+    for (auto key : {"0.0.0", "0.1.0", "1.0.0", "1.1.0"})
+        ASSERT_TRUE(ggutils::fileexists(directory + "/call_GT/" + key));
+    ASSERT_TRUE(ggutils::fileexists(directory + "/call_DP/1.1"));
+    ASSERT_TRUE(ggutils::fileexists(directory + "/variant_position/1"));
+
+    std::vector<std::string> lines;
+    ggutils::read_text_file(directory + "/call_AD/.zarray", lines);
+    ASSERT_NE(std::find(lines.begin(), lines.end(), "    \"shape\": [3, 3, 2],"), lines.end());
+    ASSERT_NE(std::find(lines.begin(), lines.end(), "    \"chunks\": [2, 2, 2],"), lines.end());
+
+    //first variant chunk, first two samples
+    std::vector<char> gt = read_chunk(directory + "/call_GT/0.0.0", 2 * 2 * 2);
+    int8_t expected_gt[] = {0, 1, 1, -2, 0, 1, 1, -2};
+    for (int i = 0; i < 8; i++)
+        ASSERT_EQ((int8_t) gt[i], expected_gt[i]);
+
+    //last variant chunk has one real row, the tri-allelic AD is truncated to max_alleles
+    std::vector<char> raw_ad = read_chunk(directory + "/call_AD/1.0.0", 2 * 2 * 2 * sizeof(int32_t));
+    int32_t *ad = (int32_t *) raw_ad.data();
+    ASSERT_EQ(ad[0], 0);
+    ASSERT_EQ(ad[1], 1);
+    ASSERT_EQ(ad[2], 3);
+    ASSERT_EQ(ad[3], 4);
+    ASSERT_EQ(ad[4], -1);
+
+    std::vector<char> raw_dp = read_chunk(directory + "/call_DP/1.0", 2 * 2 * sizeof(int32_t));
+    int32_t *dp = (int32_t *) raw_dp.data();
+    ASSERT_EQ(dp[0], 12);
+    ASSERT_EQ(dp[1], -1);
+
+    std::vector<char> raw_pos = read_chunk(directory + "/variant_position/1", 2 * sizeof(int32_t));
+    ASSERT_EQ(((int32_t *) raw_pos.data())[0], 102);
+
+    //vlen-utf8: count, then length + bytes per item
+    std::vector<char> raw_alleles = read_chunk(directory + "/variant_allele/1", 4 + 4 + 5 + 4);
+    uint32_t *header = (uint32_t *) raw_alleles.data();
+    ASSERT_EQ(header[0], 2u);
+    ASSERT_EQ(header[1], 5u);
+    ASSERT_EQ(std::string(raw_alleles.data() + 8, 5), "G,C,T");
+
+    bcf_hdr_destroy(hdr);
+    ASSERT_EQ(system(("rm -r " + std::string(dir)).c_str()), 0);
+}
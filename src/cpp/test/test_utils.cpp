@@ -441,3 +441,41 @@ TEST(UtilTest,filter2string)
     ASSERT_STREQ(ft2.s,"SiteConflict;LowGQX;HighDPFRatio");
     free(ft.s);
 }
+
+TEST(UtilTest,hweExact)
+{
+    double p_hwe,p_exc_het;
+    ggutils::hwe_exact(57,14,50,p_hwe,p_exc_het);
+    ASSERT_NEAR(p_hwe,0.8422798,1e-6);
+    ASSERT_NEAR(p_exc_het,0.4525494,1e-6);
+    //too few hets
+    ggutils::hwe_exact(25,25,50,p_hwe,p_exc_het);
+    ASSERT_NEAR(p_hwe,3.964598e-06,1e-11);
+    ASSERT_NEAR(p_exc_het,0.9999997,1e-6);
+    //too many hets
+    ggutils::hwe_exact(50,0,50,p_hwe,p_exc_het);
+    ASSERT_NEAR(p_hwe,0.0003286596,1e-9);
+    ASSERT_NEAR(p_exc_het,0.0002502841,1e-9);
+    //monomorphic and empty
+    ggutils::hwe_exact(0,0,50,p_hwe,p_exc_het);
+    ASSERT_DOUBLE_EQ(p_hwe,1.);
+    ASSERT_DOUBLE_EQ(p_exc_het,1.);
+    ggutils::hwe_exact(0,0,0,p_hwe,p_exc_het);
+    ASSERT_DOUBLE_EQ(p_hwe,1.);
+}
+
+TEST(UtilTest,stringDuration)
+{
+    ASSERT_EQ(ggutils::string_duration(0.4),"0s");
+    ASSERT_EQ(ggutils::string_duration(59),"59s");
+    ASSERT_EQ(ggutils::string_duration(61),"1m01s");
+    ASSERT_EQ(ggutils::string_duration(3723),"1h02m03s");
+    ASSERT_EQ(ggutils::string_duration(-5),"0s");
+}
+
+TEST(UtilTest,getContigLength)
+{
+    bcf_hdr_t *hdr = get_header();
+    ASSERT_EQ(ggutils::get_contig_length(hdr,bcf_hdr_name2id(hdr,"chr1")),249250621);
+    bcf_hdr_destroy(hdr);
+}